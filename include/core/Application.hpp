@@ -3,13 +3,18 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_mixer.h>
+#include <cstdint>
+#include <vector>
 #include "../camera/Camera.hpp"
 #include "../camera/CinematicCamera.hpp"
 #include "../ui/HUD.hpp"
 #include "../rendering/MetalRTRenderer.h"
 #include "../physics/BlackHole.hpp"
 #include "../utils/ResolutionManager.hpp"
+#include "../utils/DynamicResolution.hpp"
+#include "../utils/Upscaler.hpp"
 #include "../utils/VideoRecorder.hpp"
+#include "../utils/FramePool.hpp"
 
 /**
  * Main application class managing the simulation lifecycle
@@ -42,13 +47,20 @@ private:
   CinematicCamera *cinematicCamera;
   HUD *hud;
   ResolutionManager *resolutionManager;
+  DynamicResolution *dynamicResolution;
+  Upscaler *upscaler;
   VideoRecorder *videoRecorder;
+  FramePool *framePool; // Capture buffers at the renderer output size (recording, screenshots)
   
   // Window properties (dynamic)
   int windowWidth;
   int windowHeight;
   int renderWidth;   // Internal rendering resolution
   int renderHeight;  // Internal rendering resolution
+  int traceWidth;    // Size the renderer traces at (below renderWidth with dynamic resolution)
+  int traceHeight;
+  bool isDynamicResolution;
+  std::vector<uint8_t> upscaledPixels; // Traced frame upscaled to renderWidth x renderHeight
   bool isFullscreen;
   bool isResizing; // Flag to prevent recursive resize events
   
@@ -56,6 +68,8 @@ private:
   bool running;
   int currentFPS;
   bool isRecording;
+  uint64_t recordStartAllocations; // framePool->allocations() when recording started
+  long recordStartPageFaults;
   int colorMode; // 0=blue, 1=orange, 2=red, 3=white
   float colorIntensity; // Brightness multiplier for accretion disk (default 1.0)
   bool isMusicMuted; // Music mute state
@@ -74,10 +88,14 @@ private:
   void handleWindowResize(int width, int height);
   void recreateRenderTargets();
   void changeResolution(bool increase);
+  void toggleDynamicResolution();
+  void applyTraceSize(int width, int height);
   
   // Video recording
   void startRecording();
   void stopRecording();
+  // Offer a finished recording through the save dialog and move it there
+  void saveRecording(const std::string& tempFilename);
   
   // Screenshot
   void takeScreenshot();
@@ -2,10 +2,86 @@
 #include "../utils/Vector3.hpp"
 #include <vector>
 
+class DiskTexture;
+class EmissionTable;
+
+/**
+ * Per-frame shading parameters (mirrors the Uniforms consumed by the Metal kernel)
+ */
+struct ShadingParams {
+  double time = 0.0;           // Drives disk pattern and starfield rotation
+  int colorMode = 0;           // 0=blue, 1=orange, 2=red, 3=white
+  double colorIntensity = 1.0; // Brightness multiplier for accretion disk
+  bool doppler = true;         // Doppler colour shift and beaming of the orbiting disk
+};
+
+/**
+ * Geodesic integrator used by trace()
+ */
+enum class Integrator {
+  RK4 = 0,  // 3D Cartesian RK4 on position/velocity (matches the Metal kernel)
+  Binet = 1, // RK4 on u'' + u = 3Mu^2 in the ray's orbital plane, theta as parameter
+  DormandPrince = 2 // Error-controlled Cartesian RK45 (FSAL), tolerance per ray
+};
+
+/**
+ * Fate of a ray decided up front from its orbit constant b (critical value 3*sqrt(3)*M)
+ */
+enum class RayClass {
+  Escaping = 0,    // Heading outward, or b clearly above critical: turns (or never turns) and leaves
+  Captured = 1,    // Heading inward with b clearly below critical: no turning point before the horizon
+  NearCritical = 2 // b within the photon-ring band (or start inside the photon sphere): winds, needs fine steps
+};
+
+/**
+ * Work counters accumulated by trace() (callers sum them over a frame)
+ */
+struct TraceStats {
+  unsigned long long steps = 0; // Integration steps taken (including rejected adaptive attempts)
+  unsigned long long capturedRays = 0;     // Captured rays resolved without integration (clear of the disk)
+  unsigned long long nearCriticalRays = 0; // Rays traced with the fine step budget
+};
+
+/**
+ * One short stretch (<= ~0.3 units) of disk slab crossed by a ray, reduced to what the
+ * emission needs once the geodesic is known. The time-rotated pattern, palette and
+ * intensity are applied later by shadeHits().
+ */
+struct DiskHit {
+  float r;             // Radius at the stretch centre
+  float phi;           // Unrotated disk angle atan2(z, x) at the centre
+  float doppler;       // Doppler factor for the ray direction there
+  float depth;         // sum(envelope * w): optical depth per unit of pattern density
+  float emissionDepth; // sum(envelope^2 * w): emission weight per unit of pattern density^2
+};
+
+/**
+ * Shading-independent result of one trace: disk hits in path order and, if the ray
+ * escaped, its unrotated asymptotic direction. With keepHits off only the outcome is
+ * filled in and the trace itself is unchanged.
+ */
+struct HitRecord {
+  std::vector<DiskHit> hits; // Appended to; callers clear it between rays
+  Vector3 escapeDir;
+  bool escaped = false;
+  double transmittance = 1.0; // Left for the background along escapeDir
+  bool keepHits = true;
+};
+
 class BlackHole {
 public:
   double mass;
   double rs; // Schwarzschild radius
+  Integrator integrator;
+  double tolerance; // Local error tolerance for Integrator::DormandPrince
+  // Path shortcuts, all off by default so trace() follows the Metal kernel's stepping (and
+  // the SIMD packet kernel, which has none of them); callers opt in
+  bool boundingSphere; // Propagate in closed form outside boundingRadius() instead of integrating
+  bool classifyRays;   // Pre-classify rays by impact parameter (captured / escaping / near-critical)
+  bool slabStepping;   // Step by geometry only and integrate emission over each step's in-slab segment
+  const DiskTexture *diskTexture; // Baked disk pattern to sample instead of evaluating it (null = procedural)
+  const EmissionTable *emissionTable; // Tabulated palette and Doppler boost for diskEmission (null = formula)
+  bool specializedKernels; // Trace with the kernel compiled for this integrator, palette and flag set (false = generic)
 
   BlackHole(double mass = 1.0);
 
@@ -13,12 +89,110 @@ public:
   Vector3 trace(const Ray &ray, double stepSize = 0.1,
                 double maxDist = 100.0) const;
 
+  // Integrate a ray with time-rotated disk, palette and intensity (matches trace_ray in the shader).
+  // With a record the path is followed to its end even once opaque, so shadeHits() can
+  // reproduce it for any ShadingParams.
+  Vector3 trace(const Ray &ray, const ShadingParams &shading,
+                double stepSize = 0.1, double maxDist = 100.0, TraceStats *stats = nullptr,
+                HitRecord *record = nullptr) const;
+
+  // The part of trace() before integration: bounding-sphere entry and classification. Returns
+  // true with the final colour when no integration is needed; otherwise `ray` starts where
+  // integration begins and `stepScale` is the step multiplier for its class.
+  bool prepareTrace(Ray &ray, const ShadingParams &shading, Vector3 &color, double &stepScale,
+                    TraceStats *stats = nullptr, HitRecord *record = nullptr) const;
+
+  // Add one disk sample (radius, unrotated angle, Doppler factor, envelope * w, envelope^2 * w)
+  // to a record, folded into the previous hit when close enough (also used by the packet kernel)
+  void appendDiskHit(HitRecord *record, double r, double phi, double doppler, double depth,
+                     double emissionDepth) const;
+
+  // Re-evaluate a recorded path for new shading without tracing (escapeDir null if captured)
+  Vector3 shadeHits(const DiskHit *hits, size_t count, const Vector3 *escapeDir,
+                    const ShadingParams &shading) const;
+
+  // Capture / escape / near-critical tag from b = 1/sqrt(1/b^2) of the ray's orbit
+  RayClass classifyRay(const Ray &ray) const;
+
+  // Radius of the sphere enclosing the disk; outside it rays only bend
+  double boundingRadius() const;
+
+  // Asymptotic direction of a ray leaving the bounding sphere (exact orbit integral, no stepping)
+  Vector3 escapeDirection(const Vector3 &pos, const Vector3 &dir) const;
+
+  // Starfield seen along an escaped ray direction (also used to resolve packet traces)
+  Vector3 sampleBackground(const Vector3 &dir, double time = 0.0) const;
+
+  // Emission of one straight chord through the disk slab (|y| < 0.2) centred on `center`.
+  // Weights samples per unit length like trace() weights them per step, so table-driven
+  // tracers reproduce its brightness. Updates `transmittance` with Beer's law.
+  Vector3 integrateDiskCrossing(const Vector3 &center, const Vector3 &dir, const ShadingParams &shading,
+                                double stepSize, double &transmittance, HitRecord *record = nullptr) const;
+
+  // Emission of one integrator step, taken as the straight segment from -> to and clipped to
+  // the slab, so the result no longer depends on where the steps happen to land
+  Vector3 integrateDiskSegment(const Vector3 &from, const Vector3 &to, const ShadingParams &shading,
+                               double stepSize, double &transmittance, HitRecord *record = nullptr) const;
+
 private:
+  friend class DiskTexture; // Bakes diskPattern and checks the bake against it
+  friend class EmissionTable; // Tabulates diskEmission
+
+  // Trace kernel: one integrator compiled for one set of knobs (see KernelKnobs in BlackHole.cpp)
+  using TraceKernel = Vector3 (BlackHole::*)(const Ray &ray, const ShadingParams &shading, double stepSize,
+                                             double maxDist, double stepScale, TraceStats *stats,
+                                             HitRecord *record) const;
+  struct Kernels; // Dispatch table over every instantiation (BlackHole.cpp)
+
+  // Kernel for `kind` matching the shading and flags, or the generic one that reads them per use
+  TraceKernel selectKernel(Integrator kind, const ShadingParams &shading) const;
+
   Vector3 acceleration(const Vector3 &pos, const Vector3 &vel) const;
 
-  // Helper for accretion disk texture/noise
-  double diskDensity(const Vector3 &pos) const;
-  Vector3 diskColor(double density, double r, const Vector3 &pos, const Vector3 &rayDir, int colorMode = 0) const;
+  // `samples` evenly spaced density samples over start + dir * [0, length]
+  template <class Knobs>
+  Vector3 integrateDiskSamples(const Vector3 &start, const Vector3 &dir, double length, int samples,
+                               const ShadingParams &shading, double stepSize, double &transmittance,
+                               HitRecord *record) const;
+
+  // Append one point sample of weight w (optical depth per unit density) to the record
+  void recordDiskSample(HitRecord *record, const Vector3 &pos, const Vector3 &dir, double w) const;
+
+  // Move a ray starting outside the bounding sphere onto it. Returns false (with the
+  // asymptotic direction) when the ray misses the sphere or is heading away.
+  bool enterBoundingSphere(Ray &ray, Vector3 &escapeDir) const;
+
+  // Captured ray: true when its path to the horizon provably never enters the disk slab
+  // inside the annulus (crossing windows from the exact orbit integral), so the result is
+  // black with no integration. Rays that may pass through the disk return false and are
+  // integrated like any other, so the shortcut never drops emission.
+  bool traceCaptured(const Ray &ray, TraceStats *stats) const;
+
+  // integrateDiskSegment() as compiled into one trace kernel
+  template <class Knobs>
+  Vector3 integrateDiskSegment(const Vector3 &from, const Vector3 &to, const ShadingParams &shading,
+                               double stepSize, double &transmittance, HitRecord *record) const;
+
+  // stepScale < 1 shrinks the step (RK4/Binet) or tightens the tolerance (RK45) for near-critical rays
+  template <class Knobs>
+  Vector3 traceRK4(const Ray &ray, const ShadingParams &shading, double stepSize, double maxDist,
+                   double stepScale, TraceStats *stats, HitRecord *record) const;
+  template <class Knobs>
+  Vector3 traceBinet(const Ray &ray, const ShadingParams &shading, double stepSize, double maxDist,
+                     double stepScale, TraceStats *stats, HitRecord *record) const;
+  template <class Knobs>
+  Vector3 traceDormandPrince(const Ray &ray, const ShadingParams &shading, double stepSize, double maxDist,
+                             double stepScale, TraceStats *stats, HitRecord *record) const;
+
+  // Helper for accretion disk texture/noise: density = pattern(r, angle, time) * envelope(pos).
+  // `footprint` is the sample spacing, used to pick the baked texture's level.
+  double diskDensity(const Vector3 &pos, double time = 0.0, double footprint = 0.0) const;
+  double diskPattern(double r, double angle, double time) const;
+  double diskEnvelope(const Vector3 &pos) const; // Slab bounds, edge fade and vertical falloff
+  template <class Knobs>
+  Vector3 diskColor(double density, double r, const Vector3 &pos, const Vector3 &rayDir,
+                    const ShadingParams &shading) const;
+  // Doppler-shifted, beamed palette colour per unit density and intensity
+  Vector3 diskEmission(double r, double delta, int colorMode) const;
   double dopplerFactor(const Vector3 &pos, const Vector3 &rayDir) const;
-  Vector3 sampleBackground(const Vector3 &dir) const;
 };
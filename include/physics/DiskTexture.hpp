@@ -0,0 +1,58 @@
+#pragma once
+#include "../utils/Vector3.hpp"
+#include <cstddef>
+#include <vector>
+
+class BlackHole;
+
+/**
+ * Baked accretion disk pattern over (radius, angle), with a mip chain.
+ *
+ * BlackHole::diskPattern only rotates with time, so it is tabulated once at
+ * time 0 and a frame's rotation becomes an offset on the angle lookup. A density
+ * sample is then a cheap atan2, one bilinear fetch (from the mip whose texels
+ * match the caller's sample spacing, so long steps do not alias the pattern) and
+ * a table lookup for the vertical exp(-10|y|) falloff, instead of atan2, two sins
+ * and an exp. The edge fade stays analytic: its kinks would not survive bilinear
+ * filtering.
+ */
+class DiskTexture {
+public:
+  // Bake blackHole's pattern at radialSize x angularSize texels
+  explicit DiskTexture(const BlackHole &blackHole, int radialSize = 512, int angularSize = 512);
+
+  // Same as BlackHole::diskDensity(pos, time). `footprint` is the caller's sample spacing in
+  // world units: the lookup blurs the pattern over about that much (0 = finest level).
+  double density(const Vector3 &pos, double time, double footprint = 0.0) const;
+
+  // Pattern at radius r and unrotated angle (finest level)
+  double pattern(double r, double angle, double time) const;
+
+  // Largest |baked - procedural| density at the finest level, measured between texels
+  double maxError() const { return error; }
+
+  int radialSize() const { return levels.empty() ? 0 : levels[0].radial; }
+  int angularSize() const { return levels.empty() ? 0 : levels[0].angular; }
+  int levelCount() const { return static_cast<int>(levels.size()); }
+  size_t bytes() const;
+
+private:
+  struct Level {
+    int radial;
+    int angular;
+    double texelR;     // Radial texel size (world units)
+    double invTexelR;
+    double invTexelAngle; // Texels per radian
+    std::vector<float> texels; // radial rows of angular + 1 texels (the last repeats the first)
+  };
+
+  double rs;
+  double innerR;
+  double outerR;
+  std::vector<Level> levels;
+  std::vector<float> falloff; // exp(-10|y|) over |y| in [0, 0.2]
+  double error;
+
+  double fetch(const Level &level, double r, double angle) const;
+  double measureError(const BlackHole &blackHole) const;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include "../utils/Vector3.hpp"
+#include <cstddef>
+#include <vector>
+
+class BlackHole;
+
+/**
+ * BlackHole::diskEmission tabulated per colour mode over (radius, Doppler factor).
+ *
+ * The emission blends three palette colours along the normalized radius t, shifts
+ * toward a bright or dim colour by how far the Doppler factor is from 1 and boosts
+ * by its cube: two branches and a pow per disk sample. The table holds the finished
+ * RGB on a (t, delta) grid whose nodes include every kink of those piecewise terms,
+ * so a bilinear fetch stays within ~1e-4 of the formula. Doppler factors outside
+ * the tabulated range are left to the formula.
+ */
+class EmissionTable {
+public:
+  explicit EmissionTable(const BlackHole &blackHole);
+
+  static constexpr int MODES = 4; // colorMode 0..3 (palettes of BlackHole::diskEmission)
+
+  bool covers(double delta) const { return delta >= MIN_DELTA && delta <= MAX_DELTA; }
+
+  // Same as BlackHole::diskEmission(r, delta, colorMode) for a covered delta
+  Vector3 emission(double r, double delta, int colorMode) const;
+
+  // Largest |table - formula| relative to the formula, measured between nodes
+  double maxError() const { return error; }
+  size_t bytes() const { return texels.size() * sizeof(float); }
+
+private:
+  static constexpr double MIN_DELTA = 0.5; // Keplerian speed is capped at 0.5c: delta in [0.58, 1.73]
+  static constexpr double MAX_DELTA = 2.0;
+
+  double innerR;
+  double invWidth;             // 1 / radial extent of the disk
+  std::vector<float> texels;   // [mode][delta][t] RGB
+  double error;
+
+  double measureError(const BlackHole &blackHole) const;
+};
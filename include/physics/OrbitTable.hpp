@@ -0,0 +1,98 @@
+#pragma once
+#include "BlackHole.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * On-disk layout of the orbit table (native endianness, mmap-able as-is):
+ *   OrbitTableHeader | OrbitRecord[orbitCount] | OrbitSample[sampleCount]
+ */
+struct OrbitTableHeader {
+  char magic[8];        // "BHORBIT"
+  uint32_t version;
+  uint32_t orbitsPerSide; // Orbits below and above the critical impact parameter
+  uint64_t sampleCount;
+  double rs;
+  double phiStep;       // Uniform in-plane angle between samples
+  double rStart;        // Radius where every orbit starts (incoming) and ends (escaping)
+  double bCritical;     // 3*sqrt(3)*M
+  double bMax;          // Largest tabulated impact parameter
+};
+
+struct OrbitRecord {
+  double b;                // Orbit constant: (du/dphi)^2 + u^2 - rs*u^3 = 1/b^2
+  uint64_t firstSample;
+  uint32_t sampleCount;
+  uint32_t periapsisIndex; // Last sample of the incoming branch (last sample if captured)
+  uint32_t captured;       // 1 = reaches the horizon (or winds past the turn limit)
+  uint32_t reserved;
+};
+
+// u = 1/r, du = du/dphi, s = path length from the start of the orbit
+struct OrbitSample {
+  float u;
+  float du;
+  float s;
+};
+
+/**
+ * Precomputed Schwarzschild photon orbits u(phi) indexed by impact parameter b.
+ *
+ * Orbits are planar solutions of u'' + u = 3Mu^2 (the path BlackHole::trace
+ * integrates). A ray leaving a camera at radius r0 with impact parameter
+ * b = r0*sin(psi) lies on the curve with 1/b_orbit^2 = 1/b^2 - rs/r0^3, so the
+ * (camera radius, b) key collapses onto one tabulated curve: inward rays continue
+ * forward from the camera's point on the incoming branch, outward rays retrace it
+ * backwards. Each pixel costs a table search plus an in-plane rotation, and disk
+ * emission is only evaluated at the equatorial-plane crossings.
+ */
+class OrbitTable {
+public:
+  OrbitTable();
+  ~OrbitTable();
+
+  OrbitTable(const OrbitTable &) = delete;
+  OrbitTable &operator=(const OrbitTable &) = delete;
+
+  // Map the cache file if it matches this black hole, otherwise precompute and save it
+  bool loadOrBuild(const BlackHole &blackHole, const std::string &cachePath);
+
+  // Cache location: BLACKHOLE_CPU_ORBIT_CACHE if set ("none" = never cache), else
+  // blackhole-sim/orbits.bin in the platform cache directory (empty if there is none)
+  static std::string defaultCachePath();
+
+  bool isReady() const { return header != nullptr; }
+  bool isMapped() const { return mappedData != nullptr; }
+  size_t orbitCount() const { return header ? header->orbitsPerSide * 2 : 0; }
+
+  // False when rays from this camera position always need full integration
+  // (camera inside / next to the disk slab, or beyond the tabulated radius)
+  bool covers(const Vector3 &cameraPos) const;
+
+  // Shade one primary ray from the table. Returns false when the ray cannot be
+  // handled (grazing the disk, impact parameter beyond the table) and must be
+  // traced with BlackHole::trace instead.
+  bool trace(const BlackHole &blackHole, const Ray &ray, const ShadingParams &shading,
+             double stepSize, double maxDist, Vector3 &color) const;
+
+private:
+  // Storage: either our own vectors (just built) or a read-only file mapping
+  std::vector<uint8_t> ownedData;
+  void *mappedData;
+  size_t mappedSize;
+
+  const OrbitTableHeader *header;
+  const OrbitRecord *records;
+  const OrbitSample *samples;
+
+  void build(const BlackHole &blackHole);
+  bool save(const std::string &path) const;
+  bool map(const std::string &path, const BlackHole &blackHole);
+  void unmap();
+  bool bindStorage(const uint8_t *data, size_t size);
+
+  // Continuous orbit index for b (orbits are sorted by increasing b)
+  double orbitCoordinate(double b) const;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "../utils/Vector3.hpp"
+#include <cmath>
+
+/**
+ * Plane of a photon orbit around the origin. theta is measured from the ray's
+ * starting radius (e1) towards its transverse direction (e2), so the ray always
+ * sweeps towards increasing theta; u = 1/r along the orbit.
+ */
+struct OrbitalPlane {
+  Vector3 e1;
+  Vector3 e2;
+  double r0;     // Start radius
+  double cosPsi; // Angle between the ray and the outward radial at the start
+  double sinPsi;
+
+  OrbitalPlane(const Vector3 &origin, const Vector3 &direction) {
+    r0 = origin.length();
+    e1 = origin / r0;
+    cosPsi = direction.dot(e1);
+    Vector3 transverse = direction - e1 * cosPsi;
+    sinPsi = transverse.length();
+    if (sinPsi < 1e-9) {
+      // Radial ray: any plane through the start point works
+      e2 = e1.cross(std::abs(e1.y) < 0.9 ? Vector3(0, 1, 0) : Vector3(1, 0, 0)).normalized();
+    } else {
+      e2 = transverse / sinPsi;
+    }
+  }
+
+  // Impact parameter |origin x direction|
+  double impactParameter() const { return r0 * sinPsi; }
+
+  // du/dtheta at the start point
+  double initialSlope() const { return -cosPsi / (r0 * sinPsi); }
+
+  // Orbit constant 1/b^2 = (du/dtheta)^2 + u^2 - rs*u^3 of the curve through the start point
+  double inverseImpactSquared(double rs) const {
+    double u = 1.0 / r0;
+    double w = initialSlope();
+    return w * w + u * u - rs * u * u * u;
+  }
+
+  Vector3 radial(double theta) const { return e1 * std::cos(theta) + e2 * std::sin(theta); }
+
+  Vector3 position(double theta, double u) const { return radial(theta) / u; }
+
+  // Height above the disk plane without building the full position
+  double height(double theta, double u) const {
+    return (e1.y * std::cos(theta) + e2.y * std::sin(theta)) / u;
+  }
+
+  // Unit direction of travel at theta given du/dtheta
+  Vector3 tangent(double theta, double u, double dudTheta) const {
+    double c = std::cos(theta);
+    double s = std::sin(theta);
+    Vector3 radialDir = e1 * c + e2 * s;
+    Vector3 angularDir = e2 * c - e1 * s;
+    return (radialDir * (-dudTheta / (u * u)) + angularDir / u).normalized();
+  }
+};
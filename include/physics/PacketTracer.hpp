@@ -0,0 +1,100 @@
+#pragma once
+#include "BlackHole.hpp"
+#include <cstdint>
+
+/**
+ * Instruction set used by the packet kernel (picked once at startup)
+ */
+enum class PacketIsa {
+  Generic = 0, // Portable 4-lane build (NEON on Apple Silicon, SSE2 on old x86)
+  SSE4 = 1,    // 4 lanes
+  AVX2 = 2,    // 8 lanes
+  AVX512 = 3   // 16 lanes
+};
+
+/**
+ * Structure-of-arrays block of rays advanced in lockstep by a packet kernel.
+ * Lanes [count, width) are padding and stay masked off for the whole trace.
+ */
+struct alignas(64) RayPacket {
+  static constexpr int MAX_LANES = 16;
+
+  int count; // Valid lanes
+
+  // Inputs (directions must be normalized)
+  float originX[MAX_LANES];
+  float originY[MAX_LANES];
+  float originZ[MAX_LANES];
+  float dirX[MAX_LANES];
+  float dirY[MAX_LANES];
+  float dirZ[MAX_LANES];
+
+  // Outputs: accumulated disk emission, remaining transmittance and exit direction
+  float colorR[MAX_LANES];
+  float colorG[MAX_LANES];
+  float colorB[MAX_LANES];
+  float transmittance[MAX_LANES];
+  float exitX[MAX_LANES];
+  float exitY[MAX_LANES];
+  float exitZ[MAX_LANES];
+  uint8_t escaped[MAX_LANES]; // 1 = left the scene (background visible), 0 = captured
+};
+
+/**
+ * Scalar parameters shared by every lane of a packet
+ */
+struct PacketKernelParams {
+  float rs;
+  float time;
+  int colorMode;
+  float colorIntensity;
+  int doppler; // 0 = disk seen at rest (delta = 1)
+  float stepSize;
+  float maxDist;
+  HitRecord *records; // One per lane to record the paths into (null = not recording)
+};
+
+using PacketKernel = void (*)(RayPacket &packet, const PacketKernelParams &params);
+
+// Per-ISA kernel entry points, each compiled in its own translation unit with
+// matching -m flags. Only the generic kernel exists on non-x86 targets.
+namespace packet_kernels {
+void traceGeneric(RayPacket &packet, const PacketKernelParams &params);
+#if defined(__x86_64__) || defined(__i386__)
+void traceSSE4(RayPacket &packet, const PacketKernelParams &params);
+void traceAVX2(RayPacket &packet, const PacketKernelParams &params);
+void traceAVX512(RayPacket &packet, const PacketKernelParams &params);
+#endif
+} // namespace packet_kernels
+
+/**
+ * Float SIMD ray-packet tracer equivalent to BlackHole::trace (RK4, same step
+ * heuristic, same disk/Doppler model), dispatched to the widest supported ISA.
+ */
+class PacketTracer {
+public:
+  explicit PacketTracer(const BlackHole &blackHole);
+
+  // Widest instruction set supported by this CPU (and compiled into the binary)
+  static PacketIsa detectIsa();
+  static int lanesFor(PacketIsa isa);
+  static const char *isaName(PacketIsa isa);
+
+  // Force a narrower ISA (clamped to what the CPU supports), e.g. for comparisons
+  void setIsa(PacketIsa isa);
+
+  PacketIsa isa() const { return selectedIsa; }
+  int width() const { return lanes; }
+
+  // Trace packet.count (<= width()) rays and write final HDR colors (disk + background).
+  // With `records` (packet.count of them, hit lists empty) each lane's path is also recorded
+  // like BlackHole::trace records it, so shadeHits() reshades what this kernel traced.
+  void trace(RayPacket &packet, const ShadingParams &shading, double stepSize,
+             double maxDist, Vector3 *colors, HitRecord *records = nullptr) const;
+
+private:
+  const BlackHole &blackHole;
+  PacketIsa selectedIsa;
+  int lanes;
+  PacketKernel kernel;
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include "BlackHole.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Cubemap of trace results around one camera position.
+ *
+ * From a fixed position a ray's fate depends only on its initial direction, so
+ * rotating the view or changing the FOV only resamples the map. Texels store
+ * HitRecords rather than colours (the disk and starfield move with time); each
+ * frame shades the texels it touches once, on first use, and output pixels
+ * interpolate them bilinearly.
+ */
+class SkyMap {
+public:
+  SkyMap();
+
+  SkyMap(const SkyMap &) = delete;
+  SkyMap &operator=(const SkyMap &) = delete;
+
+  // Trace every texel of a faceSize^2 x 6 map from `position` on the pool
+  void build(const BlackHole &blackHole, const Vector3 &position, int faceSize, double stepSize,
+             double maxDist, ThreadPool &pool, TraceStats *stats = nullptr);
+
+  bool isReady() const { return faceSize > 0; }
+  const Vector3 &center() const { return origin; }
+  int size() const { return faceSize; }
+  size_t hitCount() const;
+
+  // Invalidate last frame's shaded texels
+  void beginFrame(const ShadingParams &shading);
+
+  // Colour seen along `dir` from center() with the current frame's shading (thread-safe)
+  Vector3 sample(const BlackHole &blackHole, const Vector3 &dir) const;
+
+private:
+  struct Texel {
+    uint32_t first; // Into its band's hit list
+    uint32_t count;
+    float escapeDir[3];
+    uint32_t escaped;
+  };
+
+  Vector3 origin;
+  int faceSize;
+  int bandRows;
+  std::vector<Texel> texels;                // Face-major, then row, then column
+  std::vector<std::vector<DiskHit>> bands;  // Hits of bandRows rows of one face
+
+  // Per-frame lazily shaded colours; a texel's colour is valid when its stamp equals frame
+  ShadingParams shading;
+  uint32_t frame;
+  mutable std::vector<float> colors;
+  std::unique_ptr<std::atomic<uint32_t>[]> stamps;
+
+  Vector3 texelDirection(int face, int x, int y) const;
+  Vector3 texelColor(const BlackHole &blackHole, size_t index) const;
+};
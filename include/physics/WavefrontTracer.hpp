@@ -0,0 +1,65 @@
+#pragma once
+#include "BlackHole.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Wavefront RK4 tracer for a whole frame of rays.
+ *
+ * Ray state lives in structure-of-arrays buffers. Each pass advances every live ray by
+ * one step and then compacts out the rays that finished (horizon, escape, transmittance
+ * below 0.01), so threads and the vectorized step loop only ever work on live rays, however
+ * long the photon-ring tail is. Same physics as BlackHole::trace with Integrator::RK4 and
+ * slab stepping.
+ */
+class WavefrontTracer {
+public:
+  explicit WavefrontTracer(const BlackHole &blackHole);
+
+  WavefrontTracer(const WavefrontTracer &) = delete;
+  WavefrontTracer &operator=(const WavefrontTracer &) = delete;
+
+  // Size the buffers for rayCount rays and drop the previous wave
+  void reset(size_t rayCount);
+
+  // Start ray `index` of the wave; rays resolved without integration (missing the bounding
+  // sphere, captured) finish here. Thread-safe for distinct indices.
+  void setRay(size_t index, const Ray &ray, const ShadingParams &shading, TraceStats *stats = nullptr);
+
+  // Advance every live ray to completion, one step per pass, on the pool
+  void run(ThreadPool &pool, const ShadingParams &shading, double stepSize, double maxDist,
+           TraceStats *stats = nullptr);
+
+  // Final HDR colour of ray `index` (valid after run())
+  const Vector3 &color(size_t index) const { return colors[index]; }
+
+  // Live rays at the start of each pass of the last run: the convergence tail
+  const std::vector<size_t> &activeCounts() const { return passCounts; }
+
+private:
+  const BlackHole &blackHole;
+  size_t rayCount;
+  std::vector<Vector3> colors; // By ray index
+
+  // Live ray state, compacted to [0, active) between passes
+  std::vector<double> posX, posY, posZ;
+  std::vector<double> velX, velY, velZ;
+  std::vector<double> prevX, prevY, prevZ; // Start of the last step
+  std::vector<double> colorR, colorG, colorB;
+  std::vector<double> transmittance;
+  std::vector<double> distance;
+  std::vector<double> stepScale;
+  std::vector<uint32_t> rayIndex;
+  std::vector<uint8_t> live;
+
+  std::vector<size_t> passCounts;
+  std::vector<size_t> chunkLive; // Survivors per chunk in the current pass
+
+  void step(size_t begin, size_t end, double stepSize);
+  void retire(size_t begin, size_t end, const ShadingParams &shading, double stepSize, double maxDist);
+  size_t compactChunk(size_t begin, size_t end);
+  void moveRay(size_t from, size_t to);
+};
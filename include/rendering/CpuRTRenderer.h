@@ -0,0 +1,90 @@
+#ifndef CPU_RT_RENDERER_H
+#define CPU_RT_RENDERER_H
+
+// CPU backend extensions to the MetalRTRenderer.h C API.
+// Built instead of MetalRTRenderer.mm when compiling with RENDERER=cpu
+// (defines BLACKHOLE_CPU_RENDERER); the metal_rt_renderer_* contract is unchanged.
+
+#include "MetalRTRenderer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Tunables for the tiled CPU tracer. Defaults are set in one place (defaultOptions in
+// CpuRTRenderer.cpp); the environment only picks threads, tile size, SIMD, integrator, the
+// render mode (BLACKHOLE_CPU_MODE) and the hit cache, plus the startup kernel benchmark
+// (BLACKHOLE_CPU_KERNEL_BENCHMARK). Render modes are alternatives: progressive,
+// temporal, checkerboard, adaptive, wavefront, sky map and orbit table each replace plain tracing.
+typedef struct {
+  int threadCount; // Worker threads, 0 = hardware concurrency
+  int tileSize;    // Square tile edge in pixels
+  int useSimd;     // 1 = float ray-packet kernel, 0 = scalar double BlackHole::trace
+  int simdIsa;     // Widest PacketIsa allowed (0=generic, 1=SSE4, 2=AVX2, 3=AVX-512)
+  int useOrbitTable; // 1 = shade primary rays from the precomputed orbit table where possible
+  int integrator;  // Integrator for traced rays (0=RK4, 1=Binet, 2=RK45); the packet kernel is RK4 only
+  double tolerance; // Per-ray local error tolerance for the RK45 integrator
+  int boundingSphere; // 1 = closed-form propagation outside the disk's bounding sphere (scalar paths)
+  int classifyRays;   // 1 = pre-classify scalar-traced rays by impact parameter (captured / near-critical)
+  int slabStepping;   // 1 = geometry-only steps with emission integrated over each in-slab segment (scalar paths)
+  int useHitCache;    // 1 = record geodesics once the camera is still and reshade until it moves (packet or per-pixel trace)
+  int useSkyMap;      // 1 = resample a cubemap of trace results built around the camera position
+  int skyMapSize;     // Cubemap face edge in texels
+  double skyMapMove;  // Camera movement (world units) that triggers a cubemap rebuild
+  int adaptive;       // 1 = trace block corners and subdivide only where neighbours disagree (scalar path)
+  int wavefront;      // 1 = advance the whole frame's live rays one RK4 step per pass (RK4 + slab stepping)
+  double progressiveBudgetMs; // > 0 = coarse pass, then refine tiles until this much of the frame is spent
+  int temporalAA;     // 1 = jitter the ray in each pixel every frame and blend into a history while the camera is still
+  int checkerboard;   // 1 = trace alternating halves of the pixels, rebuild the other half from the last frame
+  int diskTexture;    // 1 = sample the disk pattern from a baked polar texture instead of evaluating it
+  int emissionTable;  // 1 = look disk palette and Doppler boost up in a (radius, Doppler) table
+  int doppler;        // 1 = Doppler colour shift and beaming of the disk, 0 = disk seen at rest
+  int specializedKernels; // 1 = scalar trace kernels compiled per integrator, palette and flags, 0 = generic
+} CpuRenderOptions;
+
+// Statistics for the most recent frame
+typedef struct {
+  double frameMs;                  // Wall time of the last render call
+  unsigned long long raysTraced;   // Primary rays shaded this frame
+  unsigned long long tableRays;    // ... of which resolved by orbit table lookup (no integration)
+  double stepsPerRay;              // Average integration steps per scalar-traced ray (0 if none)
+  unsigned long long capturedRays; // Scalar-traced captured rays drawn black without integration (clear of the disk)
+  unsigned long long nearCriticalRays; // Scalar-traced rays given the fine step budget
+  int threadCount;                 // Workers that shared the frame
+  int tileCount;                   // Tiles the frame was split into
+  int simdLanes;                   // Rays per packet (1 = scalar path)
+  const char *kernelName;          // "RK4"/"Binet"/"RK45" (scalar), "SSE4", "AVX2", "AVX-512", "Generic", "Orbit table", "Hit cache", "Sky map", "Wavefront"
+  int hitCacheState;               // 0 = traced, 1 = traced and recorded into the hit cache, 2 = reshaded from it
+  unsigned long long cachedHits;   // Disk hits held by the hit cache (or the sky map)
+  int skyMapRebuilt;               // 1 = the sky map was re-traced this frame
+  double adaptiveSavedPercent;     // Share of pixels interpolated instead of traced (adaptive mode)
+  int wavefrontPasses;             // Step passes of the last wavefront frame (0 = not wavefront)
+  int progressiveStride;           // Coarsest pixel stride still on screen (1 = converged, 0 = not progressive)
+  double progressiveConverged;     // Share of tiles traced at full resolution (progressive mode)
+  int temporalSamples;             // Jittered frames blended since the history was reset (0 = not temporal)
+  int checkerboardFill;            // How the untraced half was filled: 1 = previous frame, 2 = spatial (0 = off)
+} CpuRenderStats;
+
+// Read / replace the renderer options (defaults: see CpuRenderOptions)
+void cpu_rt_renderer_get_options(const MetalRTRenderer *renderer, CpuRenderOptions *options);
+void cpu_rt_renderer_set_options(MetalRTRenderer *renderer, const CpuRenderOptions *options);
+
+// Get statistics for the last rendered frame
+void cpu_rt_renderer_get_stats(const MetalRTRenderer *renderer, CpuRenderStats *stats);
+
+// Copy up to maxCounts live-ray counts, one per pass of the last wavefront frame; returns
+// the number of passes (stats.wavefrontPasses)
+int cpu_rt_renderer_get_active_counts(const MetalRTRenderer *renderer, unsigned long long *counts, int maxCounts);
+
+#ifdef __cplusplus
+}
+
+class ThreadPool;
+
+// The renderer's worker pool, for frame work done between renders (the upscaler), so it
+// shares these threads rather than oversubscribing the cores with its own. Replaced when
+// threadCount changes: fetch it again after changing the options.
+ThreadPool *cpu_rt_renderer_get_thread_pool(MetalRTRenderer *renderer);
+#endif
+
+#endif // CPU_RT_RENDERER_H
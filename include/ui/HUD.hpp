@@ -12,8 +12,8 @@ class HUD {
 public:
   HUD(SDL_Renderer *renderer, TTF_Font *font);
   
-  // Render the hints overlay
-  void renderHints(bool showHints, CinematicMode mode, int fps, int windowWidth, int windowHeight, class ResolutionManager* resolutionManager, int colorMode = 0, float colorIntensity = 1.0f, bool isMusicMuted = false);
+  // Render the hints overlay (autoWidth/autoHeight: dynamic resolution trace size, 0 = off)
+  void renderHints(bool showHints, CinematicMode mode, int fps, int windowWidth, int windowHeight, class ResolutionManager* resolutionManager, int colorMode = 0, float colorIntensity = 1.0f, bool isMusicMuted = false, int autoWidth = 0, int autoHeight = 0);
   
   // Render music credits
   void renderMusicCredits(bool isMusicMuted, int windowWidth, int windowHeight);
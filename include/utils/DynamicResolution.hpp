@@ -0,0 +1,49 @@
+#pragma once
+
+/**
+ * Automatic render scale that holds a target frame time.
+ *
+ * Trace cost is roughly proportional to the pixel count, so a frame that took
+ * t ms at scale s would have hit the target at s * sqrt(target / t). The
+ * controller smooths the measured times and only resizes once the smoothed time
+ * leaves a +-hysteresis band around the target, and not again until the new size
+ * has settled, so per-frame noise and camera-driven cost swings do not make the
+ * resolution flicker. Unlike the presets the scale is continuous.
+ */
+class DynamicResolution {
+public:
+  DynamicResolution(double targetMs, double hysteresis);
+
+  // Full-resolution size (scale 1); keeps the current scale
+  void setOutputSize(int width, int height);
+
+  void setTargetMs(double ms);
+  double getTargetMs() const { return targetMs; }
+
+  // Fraction of the target the smoothed time may drift before the size changes
+  void setHysteresis(double fraction);
+
+  // Feed the trace time of the last frame; returns true if the render size changed
+  bool update(double traceMs);
+
+  // Back to full resolution with no timing history
+  void reset();
+
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  double getScale() const { return scale; }
+  double getSmoothedMs() const { return smoothedMs; }
+
+private:
+  int outputWidth;
+  int outputHeight;
+  int width;
+  int height;
+  double targetMs;
+  double hysteresis;
+  double scale;
+  double smoothedMs;
+  int samples; // Frame times measured at the current size
+
+  void applyScale(double newScale);
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Reusable BGRA frame buffers for captures (recording and screenshots)
+ *
+ * Every buffer holds one frame at the current output size, so a capture of that
+ * size or smaller takes an idle buffer instead of allocating and page-faulting a
+ * fresh one. Buffers come back through release() from whichever thread finished
+ * with them (the encoder thread for recorded frames). Only resize() throws buffers
+ * away; frames still in use at that point are freed when they are released.
+ */
+class FramePool {
+public:
+  struct Frame {
+    std::vector<uint8_t> pixels; // Buffer of the pool's frame size (larger for an oversized one-off)
+    int width = 0;               // Image currently held (tightly packed, 4 bytes per pixel)
+    int height = 0;
+    FramePool *owner = nullptr;
+    uint64_t generation = 0;     // Pool generation it was allocated in (0 = not pooled)
+    std::chrono::steady_clock::time_point capturedAt; // Set when handed to the recorder
+  };
+
+  FramePool();
+  ~FramePool();
+
+  FramePool(const FramePool &) = delete;
+  FramePool &operator=(const FramePool &) = delete;
+
+  // New output size: drops every idle buffer (in-use ones are dropped when released)
+  void resize(int width, int height);
+
+  // Allocate idle buffers until `count` exist at the current size
+  void reserve(int count);
+
+  // A buffer for a width x height image: an idle one if it fits in the pool's frame
+  // size, otherwise a one-off allocation that release() frees
+  Frame *acquire(int width, int height);
+
+  // Return a frame from acquire(); safe from any thread
+  void release(Frame *frame);
+
+  uint64_t allocations() const; // Buffers allocated since construction
+  int frameCount() const;       // Pooled buffers alive (idle and in use)
+  size_t bytes() const;         // Memory held by them
+
+private:
+  mutable std::mutex mutex;
+  std::vector<std::unique_ptr<Frame>> idle;
+  size_t frameBytes;
+  uint64_t generation;
+  int liveFrames;
+  uint64_t allocationCount;
+
+  std::unique_ptr<Frame> allocate(size_t bytes, uint64_t frameGeneration);
+};
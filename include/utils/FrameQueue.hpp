@@ -0,0 +1,77 @@
+#pragma once
+
+#include "FramePool.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Single-producer, single-consumer queue of frame slots
+ *
+ * The render thread acquires a free slot, attaches a captured frame and publishes it;
+ * the encoder thread takes published slots in order and hands them back once encoded.
+ * The queue bounds how many frames are in flight; the pixels live in a FramePool.
+ * Slots travel through two pointer rings (free and ready) whose head and tail are
+ * monotonic counters written by one side each, so neither side takes a lock. Only an
+ * empty queue (consumer) or a full one under FullPolicy::Block (producer) sleeps, on
+ * the other side's counter.
+ */
+class FrameQueue {
+public:
+  // What acquire() does when every slot is still waiting to be encoded
+  enum class FullPolicy {
+    Block, // Wait for the encoder to release a slot (no frame is lost)
+    Drop,  // Return nullptr; the caller skips the frame
+    Grow   // Add another slot, up to slotLimit, then block
+  };
+
+  struct Slot {
+    FramePool::Frame *frame = nullptr;
+    int64_t index = 0; // Producer sequence number (dropped frames leave gaps)
+  };
+
+  // Starts with initialSlots slots; Grow may add more, up to slotLimit in all, each time
+  // the queue is full
+  FrameQueue(int initialSlots, FullPolicy policy, int slotLimit = 0);
+
+  FrameQueue(const FrameQueue &) = delete;
+  FrameQueue &operator=(const FrameQueue &) = delete;
+
+  // Producer: next free slot, or nullptr if the frame is dropped (or the queue is closed)
+  Slot *acquire();
+  // Producer: hand the slot from the last acquire() to the consumer
+  void publish();
+  // Producer: no more frames; the consumer drains what is queued, then front() returns nullptr
+  void close();
+
+  // Consumer: oldest published slot, waiting for one if the queue is empty
+  Slot *front();
+  // Consumer: give the slot from front() back to the producer
+  void pop();
+
+  int depth() const;
+  int capacity() const { return slotCount.load(std::memory_order_relaxed); }
+  uint64_t dropped() const { return droppedFrames.load(std::memory_order_relaxed); }
+  FullPolicy policy() const { return fullPolicy; }
+
+private:
+  std::vector<std::unique_ptr<Slot>> slots; // Every slot created so far (producer only)
+  std::vector<Slot *> freeRing;  // Released slots, consumer -> producer
+  std::vector<Slot *> readyRing; // Published slots, producer -> consumer
+  size_t maxSlots;               // Ring size: no more slots than this ever exist
+  FullPolicy fullPolicy;
+  int64_t sequence;              // Frames offered to acquire(), dropped ones included (producer only)
+  Slot *pending;                 // Slot from the last acquire() (producer only)
+  Slot *current;                 // Slot from the last front() (consumer only)
+
+  std::atomic<uint64_t> freeHead;  // Written by the consumer
+  std::atomic<uint64_t> freeTail;  // Written by the producer
+  std::atomic<uint64_t> readyHead; // Written by the producer
+  std::atomic<uint64_t> readyTail; // Written by the consumer
+  std::atomic<uint32_t> events;    // Bumped on publish and close; the consumer sleeps on it
+  std::atomic<int> slotCount;
+  std::atomic<bool> closed;
+  std::atomic<uint64_t> droppedFrames;
+};
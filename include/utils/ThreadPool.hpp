@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Work-stealing thread pool for data-parallel frame work (tiles, ray batches)
+ *
+ * Each worker owns a deque seeded with a contiguous block of indices. Workers pop
+ * from the front of their own deque and, once empty, steal from the back of the
+ * others, so a few expensive tiles (photon ring, disk) do not stall the frame.
+ */
+class ThreadPool {
+public:
+  // threadCount = 0 uses std::thread::hardware_concurrency()
+  explicit ThreadPool(unsigned threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // Number of workers including the calling thread (worker ids are [0, size()))
+  unsigned size() const { return static_cast<unsigned>(queues.size()); }
+
+  // Run task(index, workerId) for every index in [0, count) and block until done.
+  // The calling thread participates as worker 0.
+  void parallelFor(size_t count, const std::function<void(size_t, unsigned)> &task);
+
+private:
+  struct WorkQueue {
+    std::mutex mutex;
+    std::deque<size_t> indices;
+  };
+
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  std::vector<std::thread> threads;
+
+  std::mutex stateMutex;
+  std::condition_variable startCondition;
+  std::condition_variable doneCondition;
+  const std::function<void(size_t, unsigned)> *currentTask;
+  uint64_t generation;
+  unsigned activeWorkers;
+  bool stopping;
+
+  void workerLoop(unsigned workerId);
+  void drain(unsigned workerId, const std::function<void(size_t, unsigned)> &task);
+  bool popLocal(unsigned workerId, size_t &index);
+  bool steal(unsigned thiefId, size_t &index);
+};
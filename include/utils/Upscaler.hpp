@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Edge-aware upscaler for BGRA8 frames.
+ *
+ * Each output pixel filters the 4x4 source texels around it with separable
+ * Catmull-Rom weights, blended toward a tent along the local luma edge, so the
+ * photon ring and disk rim stay crisp across while their staircase is smoothed
+ * along. The result is clamped to the 2x2 nearest texels, which removes the
+ * kernel's ringing; flat areas are blended bilinearly.
+ */
+class Upscaler {
+public:
+  Upscaler();
+  ~Upscaler();
+
+  Upscaler(const Upscaler &) = delete;
+  Upscaler &operator=(const Upscaler &) = delete;
+
+  // Resample src (srcWidth x srcHeight) into dst (dstWidth x dstHeight), both tightly packed
+  void upscale(const uint8_t *src, int srcWidth, int srcHeight, uint8_t *dst, int dstWidth, int dstHeight);
+
+  // Run on the caller's pool (not owned) instead of starting threads of its own; nullptr
+  // goes back to an own pool, created on first use
+  void setThreadPool(ThreadPool *shared);
+
+private:
+  ThreadPool *sharedPool;
+  std::unique_ptr<ThreadPool> ownPool;
+  std::vector<uint8_t> padded; // Current source frame with a clamped border
+  std::vector<float> luma;     // Its luma
+  std::vector<int> columnTexel; // Source texel left of each output column
+  std::vector<float> columnFraction;
+};
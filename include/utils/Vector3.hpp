@@ -1,69 +1,75 @@
 #pragma once
 #include <cmath>
 #include <iostream>
+#include <type_traits>
 
-struct Vector3 {
-  double x, y, z;
+// 3-component vector over a scalar type (the tracer uses Vector3, in double)
+template <typename T> struct Vector3T {
+  T x, y, z;
 
-  constexpr Vector3() : x(0), y(0), z(0) {}
-  constexpr Vector3(double x, double y, double z) : x(x), y(y), z(z) {}
+  constexpr Vector3T() : x(0), y(0), z(0) {}
+  constexpr Vector3T(T x, T y, T z) : x(x), y(y), z(z) {}
 
-  Vector3 operator+(const Vector3 &other) const {
+  Vector3T operator+(const Vector3T &other) const {
     return {x + other.x, y + other.y, z + other.z};
   }
-  Vector3 operator-(const Vector3 &other) const {
+  Vector3T operator-(const Vector3T &other) const {
     return {x - other.x, y - other.y, z - other.z};
   }
-  Vector3 operator*(double scalar) const {
+  Vector3T operator*(T scalar) const {
     return {x * scalar, y * scalar, z * scalar};
   }
-  Vector3 operator/(double scalar) const {
+  Vector3T operator/(T scalar) const {
     return {x / scalar, y / scalar, z / scalar};
   }
-  Vector3 operator*(const Vector3 &other) const {
+  Vector3T operator*(const Vector3T &other) const {
     return {x * other.x, y * other.y, z * other.z};
   }
-  Vector3 operator/(const Vector3 &other) const {
+  Vector3T operator/(const Vector3T &other) const {
     return {x / other.x, y / other.y, z / other.z};
   }
 
-  Vector3 &operator+=(const Vector3 &other) {
+  Vector3T &operator+=(const Vector3T &other) {
     x += other.x;
     y += other.y;
     z += other.z;
     return *this;
   }
-  Vector3 &operator-=(const Vector3 &other) {
+  Vector3T &operator-=(const Vector3T &other) {
     x -= other.x;
     y -= other.y;
     z -= other.z;
     return *this;
   }
-  Vector3 &operator*=(double scalar) {
+  Vector3T &operator*=(T scalar) {
     x *= scalar;
     y *= scalar;
     z *= scalar;
     return *this;
   }
 
-  double dot(const Vector3 &other) const {
+  T dot(const Vector3T &other) const {
     return x * other.x + y * other.y + z * other.z;
   }
-  Vector3 cross(const Vector3 &other) const {
+  Vector3T cross(const Vector3T &other) const {
     return {y * other.z - z * other.y, z * other.x - x * other.z,
             x * other.y - y * other.x};
   }
 
-  double lengthSquared() const { return x * x + y * y + z * z; }
-  double length() const { return std::sqrt(lengthSquared()); }
+  T lengthSquared() const { return x * x + y * y + z * z; }
+  T length() const { return std::sqrt(lengthSquared()); }
 
-  Vector3 normalized() const {
-    double len = length();
-    return (len > 0) ? *this / len : Vector3{0, 0, 0};
+  Vector3T normalized() const {
+    T len = length();
+    return (len > 0) ? *this / len : Vector3T{0, 0, 0};
   }
 };
 
-inline Vector3 operator*(double scalar, const Vector3 &v) { return v * scalar; }
+template <typename T> inline Vector3T<T> operator*(std::type_identity_t<T> scalar, const Vector3T<T> &v) {
+  return v * scalar;
+}
+
+using Vector3 = Vector3T<double>;
 
 struct Ray {
   Vector3 origin;
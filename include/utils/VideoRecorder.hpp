@@ -1,10 +1,49 @@
 #pragma once
 
+#include "FrameQueue.hpp"
+#include <atomic>
+#include <chrono>
 #include <string>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct AVStream;
+struct FFmpegContext;
+
+// Encoder queue counters (VideoRecorder::getStats)
+struct RecorderStats {
+  int queueDepth;         // Frames waiting for the encoder right now
+  int maxQueueDepth;      // Deepest the queue got this recording
+  int queueSlots;         // Slots in use (grows under FullPolicy::Grow)
+  uint64_t framesQueued;
+  uint64_t framesEncoded;
+  uint64_t droppedFrames; // Frames skipped because the queue was full (FullPolicy::Drop)
+  double lastLatencyMs;   // Captured -> packets written, last frame
+  double averageLatencyMs;
+  double maxLatencyMs;
+  int peakEncoders;       // Segment encoders encoding at the same moment, at most (segmented)
+  double averageEncoders; // Encoding time over recording time: encoders busy on average
+};
 
 /**
  * Video recorder for capturing frames and encoding to video file with audio
+ *
+ * addFrame only queues a captured FramePool frame; colour conversion, encoding and
+ * muxing run on a dedicated encoder thread, so the render thread does not pay for
+ * x264. The frame goes back to its pool once encoded. What happens when the encoder
+ * falls behind is the queue policy.
+ *
+ * With segmented encoding the encoder thread only dispatches: each fixed-length,
+ * closed-GOP segment goes whole to one of several encoder workers, and finished
+ * segments are stream-copied into the output in order as they come in.
+ *
+ * A marker file in the app's cache directory exists while a session is open, locked
+ * by this process, so a recording interrupted by a crash is found and recovered on
+ * the next start.
  */
 class VideoRecorder {
 public:
@@ -14,11 +53,39 @@ public:
   // Start recording to a file
   bool startRecording(const std::string& filename, int width, int height, int fps = 60, const std::string& audioFile = "");
   
-  // Stop recording and finalize video file (mixes audio if provided)
+  // Stop recording and finalize video file (audio, if provided, is muxed in while recording)
   void stopRecording();
   
-  // Add a frame to the video (ARGB8888 format, 4 bytes per pixel)
-  bool addFrame(const void* pixels, int width, int height);
+  // Add a frame to the video (ARGB8888 format, 4 bytes per pixel). Takes ownership: the
+  // frame is released to its pool once encoded, or right away if it is not queued (size
+  // mismatch, or dropped because the queue was full), in which case this returns false.
+  bool addFrame(FramePool::Frame* frame);
+
+  // Full-queue policy and slot count for the next recording (Grow may reach maxSlots)
+  void setQueuePolicy(FrameQueue::FullPolicy policy, int slots, int maxSlots = 0);
+
+  // Encode segments of `seconds` on `workers` encoders in parallel (next recording; 0 = off).
+  // Each encoder holds up to `slotsPerWorker` raw frames (0 = a whole segment, so encoders
+  // never wait on each other); the dispatcher waits beyond that.
+  void setSegmentedEncoding(double seconds, int workers, int slotsPerWorker);
+
+  // Write the recording as fragmented MP4, one fragment every `seconds` (next recording;
+  // 0 = a regular MP4, indexed when it is finished)
+  void setFragmentDuration(double seconds);
+
+  // Most frames in flight (queued plus being encoded)
+  int getMaxFramesInFlight() const;
+
+  // Frames worth reserving in a FramePool up front. Segmented, this is a few per encoder
+  // rather than whole segments; the pool grows to the rest only if encoders fall behind.
+  int getFramesToReserve() const;
+
+  RecorderStats getStats() const;
+
+  // Recover recordings whose session never stopped cleanly (app killed or crashed), as
+  // listed by the markers in the app's cache directory: rebuilt from their finished
+  // segments with their music, or re-indexed if fragmented. Returns the recovered files.
+  static std::vector<std::string> recoverSessions();
   
   // Check if currently recording
   bool isRecording() const { return recording; }
@@ -29,6 +96,9 @@ public:
   // Move the recorded file to a new location (for save dialog)
   bool moveFile(const std::string& newPath);
 
+  // Move any file, renaming if possible and copying across filesystems
+  static bool moveFile(const std::string& from, const std::string& newPath);
+
 private:
   bool recording;
   std::string filename;
@@ -37,14 +107,68 @@ private:
   int frameHeight;
   int frameRate;
   void* ffmpegContext; // Opaque pointer to FFmpeg context
+
+  FrameQueue::FullPolicy queuePolicy;
+  int queueSlots;
+  int queueMaxSlots;
+  std::unique_ptr<FrameQueue> frameQueue;
+  std::thread encoderThread;
+  int maxQueueDepth; // Render thread only
+  uint64_t framesQueued;
+  std::atomic<uint64_t> framesEncoded;
+  std::atomic<uint64_t> lastLatencyUs;
+  std::atomic<uint64_t> totalLatencyUs;
+  std::atomic<uint64_t> maxLatencyUs;
+
+  // Segmented encoding
+  struct SegmentWorker;
+  struct FinishedSegment {
+    std::string path; // Empty if the segment could not be encoded
+    int64_t startFrame = 0;
+  };
+  double segmentSeconds;
+  int segmentWorkerCount;
+  int segmentSlots; // Raw frames each worker's queue holds (0 = a whole segment)
+  int segmentFrames; // This recording's segment length (0 = not segmented)
+  std::vector<std::unique_ptr<SegmentWorker>> segmentWorkers;
+  std::mutex segmentMutex; // Guards finishedSegments and the list file
+  std::map<int64_t, FinishedSegment> finishedSegments;
+  int64_t nextSegmentToAppend; // Encoder thread only, like segmentFiles
+  std::vector<std::string> segmentFiles;
+  std::string segmentListPath;
+  double fragmentSeconds;
+  std::atomic<int> encodersBusy; // Segment workers inside encodeFrame or flushEncoder
+  std::atomic<int> peakEncoders;
+  std::atomic<uint64_t> encoderBusyUs;
+  std::chrono::steady_clock::time_point recordingStart;
+  std::string markerPath; // Marker in the cache directory while the session is open (empty: none)
+  int markerFd; // Open and flock()ed for the whole session (-1: none)
   
   // Initialize FFmpeg encoder
   bool initializeEncoder();
+  bool openEncoder(FFmpegContext* ctx, const std::string& path, bool segment);
+
+  // Encoder thread: convert, encode and write queued frames until the queue is closed
+  // (segmented: hand them to the workers and append finished segments)
+  void encodeLoop();
+  bool encodeFrame(FFmpegContext* ctx, const FramePool::Frame& frame, int64_t index);
+  void flushEncoder(FFmpegContext* ctx);
+  // Release an encoded frame and record its capture -> encoded latency
+  void finishFrame(FramePool::Frame* frame);
+
+  // Worker thread: encode each segment fed through `queue` into its own file
+  void segmentLoop(FrameQueue* queue);
+  void finishSegment(int64_t segment, int64_t startFrame, const std::string& path, FFmpegContext* ctx);
+  int segmentWorkerSlots() const;
+  // Bracket a worker's encoding work, for the encoder overlap stats
+  std::chrono::steady_clock::time_point beginEncoding();
+  void endEncoding(std::chrono::steady_clock::time_point began);
+  // Append finished segments to the output: the next ones in order, or all that are left
+  void appendFinishedSegments(bool all);
+  bool appendSegment(const std::string& path, int64_t startFrame);
+  bool openSegmentedOutput(const AVStream* source);
   
   // Cleanup FFmpeg resources
   void cleanupEncoder();
-  
-  // Mux audio with video after recording
-  bool muxAudioWithVideo();
 };
 
@@ -2,6 +2,9 @@
 #include "../../include/utils/SaveDialog.h"
 #include "../../include/utils/IconLoader.h"
 #include "../../include/utils/Screenshot.h"
+#ifdef BLACKHOLE_CPU_RENDERER
+#include "../../include/rendering/CpuRTRenderer.h"
+#endif
 #include <iostream>
 #include <chrono>
 #include <string>
@@ -11,18 +14,61 @@
 #include <iomanip>
 #include <vector>
 #include <cstring>
+#include <cstdlib>
+#include <sys/resource.h>
 
 // External logging function from main.cpp
 extern void appLog(const std::string& message, bool isError = false);
 
+namespace {
+
+// Dynamic resolution defaults (BLACKHOLE_DYNAMIC_RES_MS / BLACKHOLE_DYNAMIC_RES_HYSTERESIS)
+constexpr double DEFAULT_TARGET_FRAME_MS = 1000.0 / 60.0;
+constexpr double DEFAULT_RESOLUTION_HYSTERESIS = 0.15;
+
+// Recordings are written here, then moved to where the user saves them
+const std::string RECORDING_DIRECTORY = "/tmp";
+
+double envDouble(const char *name, double fallback) {
+  const char *value = std::getenv(name);
+  return value && value[0] != '\0' ? std::atof(value) : fallback;
+}
+
+// Recorder queue policy (BLACKHOLE_RECORD_QUEUE = block, drop or grow)
+FrameQueue::FullPolicy envQueuePolicy(const char *name, FrameQueue::FullPolicy fallback) {
+  const char *value = std::getenv(name);
+  if (!value) {
+    return fallback;
+  }
+  if (std::strcmp(value, "drop") == 0) {
+    return FrameQueue::FullPolicy::Drop;
+  }
+  if (std::strcmp(value, "grow") == 0) {
+    return FrameQueue::FullPolicy::Grow;
+  }
+  if (std::strcmp(value, "block") == 0) {
+    return FrameQueue::FullPolicy::Block;
+  }
+  return fallback;
+}
+
+// Minor page faults of the process so far
+long minorPageFaults() {
+  struct rusage usage;
+  return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_minflt : 0;
+}
+
+} // namespace
+
 Application::Application()
     : window(nullptr), sdlRenderer(nullptr), font(nullptr), backgroundMusic(nullptr),
       gpuRenderer(nullptr), gpuTexture(nullptr),
       blackHole(nullptr), camera(nullptr), cinematicCamera(nullptr), hud(nullptr),
-      resolutionManager(nullptr), videoRecorder(nullptr),
+      resolutionManager(nullptr), dynamicResolution(nullptr), upscaler(nullptr), videoRecorder(nullptr), framePool(nullptr),
       windowWidth(1920), windowHeight(1080), renderWidth(1920), renderHeight(1080),
+      traceWidth(1920), traceHeight(1080), isDynamicResolution(false),
       isFullscreen(false), isResizing(false),
-      running(false), currentFPS(0), isRecording(false), colorMode(0), colorIntensity(1.0f), 
+      running(false), currentFPS(0), isRecording(false), recordStartAllocations(0), recordStartPageFaults(0), colorMode(0), colorIntensity(1.0f), 
       isMusicMuted(false), currentMusicVolume(1.0f), targetMusicVolume(1.0f), isMusicFading(false),
       currentElapsedTime(0.0) {}
 
@@ -48,6 +94,17 @@ bool Application::initialize() {
   renderWidth = res.width;
   renderHeight = res.height;
   std::cerr << "[OK] Resolution manager initialized: " << renderWidth << "x" << renderHeight << std::endl;
+
+  // Dynamic resolution: a positive target frame time in the environment turns it on at startup
+  double targetFrameMs = envDouble("BLACKHOLE_DYNAMIC_RES_MS", 0.0);
+  isDynamicResolution = targetFrameMs > 0.0;
+  dynamicResolution =
+      new DynamicResolution(isDynamicResolution ? targetFrameMs : DEFAULT_TARGET_FRAME_MS,
+                            envDouble("BLACKHOLE_DYNAMIC_RES_HYSTERESIS", DEFAULT_RESOLUTION_HYSTERESIS));
+  dynamicResolution->setOutputSize(renderWidth, renderHeight);
+  upscaler = new Upscaler();
+  traceWidth = renderWidth;
+  traceHeight = renderHeight;
   
   // Window size - use a reasonable default that matches common screen sizes
   // This will be the display size, rendering resolution is separate
@@ -123,6 +180,16 @@ bool Application::initialize() {
     std::cerr << "Failed to load font! TTF_Error: " << TTF_GetError() << std::endl;
   }
 
+#ifdef BLACKHOLE_CPU_RENDERER
+  // Initialize CPU renderer (tiled BlackHole::trace) behind the same C API
+  std::cerr << "[INIT] Initializing CPU renderer at " << renderWidth << "x" << renderHeight << "..." << std::endl;
+  gpuRenderer = metal_rt_renderer_create(renderWidth, renderHeight);
+  if (!gpuRenderer) {
+    std::cerr << "[ERROR] CPU renderer failed to initialize!" << std::endl;
+    return false;
+  }
+  std::cerr << "[OK] CPU renderer initialized successfully" << std::endl;
+#else
   // Initialize GPU renderer (Metal) with rendering resolution
   std::cerr << "[INIT] Initializing Metal renderer at " << renderWidth << "x" << renderHeight << "..." << std::endl;
   gpuRenderer = metal_rt_renderer_create(renderWidth, renderHeight);
@@ -132,6 +199,7 @@ bool Application::initialize() {
     return false;
   }
   std::cerr << "[OK] Metal renderer initialized successfully" << std::endl;
+#endif
 
   gpuTexture = SDL_CreateTexture(sdlRenderer, SDL_PIXELFORMAT_ARGB8888,
                                   SDL_TEXTUREACCESS_STREAMING, renderWidth, renderHeight);
@@ -150,6 +218,25 @@ bool Application::initialize() {
   camera->lookAt(Vector3(0, 0, 0));
   hud = new HUD(sdlRenderer, font);
   videoRecorder = new VideoRecorder();
+  videoRecorder->setQueuePolicy(envQueuePolicy("BLACKHOLE_RECORD_QUEUE", FrameQueue::FullPolicy::Block),
+                                static_cast<int>(envDouble("BLACKHOLE_RECORD_QUEUE_SLOTS", 4)),
+                                static_cast<int>(envDouble("BLACKHOLE_RECORD_QUEUE_MAX_SLOTS", 16)));
+  videoRecorder->setSegmentedEncoding(envDouble("BLACKHOLE_RECORD_SEGMENT_SECONDS", 0.0),
+                                     static_cast<int>(envDouble("BLACKHOLE_RECORD_ENCODERS", 2)),
+                                     static_cast<int>(envDouble("BLACKHOLE_RECORD_ENCODER_SLOTS", 0)));
+  videoRecorder->setFragmentDuration(envDouble("BLACKHOLE_RECORD_FRAGMENT_SECONDS", 0.0));
+
+  // Recordings left unfinished by a previous run that crashed or was killed: offered
+  // through the save dialog like a recording that was stopped
+  for (const std::string& recovered : VideoRecorder::recoverSessions()) {
+    appLog("[RECORDING] Recovered interrupted recording: " + recovered);
+    std::cout << "Recovered interrupted recording: " << recovered << std::endl;
+    saveRecording(recovered);
+  }
+  framePool = new FramePool();
+  int outputWidth, outputHeight;
+  SDL_GetRendererOutputSize(sdlRenderer, &outputWidth, &outputHeight);
+  framePool->resize(outputWidth, outputHeight);
 
   // Load and play background music
   std::cerr << "[INIT] Loading background music..." << std::endl;
@@ -341,6 +428,13 @@ void Application::handleEvents() {
           cinematicCamera->cycleMode();
           updateWindowTitle();
           break;
+
+        case SDLK_p:
+          // Automatic render size for the target frame time (not while recording)
+          if (!isRecording) {
+            toggleDynamicResolution();
+          }
+          break;
         
         case SDLK_PLUS:
         case SDLK_EQUALS:
@@ -435,9 +529,25 @@ void Application::render(double elapsedTime) {
   
   // Debug logging removed for performance
   
-  // Render with current color mode
+  // Render with current color mode (timed for the dynamic resolution controller)
+  auto traceStart = std::chrono::high_resolution_clock::now();
   metal_rt_renderer_render(gpuRenderer, &gpuCam, renderTime, colorMode, colorIntensity);
+  double traceMs =
+      std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - traceStart).count();
   const void *pixels = metal_rt_renderer_get_pixels(gpuRenderer);
+
+  // Below full resolution, upscale to the texture size with the edge-aware filter rather
+  // than letting SDL_RenderCopy stretch it bilinearly
+  if (pixels && (traceWidth != renderWidth || traceHeight != renderHeight)) {
+    upscaledPixels.resize(static_cast<size_t>(renderWidth) * renderHeight * 4);
+#ifdef BLACKHOLE_CPU_RENDERER
+    // Upscale on the tracer's threads: they are idle until the next frame
+    upscaler->setThreadPool(cpu_rt_renderer_get_thread_pool(gpuRenderer));
+#endif
+    upscaler->upscale(static_cast<const uint8_t *>(pixels), traceWidth, traceHeight, upscaledPixels.data(),
+                      renderWidth, renderHeight);
+    pixels = upscaledPixels.data();
+  }
   
   if (pixels && gpuTexture) {
     // Always update texture - force update even if pixels appear unchanged
@@ -509,7 +619,9 @@ void Application::render(double elapsedTime) {
   
   // Render HUD (hide hints if recording)
   bool showHints = hud->areHintsVisible() && !isRecording;
-  hud->renderHints(showHints, cinematicCamera->getMode(), currentFPS, windowWidth, windowHeight, resolutionManager, colorMode, colorIntensity, isMusicMuted);
+  int autoWidth = isDynamicResolution ? traceWidth : 0;
+  int autoHeight = isDynamicResolution ? traceHeight : 0;
+  hud->renderHints(showHints, cinematicCamera->getMode(), currentFPS, windowWidth, windowHeight, resolutionManager, colorMode, colorIntensity, isMusicMuted, autoWidth, autoHeight);
   
   // Render music credits (always visible when music is playing, even during recording)
   hud->renderMusicCredits(isMusicMuted, windowWidth, windowHeight);
@@ -520,15 +632,16 @@ void Application::render(double elapsedTime) {
     int outputW, outputH;
     SDL_GetRendererOutputSize(sdlRenderer, &outputW, &outputH);
     
-    // Allocate buffer for pixel data
-    std::vector<uint8_t> pixelBuffer(outputW * outputH * 4);
+    // Pooled buffer; the recorder hands it back once the frame is encoded
+    FramePool::Frame *frame = framePool->acquire(outputW, outputH);
     
     // Read pixels from renderer (includes HUD overlay)
     if (SDL_RenderReadPixels(sdlRenderer, nullptr, SDL_PIXELFORMAT_ARGB8888, 
-                             pixelBuffer.data(), outputW * 4) == 0) {
+                             frame->pixels.data(), outputW * 4) == 0) {
       // Pass the actual captured size to the video recorder
-      videoRecorder->addFrame(pixelBuffer.data(), outputW, outputH);
+      videoRecorder->addFrame(frame);
     } else {
+      framePool->release(frame);
       static int readErrorCount = 0;
       if (readErrorCount++ < 3) {
         std::cerr << "Warning: Failed to read pixels for recording: " << SDL_GetError() << std::endl;
@@ -545,6 +658,17 @@ void Application::render(double elapsedTime) {
   // Process events to keep window active and prevent macOS throttling
   SDL_PumpEvents();
   #endif
+
+  // Resize for the next frame if the trace time left the target band (size is fixed while recording)
+  if (isDynamicResolution && !isRecording && dynamicResolution->update(traceMs)) {
+    std::ostringstream logMsg;
+    logMsg << "[RESOLUTION] Dynamic: " << dynamicResolution->getWidth() << "x" << dynamicResolution->getHeight()
+           << " (" << std::fixed << std::setprecision(0) << dynamicResolution->getScale() * 100.0 << "% of "
+           << renderWidth << "x" << renderHeight << ", trace " << std::setprecision(1)
+           << dynamicResolution->getSmoothedMs() << " ms, target " << dynamicResolution->getTargetMs() << " ms)";
+    appLog(logMsg.str());
+    applyTraceSize(dynamicResolution->getWidth(), dynamicResolution->getHeight());
+  }
 }
 
 void Application::prepareCameraData(CameraData &data) {
@@ -644,8 +768,22 @@ void Application::recreateRenderTargets() {
   windowWidth = actualWidth;
   windowHeight = actualHeight;
   
-  // Resize Metal renderer to rendering resolution (not window size)
-  metal_rt_renderer_resize(gpuRenderer, renderWidth, renderHeight);
+  // Resize Metal renderer to rendering resolution (not window size), scaled down under
+  // dynamic resolution
+  dynamicResolution->setOutputSize(renderWidth, renderHeight);
+  if (isDynamicResolution) {
+    traceWidth = dynamicResolution->getWidth();
+    traceHeight = dynamicResolution->getHeight();
+  } else {
+    traceWidth = renderWidth;
+    traceHeight = renderHeight;
+  }
+  metal_rt_renderer_resize(gpuRenderer, traceWidth, traceHeight);
+
+  // Capture buffers follow the renderer output size (the only place they are reallocated)
+  int outputWidth, outputHeight;
+  SDL_GetRendererOutputSize(sdlRenderer, &outputWidth, &outputHeight);
+  framePool->resize(outputWidth, outputHeight);
   
   // Recreate SDL texture with rendering resolution
   if (gpuTexture) {
@@ -717,6 +855,28 @@ void Application::changeResolution(bool increase) {
   recreateRenderTargets();
 }
 
+void Application::toggleDynamicResolution() {
+  isDynamicResolution = !isDynamicResolution;
+  dynamicResolution->reset();
+
+  std::ostringstream logMsg;
+  logMsg << "[RESOLUTION] Dynamic resolution " << (isDynamicResolution ? "on" : "off") << " (target "
+         << std::fixed << std::setprecision(1) << dynamicResolution->getTargetMs() << " ms per frame)";
+  appLog(logMsg.str());
+
+  // Both directions start from full resolution; the controller scales down from there
+  applyTraceSize(renderWidth, renderHeight);
+}
+
+void Application::applyTraceSize(int width, int height) {
+  if (width == traceWidth && height == traceHeight) {
+    return;
+  }
+  traceWidth = width;
+  traceHeight = height;
+  metal_rt_renderer_resize(gpuRenderer, traceWidth, traceHeight);
+}
+
 void Application::startRecording() {
   if (isRecording) {
     std::cerr << "Cannot start recording: already recording!" << std::endl;
@@ -773,7 +933,7 @@ void Application::startRecording() {
   
   // Use /tmp directory for temporary recording file (writable location)
   // The file will be moved to user's chosen location after recording stops
-  std::string filename = std::string("/tmp/") + filenameBase;
+  std::string filename = RECORDING_DIRECTORY + "/" + filenameBase;
   
   int fps = currentFPS > 0 ? currentFPS : 60;
   // Get actual renderer output size for recording (includes high DPI scaling)
@@ -805,6 +965,11 @@ void Application::startRecording() {
   
   if (videoRecorder->startRecording(filename, recordWidth, recordHeight, fps, audioFile)) {
     isRecording = true;
+    // Buffers for the frames normally in flight plus the one being captured. Segment
+    // encoders that fall behind take more from the pool, which keeps them for reuse.
+    framePool->reserve(videoRecorder->getFramesToReserve() + 1);
+    recordStartAllocations = framePool->allocations();
+    recordStartPageFaults = minorPageFaults();
     updateWindowTitle();
     logMsg.str("");
     logMsg << "[RECORDING] ✓ Recording started successfully at " << recordWidth << "×" << recordHeight;
@@ -839,7 +1004,21 @@ void Application::stopRecording() {
   std::ostringstream logMsg;
   logMsg << "[RECORDING] Recording stopped. Temp file: " << tempFilename;
   appLog(logMsg.str());
+
+  uint64_t frames = std::max<uint64_t>(videoRecorder->getStats().framesQueued, 1);
+  logMsg.str("");
+  logMsg << "[RECORDING] Frame pool: " << framePool->frameCount() << " buffers ("
+         << framePool->bytes() / (1024 * 1024) << " MB), " << framePool->allocations() - recordStartAllocations
+         << " allocations and " << std::fixed << std::setprecision(1)
+         << static_cast<double>(minorPageFaults() - recordStartPageFaults) / frames << " page faults per frame while recording";
+  appLog(logMsg.str());
   
+  saveRecording(tempFilename);
+}
+
+void Application::saveRecording(const std::string& tempFilename) {
+  std::ostringstream logMsg;
+
   // Extract just the filename (without directory path) for the save dialog
   std::string dialogFilename = tempFilename;
   size_t lastSlash = tempFilename.find_last_of("/");
@@ -852,7 +1031,7 @@ void Application::stopRecording() {
   
   if (!savePath.empty()) {
     // Move file to user-selected location
-    if (videoRecorder->moveFile(savePath)) {
+    if (VideoRecorder::moveFile(tempFilename, savePath)) {
       logMsg.str("");
       logMsg << "[RECORDING] Recording saved to: " << savePath;
       appLog(logMsg.str());
@@ -909,12 +1088,21 @@ void Application::takeScreenshot() {
   int screenshotColorMode = colorMode;
   std::cout << "[SCREENSHOT] Passing screenshotColorMode=" << screenshotColorMode << " to render_and_get_pixels" << std::endl;
   
+  // Screenshots are always taken at the full rendering resolution
+  bool scaledDown = traceWidth != renderWidth || traceHeight != renderHeight;
+  if (scaledDown) {
+    metal_rt_renderer_resize(gpuRenderer, renderWidth, renderHeight);
+  }
+
   // Use the atomic render-and-get function which reads directly from texture
   const void *gpuPixels = metal_rt_renderer_render_and_get_pixels(gpuRenderer, &gpuCam, renderTime, screenshotColorMode, colorIntensity);
   std::cout << "[SCREENSHOT] Got pixels back from render_and_get_pixels" << std::endl;
   std::cout << "========== SCREENSHOT END ==========" << std::endl;
   
   if (!gpuPixels) {
+    if (scaledDown) {
+      metal_rt_renderer_resize(gpuRenderer, traceWidth, traceHeight);
+    }
     appLog("[SCREENSHOT] render_and_get_pixels returned nullptr!", true);
     std::cerr << "Failed to get pixels from render_and_get_pixels" << std::endl;
     return;
@@ -935,9 +1123,12 @@ void Application::takeScreenshot() {
     std::cout << "[SCREENSHOT] Center pixel BGRA format: B=" << (int)centerPixel[0] << " G=" << (int)centerPixel[1] << " R=" << (int)centerPixel[2] << " A=" << (int)centerPixel[3] << std::endl;
   }
   
-  // Copy GPU pixels to buffer (GPU pixels are already in ARGB8888 format)
-  std::vector<uint8_t> pixelBuffer(screenshotWidth * screenshotHeight * 4);
-  std::memcpy(pixelBuffer.data(), gpuPixels, screenshotWidth * screenshotHeight * 4);
+  // Copy GPU pixels to a pooled buffer (GPU pixels are already in ARGB8888 format)
+  FramePool::Frame *frame = framePool->acquire(screenshotWidth, screenshotHeight);
+  std::memcpy(frame->pixels.data(), gpuPixels, static_cast<size_t>(screenshotWidth) * screenshotHeight * 4);
+  if (scaledDown) {
+    metal_rt_renderer_resize(gpuRenderer, traceWidth, traceHeight);
+  }
   
   // Generate default filename with timestamp
   std::time_t now = std::time(nullptr);
@@ -952,7 +1143,7 @@ void Application::takeScreenshot() {
   
   if (!savePath.empty()) {
     // Save PNG file
-    if (savePNG(pixelBuffer.data(), screenshotWidth, screenshotHeight, savePath)) {
+    if (savePNG(frame->pixels.data(), screenshotWidth, screenshotHeight, savePath)) {
       std::ostringstream logMsg;
       logMsg << "[SCREENSHOT] Screenshot saved to: " << savePath << " (" << screenshotWidth << "×" << screenshotHeight << ")";
       appLog(logMsg.str());
@@ -966,6 +1157,7 @@ void Application::takeScreenshot() {
   } else {
     appLog("[SCREENSHOT] User cancelled save dialog");
   }
+  framePool->release(frame);
 }
 
 void Application::cleanup() {
@@ -986,6 +1178,9 @@ void Application::cleanup() {
     SDL_DestroyWindow(window);
   
   delete videoRecorder;
+  delete framePool;
+  delete upscaler;
+  delete dynamicResolution;
   delete resolutionManager;
   delete hud;
   delete cinematicCamera;
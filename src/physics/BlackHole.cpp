@@ -1,9 +1,264 @@
 #include "../../include/physics/BlackHole.hpp"
+#include "../../include/physics/DiskTexture.hpp"
+#include "../../include/physics/EmissionTable.hpp"
+#include "../../include/physics/OrbitalPlane.hpp"
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <numbers>
+#include <utility>
 
-BlackHole::BlackHole(double mass) : mass(mass), rs(2.0 * mass) {}
+namespace
+{
+
+// 8-point Gauss-Legendre rule on [0, 1]
+constexpr double GL_NODES[8] = {0.019855071751231856, 0.10166676129318664, 0.2372337950418355,
+                                0.4082826787521751, 0.5917173212478249, 0.7627662049581645,
+                                0.8983332387068134, 0.9801449282487681};
+constexpr double GL_WEIGHTS[8] = {0.05061426814518813, 0.11119051722668724, 0.15685332293894363,
+                                  0.18134189168918100, 0.18134189168918100, 0.15685332293894363,
+                                  0.11119051722668724, 0.05061426814518813};
+
+// Radial "energy" of a photon orbit: (du/dtheta)^2 = f(u) = 1/b^2 - u^2 + rs*u^3
+double orbitPotential(double u, double invB2, double rs)
+{
+  return invB2 - u * u + rs * u * u * u;
+}
+
+// Turning point of the orbit below r = 3rs, or 0 if it has none there
+double turningPoint(double invB2, double rs)
+{
+  // f is concave and decreasing on [0, 1/(3rs)]: Newton from the right end converges monotonically
+  double u = 1.0 / (3.0 * rs);
+  if (orbitPotential(u, invB2, rs) >= 0.0)
+    return 0.0;
+  for (int i = 0; i < 30; i++)
+  {
+    double delta = orbitPotential(u, invB2, rs) / (-2.0 * u + 3.0 * rs * u * u);
+    u -= delta;
+    if (std::abs(delta) < 1e-14 * u)
+      break;
+  }
+  return u;
+}
+
+// Exact swept angle between uLow < uHigh on one monotonic branch of the orbit. Substituting u = uTurn - (uTurn - uLow) * t^2 around the
+// nearest turning point removes the 1/sqrt(f) endpoint singularity, so a fixed
+// 8-point rule stays accurate to ~1e-9 rad even for rays grazing uHigh.
+double sweptAngle(double invB2, double rs, double uLow, double uHigh)
+{
+  double uTurn = turningPoint(invB2, rs);
+  double t0 = 0.0;
+  if (uTurn > uHigh)
+    t0 = std::sqrt((uTurn - uHigh) / (uTurn - uLow));
+  else
+    uTurn = uHigh;
+
+  double span = uTurn - uLow;
+  double angle = 0.0;
+  for (int i = 0; i < 8; i++)
+  {
+    double t = t0 + (1.0 - t0) * GL_NODES[i];
+    double u = uTurn - span * t * t;
+    double f = std::max(orbitPotential(u, invB2, rs), 1e-300);
+    angle += 2.0 * span * t * (1.0 - t0) * GL_WEIGHTS[i] / std::sqrt(f);
+  }
+  return angle;
+}
+
+// Rays with |(b_crit / b)^2 - 1| below this (|b / b_crit - 1| < ~2%) wind around the photon sphere
+constexpr double NEAR_CRITICAL_BAND = 0.04;
+
+// Step multiplier for near-critical rays (RK45 scales its tolerance by the 5th power instead)
+constexpr double NEAR_CRITICAL_STEP_SCALE = 0.5;
+
+// With slab stepping the step only has to follow the bend, not sample the disk
+constexpr double SLAB_FREE_STEP_SCALE = 4.0;
+constexpr double SLAB_MAX_STEP = 2.0;
+
+// Widest horizontal stretch of slab folded into one DiskHit: the pattern is evaluated at its
+// centre, while the vertical falloff is summed exactly, so steep crossings need only one
+constexpr double HIT_GROUP_SPAN = 0.3;
+
+// Hit lists are collected (and paths followed past opacity) only when the caller keeps them
+bool keepsHits(const HitRecord *record)
+{
+  return record && record->keepHits;
+}
+
+// Disk palette per colorMode; unknown modes get the last (white) one
+struct DiskPalette
+{
+  Vector3 hot, mid, cold; // Inner, mid and outer disk
+  Vector3 bright, dim;    // Doppler shift targets for approaching / receding gas
+};
+
+constexpr int PALETTE_COUNT = 4;
+constexpr DiskPalette DISK_PALETTES[PALETTE_COUNT] = {
+    // Blue mode - Interstellar style with extra blue in inner region
+    {Vector3(0.7, 0.85, 1.0), Vector3(0.75, 0.85, 1.0), Vector3(0.5, 0.6, 0.8), Vector3(0.85, 0.92, 1.0),
+     Vector3(0.5, 0.6, 0.8)},
+    // Orange mode - Warm glowing plasma
+    {Vector3(1.0, 0.9, 0.7), Vector3(1.0, 0.75, 0.5), Vector3(0.9, 0.6, 0.4), Vector3(1.0, 0.95, 0.85),
+     Vector3(0.8, 0.5, 0.3)},
+    // Red mode - Hot red plasma
+    {Vector3(1.0, 0.85, 0.75), Vector3(1.0, 0.6, 0.5), Vector3(0.85, 0.4, 0.3), Vector3(1.0, 0.9, 0.85),
+     Vector3(0.7, 0.3, 0.2)},
+    // White mode - Pure white/grayscale
+    {Vector3(1.0, 1.0, 1.0), Vector3(0.9, 0.9, 0.9), Vector3(0.7, 0.7, 0.7), Vector3(1.0, 1.0, 1.0),
+     Vector3(0.6, 0.6, 0.6)},
+};
+
+constexpr int paletteIndex(int colorMode)
+{
+  return colorMode >= 0 && colorMode < PALETTE_COUNT ? colorMode : PALETTE_COUNT - 1;
+}
+
+// A trace kernel knob left to run time (the generic kernel)
+constexpr int DYNAMIC = -1;
+
+// What a trace kernel is compiled for: palette, Doppler on/off and slab stepping on/off. A
+// fixed knob is a constant the compiler folds out of the step loop; a DYNAMIC one returns
+// the runtime value on every use.
+template <int ColorMode, int Doppler, int SlabStepping>
+struct KernelKnobs
+{
+  static constexpr int colorMode(int value) { return ColorMode == DYNAMIC ? value : ColorMode; }
+  static constexpr bool doppler(bool value) { return Doppler == DYNAMIC ? value : Doppler != 0; }
+  static constexpr bool slabStepping(bool value) { return SlabStepping == DYNAMIC ? value : SlabStepping != 0; }
+};
+
+using GenericKnobs = KernelKnobs<DYNAMIC, DYNAMIC, DYNAMIC>;
+
+} // namespace
+
+BlackHole::BlackHole(double mass)
+    : mass(mass), rs(2.0 * mass), integrator(Integrator::RK4), tolerance(1e-6), boundingSphere(false),
+      classifyRays(false), slabStepping(false), diskTexture(nullptr), emissionTable(nullptr),
+      specializedKernels(true) {}
+
+RayClass BlackHole::classifyRay(const Ray &ray) const
+{
+  OrbitalPlane plane(ray.origin, ray.direction);
+
+  // Inside the photon sphere even outgoing rays can turn back: always integrate carefully
+  if (plane.r0 <= 1.5 * rs)
+    return RayClass::NearCritical;
+
+  // Outward from outside the photon sphere f(u) only grows as u falls: no turning point
+  if (plane.cosPsi >= 0.0)
+    return RayClass::Escaping;
+  if (plane.sinPsi < 1e-9)
+    return RayClass::Captured;
+
+  double bCritical = 1.5 * std::sqrt(3.0) * rs;
+  double ratio = plane.inverseImpactSquared(rs) * bCritical * bCritical; // (b_crit / b)^2
+  if (std::abs(ratio - 1.0) < NEAR_CRITICAL_BAND)
+    return RayClass::NearCritical;
+  return ratio > 1.0 ? RayClass::Captured : RayClass::Escaping;
+}
+
+bool BlackHole::traceCaptured(const Ray &ray, TraceStats *stats) const
+{
+  constexpr double pi = std::numbers::pi;
+  constexpr double halfThickness = 0.2; // Must match the slab test in diskDensity
+  constexpr double margin = 0.5;        // Room for the integrated path's error, as in boundingRadius()
+
+  OrbitalPlane plane(ray.origin, ray.direction);
+  double planeTilt = std::hypot(plane.e1.y, plane.e2.y);
+  if (plane.sinPsi < 1e-9 || std::abs(ray.origin.y) <= halfThickness)
+    return false;
+
+  // Height on the orbit is y = r * tilt * sin(theta - theta_k) around any crossing theta_k,
+  // so within the annulus (r >= inner) the slab, padded by the margin, can only be reached
+  // within `window` of one
+  double inner = std::max(rs * 2.5 - margin, rs);
+  double outer = rs * 12.0 + margin;
+  double reach = (halfThickness + margin) / (inner * planeTilt);
+  if (reach >= 1.0)
+    return false; // Orbit plane close to the disk plane: it may run along the slab
+  double window = std::asin(reach);
+
+  // No turning point below b_crit: r falls monotonically to the horizon, so the annulus is
+  // one theta interval of the exact orbit integral
+  double u0 = 1.0 / plane.r0;
+  double invB2 = plane.inverseImpactSquared(rs);
+  if (u0 >= 1.0 / inner)
+  {
+    if (stats)
+      stats->capturedRays++;
+    return true; // Already inside the disk's inner edge
+  }
+  double annulusStart = u0 >= 1.0 / outer ? 0.0 : sweptAngle(invB2, rs, u0, 1.0 / outer);
+  double annulusEnd = sweptAngle(invB2, rs, u0, 1.0 / inner);
+
+  // The orbit meets y = 0 every pi; the crossing before the start counts too
+  double theta = std::atan2(-plane.e1.y, plane.e2.y);
+  if (theta < 0.0)
+    theta += pi;
+  for (theta -= pi; theta - window <= annulusEnd; theta += pi)
+  {
+    if (theta + window >= annulusStart)
+      return false; // May pass through the emitting slab: integrate it
+  }
+
+  if (stats)
+  {
+    stats->steps += 3;
+    stats->capturedRays++;
+  }
+  return true; // Nothing in front of the horizon emits, nothing behind it is seen
+}
+
+double BlackHole::boundingRadius() const
+{
+  return rs * 12.0 + 0.5; // Just outside the disk, where diskDensity is zero
+}
+
+Vector3 BlackHole::escapeDirection(const Vector3 &pos, const Vector3 &dir) const
+{
+  OrbitalPlane plane(pos, dir);
+  if (plane.sinPsi < 1e-9)
+    return dir; // Radial: no bending
+
+  // Remaining sweep from here to u = 0 in closed form; the asymptote is radial
+  return plane.radial(sweptAngle(plane.inverseImpactSquared(rs), rs, 0.0, 1.0 / plane.r0));
+}
+
+bool BlackHole::enterBoundingSphere(Ray &ray, Vector3 &escapeDir) const
+{
+  OrbitalPlane plane(ray.origin, ray.direction);
+  if (plane.cosPsi >= 0.0)
+  {
+    escapeDir = escapeDirection(ray.origin, ray.direction); // Heading away
+    return false;
+  }
+
+  double radius = boundingRadius();
+  if (plane.sinPsi < 1e-9)
+  {
+    ray.origin = plane.e1 * radius; // Radial: straight in
+    return true;
+  }
+
+  double u0 = 1.0 / plane.r0;
+  double uSphere = 1.0 / radius;
+  double invB2 = plane.inverseImpactSquared(rs);
+
+  double fSphere = orbitPotential(uSphere, invB2, rs);
+  if (fSphere > 0.0)
+  {
+    double angle = sweptAngle(invB2, rs, u0, uSphere);
+    ray = Ray(plane.position(angle, uSphere), plane.tangent(angle, uSphere, std::sqrt(fSphere)));
+    return true;
+  }
+
+  // Periapsis outside the sphere: in to the turning point, then out to infinity
+  double uTurn = turningPoint(invB2, rs);
+  double sweep = sweptAngle(invB2, rs, u0, uTurn) + sweptAngle(invB2, rs, 0.0, uTurn);
+  escapeDir = plane.radial(sweep);
+  return false;
+}
 
 Vector3 BlackHole::acceleration(const Vector3 &pos, const Vector3 &vel) const
 {
@@ -16,7 +271,28 @@ Vector3 BlackHole::acceleration(const Vector3 &pos, const Vector3 &vel) const
 }
 
 // Simple procedural noise for disk
-double BlackHole::diskDensity(const Vector3 &pos) const
+double BlackHole::diskDensity(const Vector3 &pos, double time, double footprint) const
+{
+  if (diskTexture)
+    return diskTexture->density(pos, time, footprint);
+  double envelope = diskEnvelope(pos);
+  if (envelope <= 0.0)
+    return 0.0;
+  return diskPattern(pos.length(), std::atan2(pos.z, pos.x), time) * envelope;
+}
+
+// Noise-like pattern based on angle and radius, rotated over time
+double BlackHole::diskPattern(double r, double angle, double time) const
+{
+  double rotationSpeed = 1.0; // Must match disk_density in RayTracing.metal
+  double rotatedAngle = angle + time * rotationSpeed;
+  double spiral = std::sin(rotatedAngle * 3.0 + r * 0.5);
+  double rings = std::sin(r * 2.0);
+
+  return (spiral + rings) * 0.5 + 0.5;
+}
+
+double BlackHole::diskEnvelope(const Vector3 &pos) const
 {
   double r = pos.length();
 
@@ -26,13 +302,6 @@ double BlackHole::diskDensity(const Vector3 &pos) const
   if (std::abs(pos.y) > 0.2)
     return 0.0; // Thin disk
 
-  // Noise-like pattern based on angle and radius
-  double angle = std::atan2(pos.z, pos.x);
-  double spiral = std::sin(angle * 3.0 + r * 0.5);
-  double rings = std::sin(r * 2.0);
-
-  double noise = (spiral + rings) * 0.5 + 0.5;
-
   // Fade edges
   double fade = 1.0;
   if (r < rs * 3.0)
@@ -40,7 +309,7 @@ double BlackHole::diskDensity(const Vector3 &pos) const
   if (r > rs * 10.0)
     fade = (rs * 12.0 - r) / (rs * 2.0);
 
-  return noise * fade * std::exp(-std::abs(pos.y) * 10.0);
+  return fade * std::exp(-std::abs(pos.y) * 10.0);
 }
 
 // Calculate Doppler beaming factor
@@ -72,58 +341,37 @@ double BlackHole::dopplerFactor(const Vector3 &pos, const Vector3 &rayDir) const
   return delta;
 }
 
-Vector3 BlackHole::diskColor(double density, double r, const Vector3 &pos, const Vector3 &rayDir, int colorMode) const
+template <class Knobs>
+Vector3 BlackHole::diskColor(double density, double r, const Vector3 &pos, const Vector3 &rayDir,
+                             const ShadingParams &shading) const
 {
+  // Without Doppler the gas is seen at rest: delta = 1 neither shifts nor boosts the palette
+  double delta = Knobs::doppler(shading.doppler) ? dopplerFactor(pos, rayDir) : 1.0;
+  return diskEmission(r, delta, Knobs::colorMode(shading.colorMode)) * density * shading.colorIntensity;
+}
+
+Vector3 BlackHole::diskEmission(double r, double delta, int colorMode) const
+{
+  if (emissionTable && emissionTable->covers(delta))
+    return emissionTable->emission(r, delta, colorMode);
+
   double t = (r - rs * 2.5) / (rs * 9.5);
   t = std::min(std::max(t, 0.0), 1.0);
 
-  // Define color palettes for different modes
-  Vector3 hot, mid, cold;
-  Vector3 doppler_bright, doppler_dim;
-
-  if (colorMode == 0)
-  {
-    // Blue mode - Interstellar style with extra blue in inner region
-    hot = Vector3(0.7, 0.85, 1.0);  // Inner: More blue
-    mid = Vector3(0.75, 0.85, 1.0); // Mid: Blue-white
-    cold = Vector3(0.5, 0.6, 0.8);  // Outer: Cooler blue
-    doppler_bright = Vector3(0.85, 0.92, 1.0);
-    doppler_dim = Vector3(0.5, 0.6, 0.8);
-  }
-  else if (colorMode == 1)
-  {
-    // Orange mode - Warm glowing plasma
-    hot = Vector3(1.0, 0.9, 0.7);  // Inner: Bright orange-white
-    mid = Vector3(1.0, 0.75, 0.5); // Mid: Orange
-    cold = Vector3(0.9, 0.6, 0.4); // Outer: Dim orange
-    doppler_bright = Vector3(1.0, 0.95, 0.85);
-    doppler_dim = Vector3(0.8, 0.5, 0.3);
-  }
-  else
-  {
-    // Red mode - Hot red plasma
-    hot = Vector3(1.0, 0.85, 0.75); // Inner: Bright red-white
-    mid = Vector3(1.0, 0.6, 0.5);   // Mid: Red-orange
-    cold = Vector3(0.85, 0.4, 0.3); // Outer: Deep red
-    doppler_bright = Vector3(1.0, 0.9, 0.85);
-    doppler_dim = Vector3(0.7, 0.3, 0.2);
-  }
+  const DiskPalette &palette = DISK_PALETTES[paletteIndex(colorMode)];
 
   // Blend between hot, mid, and cold
   Vector3 baseColor;
   if (t < 0.5)
   {
-    baseColor = hot * (1.0 - t * 2.0) + mid * (t * 2.0);
+    baseColor = palette.hot * (1.0 - t * 2.0) + palette.mid * (t * 2.0);
   }
   else
   {
-    baseColor = mid * (1.0 - (t - 0.5) * 2.0) + cold * ((t - 0.5) * 2.0);
+    baseColor = palette.mid * (1.0 - (t - 0.5) * 2.0) + palette.cold * ((t - 0.5) * 2.0);
   }
 
-  // Apply Doppler beaming
-  double delta = dopplerFactor(pos, rayDir);
-
-  // Intensity boost: I_observed = I_emitted * δ^3 (for emission)
+  // Doppler beaming intensity boost: I_observed = I_emitted * δ^3 (for emission)
   double intensity_boost = std::pow(delta, 3.0);
 
   // Frequency shift affects color
@@ -132,23 +380,31 @@ Vector3 BlackHole::diskColor(double density, double r, const Vector3 &pos, const
   {
     // Approaching: shift toward brighter color
     double shift = std::min((delta - 1.0) * 2.0, 0.4);
-    doppler_color = baseColor * (1.0 - shift) + doppler_bright * shift;
+    doppler_color = baseColor * (1.0 - shift) + palette.bright * shift;
   }
   else
   {
     // Receding: shift toward dimmer color
     double shift = std::min((1.0 - delta) * 2.0, 0.3);
-    doppler_color = baseColor * (1.0 - shift) + doppler_dim * shift;
+    doppler_color = baseColor * (1.0 - shift) + palette.dim * shift;
   }
 
-  return doppler_color * density * 4.0 * intensity_boost;
+  return doppler_color * 4.0 * intensity_boost;
 }
 
-Vector3 BlackHole::sampleBackground(const Vector3 &dir) const
+Vector3 BlackHole::sampleBackground(const Vector3 &dir, double time) const
 {
   constexpr double pi = 3.14159265358979323846;
-  double u = 0.5 + std::atan2(dir.z, dir.x) / (2 * pi);
-  double v = 0.5 - std::asin(dir.y) / pi;
+
+  // Rotate background around Y axis over time (slow starfield drift)
+  double rotationAngle = time * 0.1;
+  double cosRot = std::cos(rotationAngle);
+  double sinRot = std::sin(rotationAngle);
+  Vector3 rotatedDir(dir.x * cosRot - dir.z * sinRot, dir.y,
+                     dir.x * sinRot + dir.z * cosRot);
+
+  double u = 0.5 + std::atan2(rotatedDir.z, rotatedDir.x) / (2 * pi);
+  double v = 0.5 - std::asin(std::clamp(rotatedDir.y, -1.0, 1.0)) / pi;
 
   Vector3 color(0, 0, 0); // Pure black background
 
@@ -163,36 +419,350 @@ Vector3 BlackHole::sampleBackground(const Vector3 &dir) const
   return color;
 }
 
+template <class Knobs>
+Vector3 BlackHole::integrateDiskSamples(const Vector3 &start, const Vector3 &dir, double length, int samples,
+                                        const ShadingParams &shading, double stepSize,
+                                        double &transmittance, HitRecord *record) const
+{
+  double ds = length / samples;
+  double span = ds * std::hypot(dir.x, dir.z);
+  int group = span > 0.0 ? static_cast<int>(std::clamp(HIT_GROUP_SPAN / span, 1.0, 64.0)) : samples;
+  double groupDepth = 0.0;
+  double groupEmission = 0.0;
+
+  Vector3 color(0, 0, 0);
+  for (int i = 0; i < samples && (transmittance > 0.01 || keepsHits(record)); i++)
+  {
+    Vector3 pos = start + dir * ((i + 0.5) * ds);
+    if (keepsHits(record))
+    {
+      // Same per-sample weights as below, summed over stretches of up to `group` samples
+      double envelope = diskEnvelope(pos);
+      double w = 0.5 * stepSize * (ds / std::clamp(stepSize * (pos.length() / (rs * 2 + 0.1)), 0.02, 0.5));
+      groupDepth += envelope * w;
+      groupEmission += envelope * envelope * w;
+      if ((i + 1) % group == 0 || i + 1 == samples)
+      {
+        if (groupDepth > 0.0)
+        {
+          int first = i - i % group;
+          Vector3 center = start + dir * (0.5 * (first + i + 1) * ds);
+          appendDiskHit(record, center.length(), std::atan2(center.z, center.x), dopplerFactor(center, dir),
+                        groupDepth, groupEmission);
+        }
+        groupDepth = 0.0;
+        groupEmission = 0.0;
+      }
+    }
+
+    double density = diskDensity(pos, shading.time, ds);
+    if (density <= 0.001)
+      continue;
+
+    // trace() takes one sample per adaptive step: ds / dt samples fall in this sub-segment
+    double r = pos.length();
+    double dt = std::clamp(stepSize * (r / (rs * 2 + 0.1)), 0.02, 0.5);
+    double stepTransmittance = std::exp(-density * 0.5 * stepSize * (ds / dt));
+
+    Vector3 emission = diskColor<Knobs>(density, r, pos, dir, shading);
+    color += emission * transmittance * (1.0 - stepTransmittance);
+    transmittance *= stepTransmittance;
+  }
+  return color;
+}
+
+Vector3 BlackHole::integrateDiskCrossing(const Vector3 &center, const Vector3 &dir,
+                                         const ShadingParams &shading, double stepSize,
+                                         double &transmittance, HitRecord *record) const
+{
+  constexpr double halfThickness = 0.2; // Must match the slab test in diskDensity
+
+  double length = 2.0 * halfThickness / std::max(std::abs(dir.y), 1e-6);
+  int samples = std::clamp(static_cast<int>(std::ceil(length / 0.2)), 8, 64);
+  return integrateDiskSamples<GenericKnobs>(center - dir * (0.5 * length), dir, length, samples, shading,
+                                           stepSize, transmittance, record);
+}
+
+Vector3 BlackHole::integrateDiskSegment(const Vector3 &from, const Vector3 &to, const ShadingParams &shading,
+                                        double stepSize, double &transmittance, HitRecord *record) const
+{
+  return integrateDiskSegment<GenericKnobs>(from, to, shading, stepSize, transmittance, record);
+}
+
+template <class Knobs>
+Vector3 BlackHole::integrateDiskSegment(const Vector3 &from, const Vector3 &to, const ShadingParams &shading,
+                                        double stepSize, double &transmittance, HitRecord *record) const
+{
+  constexpr double halfThickness = 0.2; // Must match the slab test in diskDensity
+
+  // Clip the segment parameter to |y| <= halfThickness
+  Vector3 delta = to - from;
+  double t0 = 0.0;
+  double t1 = 1.0;
+  if (std::abs(delta.y) < 1e-12)
+  {
+    if (std::abs(from.y) > halfThickness)
+      return Vector3(0, 0, 0);
+  }
+  else
+  {
+    double ta = (-halfThickness - from.y) / delta.y;
+    double tb = (halfThickness - from.y) / delta.y;
+    t0 = std::max(t0, std::min(ta, tb));
+    t1 = std::min(t1, std::max(ta, tb));
+    if (t0 >= t1)
+      return Vector3(0, 0, 0);
+  }
+
+  // ... and skip it when it stays inside or outside the annulus
+  Vector3 start = from + delta * t0;
+  Vector3 end = from + delta * t1;
+  double inner2 = rs * rs * 6.25;
+  double outer = rs * 12.0;
+  if (start.lengthSquared() < inner2 && end.lengthSquared() < inner2)
+    return Vector3(0, 0, 0);
+  double segmentLength2 = (end - start).lengthSquared();
+  double closest = segmentLength2 > 0.0 ? std::clamp(-start.dot(end - start) / segmentLength2, 0.0, 1.0) : 0.0;
+  if ((start + (end - start) * closest).lengthSquared() > outer * outer)
+    return Vector3(0, 0, 0);
+
+  // Fixed spatial sampling, independent of the step that produced the segment; the
+  // exp(-10|y|) profile sets the resolution across the slab
+  double length = std::sqrt(segmentLength2);
+  if (length < 1e-9)
+    return Vector3(0, 0, 0);
+  double across = std::abs(end.y - start.y) / 0.05;
+  int samples = std::clamp(static_cast<int>(std::ceil(std::max(length / 0.2, across))), 1, 64);
+  return integrateDiskSamples<Knobs>(start, (end - start) / length, length, samples, shading, stepSize,
+                                     transmittance, record);
+}
+
+void BlackHole::recordDiskSample(HitRecord *record, const Vector3 &pos, const Vector3 &dir, double w) const
+{
+  double envelope = diskEnvelope(pos);
+  if (envelope <= 0.0)
+    return;
+  appendDiskHit(record, pos.length(), std::atan2(pos.z, pos.x), dopplerFactor(pos, dir), envelope * w,
+                envelope * envelope * w);
+}
+
+void BlackHole::appendDiskHit(HitRecord *record, double r, double phi, double doppler, double depth,
+                              double emissionDepth) const
+{
+  // Steps split one crossing into several segments: fold a stretch into the previous hit
+  // when both fit in one group (depth-weighted centre)
+  if (!record->hits.empty())
+  {
+    DiskHit &last = record->hits.back();
+    double dPhi = std::remainder(phi - last.phi, 2.0 * std::numbers::pi);
+    double dr = r - last.r;
+    double gap2 = dr * dr + r * r * dPhi * dPhi;
+    if (gap2 < 0.25 * HIT_GROUP_SPAN * HIT_GROUP_SPAN)
+    {
+      double weight = depth / (depth + last.depth);
+      last.r = static_cast<float>(last.r + dr * weight);
+      last.phi = static_cast<float>(last.phi + dPhi * weight);
+      last.doppler = static_cast<float>(last.doppler + (doppler - last.doppler) * weight);
+      last.depth = static_cast<float>(last.depth + depth);
+      last.emissionDepth = static_cast<float>(last.emissionDepth + emissionDepth);
+      return;
+    }
+  }
+  record->hits.push_back({static_cast<float>(r), static_cast<float>(phi), static_cast<float>(doppler),
+                          static_cast<float>(depth), static_cast<float>(emissionDepth)});
+}
+
+Vector3 BlackHole::shadeHits(const DiskHit *hits, size_t count, const Vector3 *escapeDir,
+                             const ShadingParams &shading) const
+{
+  Vector3 color(0, 0, 0);
+  double transmittance = 1.0;
+  for (size_t i = 0; i < count && transmittance > 0.01; i++)
+  {
+    const DiskHit &hit = hits[i];
+    double pattern = diskTexture ? diskTexture->pattern(hit.r, hit.phi, shading.time)
+                                 : diskPattern(hit.r, hit.phi, shading.time);
+    double depth = pattern * hit.depth;
+    if (depth <= 0.0)
+      continue;
+
+    // Each sample emits density * (1 - e^(-density * w)): the stretch's mean density is
+    // pattern * emissionDepth / depth, applied over its total optical depth
+    double density = pattern * hit.emissionDepth / hit.depth;
+    double stepTransmittance = std::exp(-depth);
+    color += diskEmission(hit.r, shading.doppler ? hit.doppler : 1.0, shading.colorMode) *
+             (density * shading.colorIntensity * transmittance * (1.0 - stepTransmittance));
+    transmittance *= stepTransmittance;
+  }
+
+  if (escapeDir)
+    color += sampleBackground(*escapeDir, shading.time) * transmittance;
+  return color;
+}
+
 Vector3 BlackHole::trace(const Ray &ray, double stepSize,
                          double maxDist) const
 {
+  return trace(ray, ShadingParams{}, stepSize, maxDist);
+}
+
+bool BlackHole::prepareTrace(Ray &ray, const ShadingParams &shading, Vector3 &color,
+                             double &stepScale, TraceStats *stats, HitRecord *record) const
+{
+  if (record)
+  {
+    record->escaped = false;
+    record->transmittance = 1.0;
+  }
+
+  // Outside the bounding sphere there is no disk: jump straight to it (or past it).
+  // maxDist then only limits the integrated path inside the sphere.
+  if (boundingSphere && ray.origin.lengthSquared() > boundingRadius() * boundingRadius())
+  {
+    Vector3 escapeDir;
+    if (!enterBoundingSphere(ray, escapeDir))
+    {
+      if (record)
+      {
+        record->escaped = true;
+        record->escapeDir = escapeDir;
+      }
+      color = sampleBackground(escapeDir, shading.time);
+      return true;
+    }
+  }
+
+  // Captured rays that never come near the disk are black; near-critical ones get finer steps
+  stepScale = 1.0;
+  if (classifyRays)
+  {
+    RayClass rayClass = classifyRay(ray);
+    if (rayClass == RayClass::Captured)
+    {
+      if (traceCaptured(ray, stats))
+      {
+        color = Vector3(0, 0, 0);
+        return true;
+      }
+    }
+    else if (rayClass == RayClass::NearCritical)
+    {
+      stepScale = NEAR_CRITICAL_STEP_SCALE;
+      if (stats)
+        stats->nearCriticalRays++;
+    }
+  }
+  return false;
+}
+
+Vector3 BlackHole::trace(const Ray &ray, const ShadingParams &shading,
+                         double stepSize, double maxDist, TraceStats *stats, HitRecord *record) const
+{
+  Ray start = ray;
+  Vector3 color;
+  double stepScale;
+  if (prepareTrace(start, shading, color, stepScale, stats, record))
+    return color;
+
+  // Radial rays have no orbital plane (and no bending): leave them to RK4
+  Integrator kind = integrator;
+  if (kind == Integrator::Binet && start.origin.cross(start.direction).lengthSquared() <= 1e-12)
+    kind = Integrator::RK4;
+  return (this->*selectKernel(kind, shading))(start, shading, stepSize, maxDist, stepScale, stats, record);
+}
+
+// Every (integrator, palette, Doppler, slab stepping) instantiation, plus the generic kernels.
+// Index = ((integrator * PALETTE_COUNT + palette) * 2 + doppler) * 2 + slabStepping.
+struct BlackHole::Kernels
+{
+  static constexpr size_t COUNT = 3 * PALETTE_COUNT * 2 * 2;
+
+  template <size_t Index>
+  static constexpr TraceKernel at()
+  {
+    constexpr int colorMode = static_cast<int>(Index / 4 % PALETTE_COUNT);
+    constexpr int doppler = static_cast<int>(Index / 2 % 2);
+    constexpr int slabStepping = static_cast<int>(Index % 2);
+    constexpr size_t kind = Index / (4 * PALETTE_COUNT);
+    using Knobs = KernelKnobs<colorMode, doppler, slabStepping>;
+    if constexpr (kind == static_cast<size_t>(Integrator::Binet))
+      return &BlackHole::traceBinet<Knobs>;
+    else if constexpr (kind == static_cast<size_t>(Integrator::DormandPrince))
+      return &BlackHole::traceDormandPrince<Knobs>;
+    else
+      return &BlackHole::traceRK4<Knobs>;
+  }
+
+  template <size_t... Index>
+  static constexpr std::array<TraceKernel, sizeof...(Index)> build(std::index_sequence<Index...>)
+  {
+    return {at<Index>()...};
+  }
+
+  static constexpr TraceKernel GENERIC[3] = {&BlackHole::traceRK4<GenericKnobs>, &BlackHole::traceBinet<GenericKnobs>,
+                                             &BlackHole::traceDormandPrince<GenericKnobs>};
+};
+
+BlackHole::TraceKernel BlackHole::selectKernel(Integrator kind, const ShadingParams &shading) const
+{
+  size_t index = static_cast<size_t>(kind);
+  if (!specializedKernels)
+    return Kernels::GENERIC[index];
+  index = index * PALETTE_COUNT + paletteIndex(shading.colorMode);
+  index = index * 2 + (shading.doppler ? 1 : 0);
+  index = index * 2 + (slabStepping ? 1 : 0);
+  static constexpr std::array<TraceKernel, Kernels::COUNT> SPECIALIZED =
+      Kernels::build(std::make_index_sequence<Kernels::COUNT>());
+  return SPECIALIZED[index];
+}
+
+template <class Knobs>
+Vector3 BlackHole::traceRK4(const Ray &ray, const ShadingParams &shading,
+                            double stepSize, double maxDist, double stepScale, TraceStats *stats,
+                            HitRecord *record) const
+{
+  const bool slab = Knobs::slabStepping(slabStepping);
+  const double exitRadius2 = boundingRadius() * boundingRadius();
+
   Vector3 pos = ray.origin;
   Vector3 vel = ray.direction;
 
   Vector3 accumulatedColor(0, 0, 0);
   double transmittance = 1.0;
   double totalDist = 0;
+  unsigned long long steps = 0;
 
-  while (totalDist < maxDist && transmittance > 0.01)
+  while (totalDist < maxDist && (transmittance > 0.01 || keepsHits(record)))
   {
     double r2 = pos.lengthSquared();
 
     // Event Horizon
     if (r2 < rs * rs)
     {
+      if (stats)
+        stats->steps += steps;
       return accumulatedColor; // Black (absorbed)
     }
 
-    // Volumetric Accretion Disk Integration
-    double density = diskDensity(pos);
+    // Leaving the bounding sphere: the rest of the bend is closed-form
+    if (boundingSphere && r2 > exitRadius2 && pos.dot(vel) > 0.0)
+    {
+      vel = escapeDirection(pos, vel);
+      break;
+    }
+
+    // Volumetric Accretion Disk Integration (one point sample per step unless slab stepping)
+    double density = slab ? 0.0 : diskDensity(pos, shading.time);
+    if (keepsHits(record) && !slab)
+      recordDiskSample(record, pos, vel, 0.5 * stepSize * stepScale);
     if (density > 0.001)
     {
       double r = std::sqrt(r2);
-      Vector3 emission = diskColor(density, r, pos, vel, 0); // Default to blue mode
+      Vector3 emission = diskColor<Knobs>(density, r, pos, vel, shading);
       double absorption = density * 0.5;
 
       // Beer's Law integration for this step
-      double dt = stepSize; // Approximation
+      double dt = stepSize * stepScale; // Approximation
       double stepTransmittance = std::exp(-absorption * dt);
 
       accumulatedColor += emission * transmittance * (1.0 - stepTransmittance);
@@ -206,8 +776,25 @@ Vector3 BlackHole::trace(const Ray &ray, double stepSize,
       dt = 0.02; // Minimum step
     if (dt > 0.5)
       dt = 0.5; // Maximum step
+    if (slab)
+    {
+      // Emission is integrated per segment, so only the bend limits the step; stop at
+      // the slab face so the first in-slab segment starts there
+      dt = std::clamp(stepSize * (r / (rs * 2 + 0.1)) * SLAB_FREE_STEP_SCALE, 0.02, SLAB_MAX_STEP) * stepScale;
+      double aboveSlab = std::abs(pos.y) - 0.2;
+      if (aboveSlab > 0.0 && pos.y * vel.y < 0.0)
+      {
+        double entry = aboveSlab / std::abs(vel.y);
+        double entryR = (pos + vel * entry).length();
+        if (entry > 0.02 && entry < dt && entryR > rs * 2.5 - 1.0 && entryR < rs * 12.0 + 1.0)
+          dt = entry;
+      }
+    }
+    else
+    {
+      dt *= stepScale;
+    }
 
-    // RK4
     Vector3 k1_v = acceleration(pos, vel);
     Vector3 k1_p = vel;
     Vector3 k2_v =
@@ -224,6 +811,9 @@ Vector3 BlackHole::trace(const Ray &ray, double stepSize,
     Vector3 next_pos =
         pos + (k1_p + k2_p * 2.0 + k3_p * 2.0 + k4_p) * (dt / 6.0);
 
+    if (slab)
+      accumulatedColor += integrateDiskSegment<Knobs>(pos, next_pos, shading, stepSize, transmittance, record);
+
     pos = next_pos;
     vel = next_vel; // Don't normalize here to conserve angular momentum better?
                     // Actually for null geodesics |v| should be constant c.
@@ -232,10 +822,294 @@ Vector3 BlackHole::trace(const Ray &ray, double stepSize,
     vel = vel.normalized();
 
     totalDist += dt;
+    steps++;
   }
 
+  if (stats)
+    stats->steps += steps;
+
   // Add background if ray escapes
-  accumulatedColor += sampleBackground(vel) * transmittance;
+  if (record)
+  {
+    record->escaped = true;
+    record->escapeDir = vel;
+    record->transmittance = transmittance;
+  }
+  accumulatedColor += sampleBackground(vel, shading.time) * transmittance;
+
+  return accumulatedColor;
+}
+
+template <class Knobs>
+Vector3 BlackHole::traceBinet(const Ray &ray, const ShadingParams &shading,
+                              double stepSize, double maxDist, double stepScale, TraceStats *stats,
+                              HitRecord *record) const
+{
+  const bool slab = Knobs::slabStepping(slabStepping);
+  OrbitalPlane plane(ray.origin, ray.direction);
+
+  // Orbit state: u = 1/r and w = du/dtheta; the plane is fixed, so no cross
+  // products, r^5 terms or renormalization per step
+  double theta = 0.0;
+  double u = 1.0 / plane.r0;
+  double w = plane.initialSlope();
+  const double threeM = 1.5 * rs;
+  const double diskOuter = rs * 12.0 + 0.5;
+  const double exitU = 1.0 / boundingRadius();
+  bool escaped = false;
+
+  Vector3 accumulatedColor(0, 0, 0);
+  double transmittance = 1.0;
+  double totalDist = 0;
+  unsigned long long steps = 0;
+
+  while (totalDist < maxDist && (transmittance > 0.01 || keepsHits(record)) && u > 0.0)
+  {
+    // Event Horizon
+    if (u > 1.0 / rs)
+    {
+      if (stats)
+        stats->steps += steps;
+      return accumulatedColor; // Black (absorbed)
+    }
+
+    // Leaving the bounding sphere (moving outward): the rest of the bend is closed-form
+    if (boundingSphere && u < exitU && w < 0.0)
+    {
+      escaped = true;
+      break;
+    }
+
+    double r = 1.0 / u;
+
+    // Rebuild the 3D position only inside the disk slab
+    double height = plane.height(theta, u);
+    if (!slab && r >= rs * 2.5 && r <= rs * 12.0 && std::abs(height) <= 0.2)
+    {
+      Vector3 pos = plane.position(theta, u);
+      if (keepsHits(record))
+        recordDiskSample(record, pos, plane.tangent(theta, u, w), 0.5 * stepSize * stepScale);
+      double density = diskDensity(pos, shading.time);
+      if (density > 0.001)
+      {
+        Vector3 vel = plane.tangent(theta, u, w);
+        Vector3 emission = diskColor<Knobs>(density, r, pos, vel, shading);
+        double stepTransmittance = std::exp(-density * 0.5 * stepSize * stepScale);
+
+        accumulatedColor += emission * transmittance * (1.0 - stepTransmittance);
+        transmittance *= stepTransmittance;
+      }
+    }
+
+    // Same spatial step as RK4 where the disk can be sampled; beyond the disk
+    // radius the smooth orbit takes up to 0.05 rad at once without overshooting it
+    double dt = slab
+                    ? std::clamp(stepSize * (r / (rs * 2 + 0.1)) * SLAB_FREE_STEP_SCALE, 0.02, SLAB_MAX_STEP)
+                    : std::clamp(stepSize * (r / (rs * 2 + 0.1)), 0.02, 0.5);
+    dt *= stepScale;
+    double dsdTheta = std::sqrt(w * w + u * u) / (u * u);
+    double h = dt / dsdTheta;
+    if (r > diskOuter)
+      h = std::max(h, std::min(0.05 * stepScale, (r - diskOuter) / dsdTheta));
+
+    double prevTheta = theta;
+    double prevU = u;
+
+    // RK4 on (u, w)
+    double k1u = w;
+    double k1w = -u + threeM * u * u;
+    double u2 = u + k1u * (h * 0.5);
+    double k2u = w + k1w * (h * 0.5);
+    double k2w = -u2 + threeM * u2 * u2;
+    double u3 = u + k2u * (h * 0.5);
+    double k3u = w + k2w * (h * 0.5);
+    double k3w = -u3 + threeM * u3 * u3;
+    double u4 = u + k3u * h;
+    double k4u = w + k3w * h;
+    double k4w = -u4 + threeM * u4 * u4;
+
+    u += (k1u + k2u * 2.0 + k3u * 2.0 + k4u) * (h / 6.0);
+    w += (k1w + k2w * 2.0 + k3w * 2.0 + k4w) * (h / 6.0);
+    theta += h;
+
+    // Segment emission whenever this step can touch the slab
+    double nextHeight = plane.height(theta, u);
+    if (slab && u > 0.0 && (std::abs(height) <= 0.2 || std::abs(nextHeight) <= 0.2 || height * nextHeight < 0.0))
+    {
+      accumulatedColor += integrateDiskSegment<Knobs>(plane.position(prevTheta, prevU), plane.position(theta, u), shading,
+                                               stepSize, transmittance, record);
+    }
+
+    totalDist += h * dsdTheta;
+    steps++;
+  }
+
+  if (stats)
+    stats->steps += steps;
+
+  // Add background if ray escapes
+  Vector3 vel = plane.tangent(theta, std::max(u, 1e-9), w);
+  if (escaped)
+    vel = escapeDirection(plane.position(theta, u), vel);
+  if (record)
+  {
+    record->escaped = true;
+    record->escapeDir = vel;
+    record->transmittance = transmittance;
+  }
+  accumulatedColor += sampleBackground(vel, shading.time) * transmittance;
+
+  return accumulatedColor;
+}
+
+template <class Knobs>
+Vector3 BlackHole::traceDormandPrince(const Ray &ray, const ShadingParams &shading,
+                                      double stepSize, double maxDist, double stepScale,
+                                      TraceStats *stats, HitRecord *record) const
+{
+  // Dormand-Prince 5(4) tableau
+  constexpr double a21 = 1.0 / 5.0;
+  constexpr double a31 = 3.0 / 40.0, a32 = 9.0 / 40.0;
+  constexpr double a41 = 44.0 / 45.0, a42 = -56.0 / 15.0, a43 = 32.0 / 9.0;
+  constexpr double a51 = 19372.0 / 6561.0, a52 = -25360.0 / 2187.0, a53 = 64448.0 / 6561.0,
+                   a54 = -212.0 / 729.0;
+  constexpr double a61 = 9017.0 / 3168.0, a62 = -355.0 / 33.0, a63 = 46732.0 / 5247.0,
+                   a64 = 49.0 / 176.0, a65 = -5103.0 / 18656.0;
+  constexpr double b1 = 35.0 / 384.0, b3 = 500.0 / 1113.0, b4 = 125.0 / 192.0,
+                   b5 = -2187.0 / 6784.0, b6 = 11.0 / 84.0;
+  constexpr double e1 = 71.0 / 57600.0, e3 = -71.0 / 16695.0, e4 = 71.0 / 1920.0,
+                   e5 = -17253.0 / 339200.0, e6 = 22.0 / 525.0, e7 = -1.0 / 40.0;
+
+  // The heuristic clamps are now safety limits; the upper one is wider since
+  // the error estimate, not the heuristic, bounds the step
+  constexpr double minStep = 0.02;
+  constexpr double maxStep = 5.0;
+
+  // Local error goes as h^5: this tolerance gives roughly stepScale times the step
+  const double tol = tolerance * std::pow(stepScale, 5.0);
+  const bool slab = Knobs::slabStepping(slabStepping);
+
+  Vector3 pos = ray.origin;
+  Vector3 vel = ray.direction;
+
+  Vector3 accumulatedColor(0, 0, 0);
+  double transmittance = 1.0;
+  double totalDist = 0;
+  unsigned long long steps = 0;
+
+  const double exitRadius2 = boundingRadius() * boundingRadius();
+
+  // First stage is reused from the end of the previous step (FSAL)
+  Vector3 k1p = vel;
+  Vector3 k1v = acceleration(pos, vel);
+  double h = std::clamp(stepSize * (pos.length() / (rs * 2 + 0.1)), minStep, 0.5);
+
+  while (totalDist < maxDist && (transmittance > 0.01 || keepsHits(record)))
+  {
+    double r2 = pos.lengthSquared();
+
+    // Event Horizon
+    if (r2 < rs * rs)
+    {
+      if (stats)
+        stats->steps += steps;
+      return accumulatedColor; // Black (absorbed)
+    }
+
+    // Leaving the bounding sphere: the rest of the bend is closed-form
+    if (boundingSphere && r2 > exitRadius2 && pos.dot(vel) > 0.0)
+    {
+      vel = escapeDirection(pos, vel);
+      break;
+    }
+
+    // Point sampling: RK4's step is the disk sampling resolution, so keep it inside the
+    // disk volume and never jump further than the distance to that volume. Segment
+    // integration samples the slab itself and leaves the step to the error control.
+    double r = std::sqrt(r2);
+    double dtRef = std::clamp(stepSize * (r / (rs * 2 + 0.1)), 0.02, 0.5);
+    double distToDisk = std::max(std::abs(pos.y) - 0.2, std::max(rs * 2.5 - r, r - rs * 12.0));
+    double diskLimit = slab ? maxStep : std::max(dtRef, distToDisk);
+
+    Vector3 p7;
+    Vector3 v7;
+    Vector3 k7p;
+    Vector3 k7v;
+    double dt;
+    double err;
+    for (;;)
+    {
+      dt = std::clamp(std::min(h, diskLimit), minStep, maxStep);
+
+      Vector3 k2p = vel + k1v * (dt * a21);
+      Vector3 k2v = acceleration(pos + k1p * (dt * a21), k2p);
+      Vector3 k3p = vel + (k1v * a31 + k2v * a32) * dt;
+      Vector3 k3v = acceleration(pos + (k1p * a31 + k2p * a32) * dt, k3p);
+      Vector3 k4p = vel + (k1v * a41 + k2v * a42 + k3v * a43) * dt;
+      Vector3 k4v = acceleration(pos + (k1p * a41 + k2p * a42 + k3p * a43) * dt, k4p);
+      Vector3 k5p = vel + (k1v * a51 + k2v * a52 + k3v * a53 + k4v * a54) * dt;
+      Vector3 k5v = acceleration(pos + (k1p * a51 + k2p * a52 + k3p * a53 + k4p * a54) * dt, k5p);
+      Vector3 k6p = vel + (k1v * a61 + k2v * a62 + k3v * a63 + k4v * a64 + k5v * a65) * dt;
+      Vector3 k6v =
+          acceleration(pos + (k1p * a61 + k2p * a62 + k3p * a63 + k4p * a64 + k5p * a65) * dt, k6p);
+
+      p7 = pos + (k1p * b1 + k3p * b3 + k4p * b4 + k5p * b5 + k6p * b6) * dt;
+      v7 = vel + (k1v * b1 + k3v * b3 + k4v * b4 + k5v * b5 + k6v * b6) * dt;
+      k7p = v7;
+      k7v = acceleration(p7, v7);
+      steps++;
+
+      // Embedded 4th-order error, scaled per component
+      Vector3 errP = (k1p * e1 + k3p * e3 + k4p * e4 + k5p * e5 + k6p * e6 + k7p * e7) * dt;
+      Vector3 errV = (k1v * e1 + k3v * e3 + k4v * e4 + k5v * e5 + k6v * e6 + k7v * e7) * dt;
+      auto scaled = [&](double e, double a, double b) {
+        return std::abs(e) / (tol * (1.0 + std::max(std::abs(a), std::abs(b))));
+      };
+      err = std::max({scaled(errP.x, pos.x, p7.x), scaled(errP.y, pos.y, p7.y), scaled(errP.z, pos.z, p7.z),
+                      scaled(errV.x, vel.x, v7.x), scaled(errV.y, vel.y, v7.y), scaled(errV.z, vel.z, v7.z)});
+
+      if (err <= 1.0 || dt <= minStep)
+        break;
+      h = dt * std::max(0.2, 0.9 * std::pow(err, -0.2));
+    }
+
+    // Disk emission over the accepted step, weighted like dt / dtRef RK4 samples
+    if (slab)
+      accumulatedColor += integrateDiskSegment<Knobs>(pos, p7, shading, stepSize, transmittance, record);
+    double density = slab ? 0.0 : diskDensity(pos, shading.time);
+    if (keepsHits(record) && !slab)
+      recordDiskSample(record, pos, vel, 0.5 * stepSize * (dt / dtRef));
+    if (density > 0.001)
+    {
+      Vector3 emission = diskColor<Knobs>(density, r, pos, vel, shading);
+      double stepTransmittance = std::exp(-density * 0.5 * stepSize * (dt / dtRef));
+
+      accumulatedColor += emission * transmittance * (1.0 - stepTransmittance);
+      transmittance *= stepTransmittance;
+    }
+
+    // Renormalize like RK4; acceleration scales with |v|^2, so rescale the FSAL stage too
+    double speed2 = v7.lengthSquared();
+    pos = p7;
+    vel = v7 / std::sqrt(speed2);
+    k1p = vel;
+    k1v = k7v / speed2;
+
+    totalDist += dt;
+    h = dt * (err > 0.0 ? std::clamp(0.9 * std::pow(err, -0.2), 0.2, 5.0) : 5.0);
+  }
+
+  if (stats)
+    stats->steps += steps;
+
+  // Add background if ray escapes
+  if (record)
+  {
+    record->escaped = true;
+    record->escapeDir = vel;
+    record->transmittance = transmittance;
+  }
+  accumulatedColor += sampleBackground(vel, shading.time) * transmittance;
 
   return accumulatedColor;
 }
@@ -0,0 +1,164 @@
+#include "../../include/physics/DiskTexture.hpp"
+#include "../../include/physics/BlackHole.hpp"
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace {
+
+constexpr double TWO_PI = 2.0 * std::numbers::pi;
+constexpr double HALF_PI = 0.5 * std::numbers::pi;
+constexpr double ROTATION_SPEED = 1.0; // Must match rotationSpeed in BlackHole::diskPattern
+constexpr double HALF_THICKNESS = 0.2; // Must match the slab test in BlackHole::diskEnvelope
+constexpr int FALLOFF_SIZE = 256;      // Intervals of the exp(-10|y|) table
+constexpr int MIN_LEVEL_SIZE = 4;      // Coarsest mip keeps at least this many texels per axis
+constexpr int ERROR_PROBES = 64;       // Probes per axis when measuring the bake error
+
+// atan2(y, x), max error ~1e-5 rad (same polynomial as the packet kernel)
+inline double fastAtan2(double y, double x) {
+  double ax = std::abs(x);
+  double ay = std::abs(y);
+  double mx = std::max(ax, ay);
+  double mn = std::min(ax, ay);
+  double a = mx > 0.0 ? mn / mx : 0.0;
+  double s = a * a;
+  double r = ((-0.0464964749 * s + 0.15931422) * s - 0.327622764) * s * a + a;
+  r = ay > ax ? HALF_PI - r : r;
+  r = x < 0.0 ? std::numbers::pi - r : r;
+  return y < 0.0 ? -r : r;
+}
+
+} // namespace
+
+DiskTexture::DiskTexture(const BlackHole &blackHole, int radialSize, int angularSize)
+    : rs(blackHole.rs), innerR(blackHole.rs * 2.5), outerR(blackHole.rs * 12.0), error(0.0) {
+  // Finest level: texel centres at (i + 0.5) steps in radius and angle, so each coarser
+  // level's centres sit exactly between its children
+  Level base;
+  base.radial = std::max(radialSize, 2);
+  base.angular = std::max(angularSize, 2);
+  base.texelR = (outerR - innerR) / base.radial;
+  base.invTexelR = 1.0 / base.texelR;
+  base.invTexelAngle = base.angular / TWO_PI;
+  base.texels.resize(static_cast<size_t>(base.radial) * (base.angular + 1));
+  for (int i = 0; i < base.radial; i++) {
+    double r = innerR + (i + 0.5) * base.texelR;
+    float *row = &base.texels[static_cast<size_t>(i) * (base.angular + 1)];
+    for (int j = 0; j < base.angular; j++) {
+      row[j] = static_cast<float>(blackHole.diskPattern(r, (j + 0.5) / base.invTexelAngle, 0.0));
+    }
+    row[base.angular] = row[0];
+  }
+  levels.push_back(std::move(base));
+
+  // 2x2 box-filtered mips while both axes still halve evenly
+  while (levels.back().radial % 2 == 0 && levels.back().angular % 2 == 0 &&
+         levels.back().radial / 2 >= MIN_LEVEL_SIZE && levels.back().angular / 2 >= MIN_LEVEL_SIZE) {
+    const Level &fine = levels.back();
+    Level coarse;
+    coarse.radial = fine.radial / 2;
+    coarse.angular = fine.angular / 2;
+    coarse.texelR = fine.texelR * 2.0;
+    coarse.invTexelR = 1.0 / coarse.texelR;
+    coarse.invTexelAngle = fine.invTexelAngle * 0.5;
+    coarse.texels.resize(static_cast<size_t>(coarse.radial) * (coarse.angular + 1));
+    const size_t fineStride = fine.angular + 1;
+    for (int i = 0; i < coarse.radial; i++) {
+      const float *a = &fine.texels[static_cast<size_t>(2 * i) * fineStride];
+      const float *b = a + fineStride;
+      float *row = &coarse.texels[static_cast<size_t>(i) * (coarse.angular + 1)];
+      for (int j = 0; j < coarse.angular; j++) {
+        row[j] = 0.25f * (a[2 * j] + a[2 * j + 1] + b[2 * j] + b[2 * j + 1]);
+      }
+      row[coarse.angular] = row[0];
+    }
+    levels.push_back(std::move(coarse));
+  }
+
+  falloff.resize(FALLOFF_SIZE + 1);
+  for (int i = 0; i <= FALLOFF_SIZE; i++) {
+    falloff[i] = static_cast<float>(std::exp(-10.0 * HALF_THICKNESS * i / FALLOFF_SIZE));
+  }
+
+  error = measureError(blackHole);
+}
+
+double DiskTexture::fetch(const Level &level, double r, double angle) const {
+  double fr = std::clamp((r - innerR) * level.invTexelR - 0.5, 0.0, level.radial - 1.0);
+  int ir = std::min(static_cast<int>(fr), level.radial - 2);
+  double tr = fr - ir;
+
+  // Any angle, wrapped onto [0, angular); the repeated last column covers the seam
+  double fa = angle * level.invTexelAngle - 0.5;
+  fa -= std::floor(fa / level.angular) * level.angular;
+  int ia = std::min(static_cast<int>(fa), level.angular - 1);
+  double ta = fa - ia;
+
+  const size_t stride = level.angular + 1;
+  const float *p = &level.texels[static_cast<size_t>(ir) * stride + ia];
+  double near = p[0] + (p[1] - p[0]) * ta;
+  double far = p[stride] + (p[stride + 1] - p[stride]) * ta;
+  return near + (far - near) * tr;
+}
+
+double DiskTexture::pattern(double r, double angle, double time) const {
+  return fetch(levels[0], r, angle + time * ROTATION_SPEED);
+}
+
+double DiskTexture::density(const Vector3 &pos, double time, double footprint) const {
+  double r2 = pos.lengthSquared();
+  double height = std::abs(pos.y);
+  if (r2 < innerR * innerR || r2 > outerR * outerR || height > HALF_THICKNESS)
+    return 0.0;
+  double r = std::sqrt(r2);
+
+  // Edge fade as in BlackHole::diskEnvelope
+  double fade = 1.0;
+  if (r < rs * 3.0)
+    fade = (r - innerR) / (rs * 0.5);
+  if (r > rs * 10.0)
+    fade = (outerR - r) / (rs * 2.0);
+
+  double fh = height * (FALLOFF_SIZE / HALF_THICKNESS);
+  int ih = std::min(static_cast<int>(fh), FALLOFF_SIZE - 1);
+  double vertical = falloff[ih] + (falloff[ih + 1] - falloff[ih]) * (fh - ih);
+
+  double angle = fastAtan2(pos.z, pos.x) + time * ROTATION_SPEED;
+  // Coarsest level whose texels (along the finer-sampled axis) still fit in the footprint
+  int level = 0;
+  if (footprint > 0.0) {
+    const Level &base = levels[0];
+    int exponent;
+    std::frexp(footprint * std::max(base.invTexelR, base.invTexelAngle / r), &exponent);
+    level = std::clamp(exponent - 1, 0, static_cast<int>(levels.size()) - 1);
+  }
+  return fetch(levels[level], r, angle) * fade * vertical;
+}
+
+size_t DiskTexture::bytes() const {
+  size_t total = falloff.size() * sizeof(float);
+  for (const Level &level : levels) {
+    total += level.texels.size() * sizeof(float);
+  }
+  return total;
+}
+
+double DiskTexture::measureError(const BlackHole &blackHole) const {
+  // Probes fall between texels (where bilinear error peaks), at a mid-slab height and a
+  // time that puts the rotation offset off the texel grid
+  const double time = 1.2345;
+  const double y = 0.05;
+  double worst = 0.0;
+  for (int i = 0; i < ERROR_PROBES; i++) {
+    double r = innerR + (outerR - innerR) * (i + 0.37) / ERROR_PROBES;
+    for (int j = 0; j < ERROR_PROBES; j++) {
+      double angle = TWO_PI * (j + 0.61) / ERROR_PROBES - std::numbers::pi;
+      double planar = std::sqrt(std::max(r * r - y * y, 0.0));
+      Vector3 pos(planar * std::cos(angle), y, planar * std::sin(angle));
+      double procedural = blackHole.diskPattern(pos.length(), std::atan2(pos.z, pos.x), time) *
+                          blackHole.diskEnvelope(pos);
+      worst = std::max(worst, std::abs(density(pos, time) - procedural));
+    }
+  }
+  return worst;
+}
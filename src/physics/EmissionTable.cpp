@@ -0,0 +1,73 @@
+#include "../../include/physics/EmissionTable.hpp"
+#include "../../include/physics/BlackHole.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Nodes at t = 0.5 (palette midpoint) and delta = 0.85, 1.0, 1.2 (where the Doppler colour
+// shift saturates or changes side); between them the emission is smooth
+constexpr int T_INTERVALS = 16;
+constexpr int DELTA_INTERVALS = 120; // Steps of 1/80 over [0.5, 2.0]
+constexpr int T_NODES = T_INTERVALS + 1;
+constexpr int DELTA_NODES = DELTA_INTERVALS + 1;
+constexpr size_t MODE_STRIDE = static_cast<size_t>(T_NODES) * DELTA_NODES * 3;
+
+} // namespace
+
+EmissionTable::EmissionTable(const BlackHole &blackHole)
+    : innerR(blackHole.rs * 2.5), invWidth(1.0 / (blackHole.rs * 9.5)), error(0.0) {
+  texels.resize(MODE_STRIDE * MODES);
+  float *out = texels.data();
+  for (int mode = 0; mode < MODES; mode++) {
+    for (int d = 0; d < DELTA_NODES; d++) {
+      double delta = MIN_DELTA + (MAX_DELTA - MIN_DELTA) * d / DELTA_INTERVALS;
+      for (int i = 0; i < T_NODES; i++) {
+        Vector3 color = blackHole.diskEmission(innerR + static_cast<double>(i) / T_INTERVALS / invWidth, delta, mode);
+        *out++ = static_cast<float>(color.x);
+        *out++ = static_cast<float>(color.y);
+        *out++ = static_cast<float>(color.z);
+      }
+    }
+  }
+  error = measureError(blackHole);
+}
+
+Vector3 EmissionTable::emission(double r, double delta, int colorMode) const {
+  double ft = std::clamp((r - innerR) * invWidth, 0.0, 1.0) * T_INTERVALS;
+  int it = std::min(static_cast<int>(ft), T_INTERVALS - 1);
+  double wt = ft - it;
+  double fd = (delta - MIN_DELTA) * (DELTA_INTERVALS / (MAX_DELTA - MIN_DELTA));
+  int id = std::clamp(static_cast<int>(fd), 0, DELTA_INTERVALS - 1);
+  double wd = fd - id;
+
+  // Unknown modes get the last (white) palette, as in diskEmission
+  int mode = colorMode >= 0 && colorMode < MODES ? colorMode : MODES - 1;
+  const float *p = &texels[MODE_STRIDE * mode + (static_cast<size_t>(id) * T_NODES + it) * 3];
+  const float *q = p + T_NODES * 3;
+  double c[3];
+  for (int k = 0; k < 3; k++) {
+    double near = p[k] + (p[k + 3] - p[k]) * wt;
+    double far = q[k] + (q[k + 3] - q[k]) * wt;
+    c[k] = near + (far - near) * wd;
+  }
+  return Vector3(c[0], c[1], c[2]);
+}
+
+double EmissionTable::measureError(const BlackHole &blackHole) const {
+  // Cell centres, where bilinear error peaks
+  double worst = 0.0;
+  for (int mode = 0; mode < MODES; mode++) {
+    for (int d = 0; d < DELTA_INTERVALS; d++) {
+      double delta = MIN_DELTA + (MAX_DELTA - MIN_DELTA) * (d + 0.5) / DELTA_INTERVALS;
+      for (int i = 0; i < T_INTERVALS; i++) {
+        double r = innerR + (i + 0.5) / T_INTERVALS / invWidth;
+        Vector3 exact = blackHole.diskEmission(r, delta, mode);
+        Vector3 diff = emission(r, delta, mode) - exact;
+        double scale = std::max({exact.x, exact.y, exact.z, 1e-12});
+        worst = std::max(worst, std::max({std::abs(diff.x), std::abs(diff.y), std::abs(diff.z)}) / scale);
+      }
+    }
+  }
+  return worst;
+}
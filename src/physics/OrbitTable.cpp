@@ -0,0 +1,538 @@
+#include "../../include/physics/OrbitTable.hpp"
+#include "../../include/physics/OrbitalPlane.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// External logging function from main.cpp
+extern void appLog(const std::string& message, bool isError = false);
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr char MAGIC[8] = {'B', 'H', 'O', 'R', 'B', 'I', 'T', '\0'};
+constexpr uint32_t VERSION = 1;
+
+constexpr uint32_t ORBITS_PER_SIDE = 1024;  // Captured / escaping orbits each
+constexpr double PHI_STEP = 2.0 * PI / 1024.0;
+constexpr int SUBSTEPS = 4;                 // RK4 steps per stored sample
+constexpr double R_START = 1000.0;          // Well beyond MAX_DIST from any camera
+constexpr double B_MAX = 128.0;
+constexpr double PHI_LIMIT = 8.0 * PI;      // Orbits winding longer are treated as captured
+
+constexpr double MIN_SLAB_SLOPE = 0.05;     // |dir.y| below this: chord longer than 8 units
+constexpr double CAMERA_SLAB_MARGIN = 0.25; // Camera this close to the disk plane: trace instead
+
+const char *CACHE_DIR = "blackhole-sim";
+const char *CACHE_FILE = "orbits.bin";
+
+// mkdir -p for the directory part of `path`
+bool makeParentDirectories(const std::string &path) {
+  for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+    std::string dir = path.substr(0, slash);
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+      return false;
+    }
+  }
+  return true;
+}
+
+double criticalImpact(double rs) {
+  return 1.5 * std::sqrt(3.0) * rs; // 3*sqrt(3)*M
+}
+
+// Orbits are sorted by increasing b and packed densely around the critical value,
+// where the deflection diverges
+double impactForIndex(uint32_t index, double bCritical) {
+  if (index < ORBITS_PER_SIDE) {
+    double t = 1.0 - (index + 0.5) / ORBITS_PER_SIDE;
+    return bCritical * (1.0 - t * t);
+  }
+  double t = (index - ORBITS_PER_SIDE + 0.5) / ORBITS_PER_SIDE;
+  return bCritical + (B_MAX - bCritical) * t * t;
+}
+
+struct OrbitState {
+  double u;
+  double du;
+  double s;
+};
+
+OrbitState orbitDerivative(const OrbitState &state, double rs) {
+  // u'' = -u + 3Mu^2, and the arc length ds/dphi = sqrt(u'^2 + u^2) / u^2
+  double u = state.u;
+  return {state.du, -u + 1.5 * rs * u * u, std::sqrt(state.du * state.du + u * u) / (u * u)};
+}
+
+OrbitState advance(const OrbitState &state, const OrbitState &rate, double h) {
+  return {state.u + rate.u * h, state.du + rate.du * h, state.s + rate.s * h};
+}
+
+// Camera placed on one tabulated orbit
+struct OrbitCursor {
+  const OrbitSample *samples;
+  int count;
+  bool captured;  // Ray ends on the horizon rather than escaping
+  double phiCam;  // Camera position on the incoming branch
+  double sCam;
+  int sigma;      // +1 inward ray (forward along the orbit), -1 outward ray (backwards)
+  double thetaEnd;
+
+  bool place(const OrbitRecord &record, const OrbitSample *orbitSamples, double u0, bool inward) {
+    samples = orbitSamples;
+    count = static_cast<int>(record.sampleCount);
+    int peri = static_cast<int>(record.periapsisIndex);
+    if (count < 2 || samples[0].u > u0) {
+      return false; // Camera outside the tabulated range
+    }
+
+    // u increases monotonically along the incoming branch
+    int lo = 0;
+    int hi = peri;
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (samples[mid].u <= u0) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
+    }
+
+    double frac = 0.0;
+    if (lo < peri && samples[lo + 1].u > samples[lo].u) {
+      frac = std::clamp((u0 - samples[lo].u) / (samples[lo + 1].u - samples[lo].u), 0.0, 1.0);
+    }
+    phiCam = (lo + frac) * PHI_STEP;
+    int next = std::min(lo + 1, count - 1);
+    sCam = samples[lo].s + (samples[next].s - samples[lo].s) * frac;
+
+    sigma = inward ? 1 : -1;
+    captured = inward && record.captured != 0;
+    thetaEnd = inward ? (count - 1) * PHI_STEP - phiCam : phiCam;
+    return true;
+  }
+
+  // Orbit state at swept angle theta: u, du/dtheta and path length from the camera
+  bool at(double theta, OrbitState &out) const {
+    if (theta > thetaEnd) {
+      return false;
+    }
+    double f = (phiCam + sigma * theta) / PHI_STEP;
+    int i = std::clamp(static_cast<int>(f), 0, count - 2);
+    double t = std::clamp(f - i, 0.0, 1.0);
+    const OrbitSample &a = samples[i];
+    const OrbitSample &b = samples[i + 1];
+    out.u = a.u + (b.u - a.u) * t;
+    out.du = (a.du + (b.du - a.du) * t) * sigma;
+    out.s = std::abs(a.s + (b.s - a.s) * t - sCam);
+    return true;
+  }
+
+  // Swept angle after which the ray has travelled `dist` (infinity if the orbit ends first)
+  double thetaAtDistance(double dist) const {
+    double target = sCam + sigma * dist;
+    if (target < samples[0].s || target > samples[count - 1].s) {
+      return std::numeric_limits<double>::infinity();
+    }
+    int lo = 0;
+    int hi = count - 1;
+    while (hi - lo > 1) {
+      int mid = (lo + hi) / 2;
+      if (samples[mid].s <= target) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    double span = samples[hi].s - samples[lo].s;
+    double t = span > 0.0 ? (target - samples[lo].s) / span : 0.0;
+    double phi = (lo + t) * PHI_STEP;
+    return std::abs(phi - phiCam);
+  }
+};
+
+// Linear blend of the two orbits bracketing the ray's orbit constant
+struct BlendedOrbit {
+  OrbitCursor cursors[2];
+  double weight; // Weight of cursors[1]
+  int used;
+
+  bool at(double theta, OrbitState &out) const {
+    OrbitState a;
+    OrbitState b;
+    bool hasA = cursors[0].at(theta, a);
+    if (used == 1) {
+      out = a;
+      return hasA;
+    }
+    bool hasB = cursors[1].at(theta, b);
+    if (hasA && hasB) {
+      out.u = a.u + (b.u - a.u) * weight;
+      out.du = a.du + (b.du - a.du) * weight;
+      out.s = a.s + (b.s - a.s) * weight;
+      return true;
+    }
+    out = hasA ? a : b;
+    return hasA || hasB;
+  }
+
+  double blend(double a, double b) const {
+    if (used == 1) return a;
+    if (!std::isfinite(a) || !std::isfinite(b)) return weight < 0.5 ? a : b;
+    return a + (b - a) * weight;
+  }
+};
+
+} // namespace
+
+OrbitTable::OrbitTable()
+    : mappedData(nullptr), mappedSize(0), header(nullptr), records(nullptr), samples(nullptr) {}
+
+OrbitTable::~OrbitTable() {
+  unmap();
+}
+
+std::string OrbitTable::defaultCachePath() {
+  const char *configured = std::getenv("BLACKHOLE_CPU_ORBIT_CACHE");
+  if (configured && configured[0] != '\0') {
+    return std::strcmp(configured, "none") == 0 ? std::string() : std::string(configured);
+  }
+
+  // Platform cache directory: $XDG_CACHE_HOME, else ~/Library/Caches (macOS) or ~/.cache
+  std::string cacheDir;
+  const char *xdgCache = std::getenv("XDG_CACHE_HOME");
+  const char *home = std::getenv("HOME");
+  if (xdgCache && xdgCache[0] == '/') {
+    cacheDir = xdgCache;
+  } else if (home && home[0] != '\0') {
+#ifdef __APPLE__
+    cacheDir = std::string(home) + "/Library/Caches";
+#else
+    cacheDir = std::string(home) + "/.cache";
+#endif
+  } else {
+    return std::string();
+  }
+  return cacheDir + "/" + CACHE_DIR + "/" + CACHE_FILE;
+}
+
+bool OrbitTable::loadOrBuild(const BlackHole &blackHole, const std::string &cachePath) {
+  if (!cachePath.empty() && map(cachePath, blackHole)) {
+    std::ostringstream logMsg;
+    logMsg << "[ORBIT] Mapped " << orbitCount() << " orbits (" << header->sampleCount
+           << " samples) from " << cachePath;
+    appLog(logMsg.str());
+    return true;
+  }
+
+  auto start = std::chrono::high_resolution_clock::now();
+  build(blackHole);
+  auto end = std::chrono::high_resolution_clock::now();
+
+  std::ostringstream logMsg;
+  logMsg << "[ORBIT] Precomputed " << orbitCount() << " orbits (" << header->sampleCount << " samples, "
+         << ownedData.size() / (1024 * 1024) << " MB) in "
+         << std::chrono::duration<double, std::milli>(end - start).count() << " ms";
+  appLog(logMsg.str());
+
+  if (!cachePath.empty()) {
+    if (makeParentDirectories(cachePath) && save(cachePath)) {
+      appLog("[ORBIT] Saved orbit table to " + cachePath);
+    } else {
+      appLog("[ORBIT] Could not write orbit table to " + cachePath, true);
+    }
+  }
+  return isReady();
+}
+
+void OrbitTable::build(const BlackHole &blackHole) {
+  unmap();
+
+  const double rs = blackHole.rs;
+  const double bCritical = criticalImpact(rs);
+  const double uStart = 1.0 / R_START;
+  const double uHorizon = 1.0 / rs;
+  const double h = PHI_STEP / SUBSTEPS;
+  const uint32_t orbitCount = ORBITS_PER_SIDE * 2;
+
+  std::vector<OrbitRecord> orbitRecords(orbitCount);
+  std::vector<OrbitSample> orbitSamples;
+  orbitSamples.reserve(static_cast<size_t>(orbitCount) * 640);
+
+  for (uint32_t index = 0; index < orbitCount; index++) {
+    OrbitRecord &record = orbitRecords[index];
+    record.b = impactForIndex(index, bCritical);
+    record.firstSample = orbitSamples.size();
+    record.captured = 0;
+    record.reserved = 0;
+
+    // Start on the incoming branch far from the hole
+    OrbitState state;
+    state.u = uStart;
+    state.du = std::sqrt(std::max(0.0, 1.0 / (record.b * record.b) - uStart * uStart + rs * uStart * uStart * uStart));
+    state.s = 0.0;
+    orbitSamples.push_back({static_cast<float>(state.u), static_cast<float>(state.du), static_cast<float>(state.s)});
+
+    double phi = 0.0;
+    bool done = false;
+    while (!done) {
+      for (int i = 0; i < SUBSTEPS; i++) {
+        OrbitState k1 = orbitDerivative(state, rs);
+        OrbitState k2 = orbitDerivative(advance(state, k1, h * 0.5), rs);
+        OrbitState k3 = orbitDerivative(advance(state, k2, h * 0.5), rs);
+        OrbitState k4 = orbitDerivative(advance(state, k3, h), rs);
+        state.u += (k1.u + 2.0 * k2.u + 2.0 * k3.u + k4.u) * (h / 6.0);
+        state.du += (k1.du + 2.0 * k2.du + 2.0 * k3.du + k4.du) * (h / 6.0);
+        state.s += (k1.s + 2.0 * k2.s + 2.0 * k3.s + k4.s) * (h / 6.0);
+
+        if (state.u >= uHorizon) {
+          record.captured = 1;
+          done = true;
+          break;
+        }
+        if (state.du < 0.0 && state.u <= uStart) {
+          done = true; // Back out at R_START
+          break;
+        }
+      }
+      phi += PHI_STEP;
+      if (!done && phi > PHI_LIMIT) {
+        record.captured = 1; // Winding on the photon sphere
+        done = true;
+      }
+      orbitSamples.push_back({static_cast<float>(state.u), static_cast<float>(state.du), static_cast<float>(state.s)});
+    }
+
+    record.sampleCount = static_cast<uint32_t>(orbitSamples.size() - record.firstSample);
+    const OrbitSample *first = orbitSamples.data() + record.firstSample;
+    record.periapsisIndex = static_cast<uint32_t>(
+        std::max_element(first, first + record.sampleCount,
+                         [](const OrbitSample &a, const OrbitSample &b) { return a.u < b.u; }) -
+        first);
+  }
+
+  OrbitTableHeader tableHeader;
+  std::memcpy(tableHeader.magic, MAGIC, sizeof(MAGIC));
+  tableHeader.version = VERSION;
+  tableHeader.orbitsPerSide = ORBITS_PER_SIDE;
+  tableHeader.sampleCount = orbitSamples.size();
+  tableHeader.rs = rs;
+  tableHeader.phiStep = PHI_STEP;
+  tableHeader.rStart = R_START;
+  tableHeader.bCritical = bCritical;
+  tableHeader.bMax = B_MAX;
+
+  size_t recordBytes = orbitRecords.size() * sizeof(OrbitRecord);
+  size_t sampleBytes = orbitSamples.size() * sizeof(OrbitSample);
+  ownedData.resize(sizeof(OrbitTableHeader) + recordBytes + sampleBytes);
+  std::memcpy(ownedData.data(), &tableHeader, sizeof(OrbitTableHeader));
+  std::memcpy(ownedData.data() + sizeof(OrbitTableHeader), orbitRecords.data(), recordBytes);
+  std::memcpy(ownedData.data() + sizeof(OrbitTableHeader) + recordBytes, orbitSamples.data(), sampleBytes);
+
+  bindStorage(ownedData.data(), ownedData.size());
+}
+
+bool OrbitTable::save(const std::string &path) const {
+  if (ownedData.empty()) {
+    return false;
+  }
+
+  // Write then rename so a crash never leaves a truncated table behind
+  std::string tempPath = path + ".tmp";
+  std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    return false;
+  }
+  file.write(reinterpret_cast<const char *>(ownedData.data()), static_cast<std::streamsize>(ownedData.size()));
+  file.close();
+  if (!file) {
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  return std::rename(tempPath.c_str(), path.c_str()) == 0;
+}
+
+bool OrbitTable::map(const std::string &path, const BlackHole &blackHole) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(OrbitTableHeader))) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(info.st_size);
+  void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  // Only accept a table built for this black hole with the current layout
+  const OrbitTableHeader *candidate = static_cast<const OrbitTableHeader *>(data);
+  bool matches = std::memcmp(candidate->magic, MAGIC, sizeof(MAGIC)) == 0 && candidate->version == VERSION &&
+                 candidate->orbitsPerSide == ORBITS_PER_SIDE && candidate->rs == blackHole.rs &&
+                 candidate->phiStep == PHI_STEP && candidate->rStart == R_START && candidate->bMax == B_MAX;
+  if (!matches || !bindStorage(static_cast<const uint8_t *>(data), size)) {
+    munmap(data, size);
+    header = nullptr;
+    return false;
+  }
+
+  ownedData.clear();
+  ownedData.shrink_to_fit();
+  mappedData = data;
+  mappedSize = size;
+  return true;
+}
+
+void OrbitTable::unmap() {
+  if (mappedData) {
+    munmap(mappedData, mappedSize);
+    mappedData = nullptr;
+    mappedSize = 0;
+    header = nullptr;
+    records = nullptr;
+    samples = nullptr;
+  }
+}
+
+bool OrbitTable::bindStorage(const uint8_t *data, size_t size) {
+  const OrbitTableHeader *candidate = reinterpret_cast<const OrbitTableHeader *>(data);
+  size_t orbitTotal = static_cast<size_t>(candidate->orbitsPerSide) * 2;
+  size_t recordBytes = orbitTotal * sizeof(OrbitRecord);
+  if (size < sizeof(OrbitTableHeader) + recordBytes ||
+      candidate->sampleCount > (size - sizeof(OrbitTableHeader) - recordBytes) / sizeof(OrbitSample)) {
+    return false;
+  }
+
+  const OrbitRecord *candidateRecords = reinterpret_cast<const OrbitRecord *>(data + sizeof(OrbitTableHeader));
+  for (size_t i = 0; i < orbitTotal; i++) {
+    const OrbitRecord &record = candidateRecords[i];
+    if (record.sampleCount < 2 || record.periapsisIndex >= record.sampleCount ||
+        record.firstSample + record.sampleCount > candidate->sampleCount) {
+      return false;
+    }
+  }
+
+  header = candidate;
+  records = candidateRecords;
+  samples = reinterpret_cast<const OrbitSample *>(data + sizeof(OrbitTableHeader) + recordBytes);
+  return true;
+}
+
+double OrbitTable::orbitCoordinate(double b) const {
+  const double perSide = header->orbitsPerSide;
+  if (b < header->bCritical) {
+    double t = std::sqrt(std::max(0.0, 1.0 - b / header->bCritical));
+    return std::clamp(perSide * (1.0 - t) - 0.5, 0.0, perSide - 1.0);
+  }
+  double t = std::sqrt((b - header->bCritical) / (header->bMax - header->bCritical));
+  return std::clamp(perSide + perSide * t - 0.5, perSide, 2.0 * perSide - 1.0);
+}
+
+bool OrbitTable::covers(const Vector3 &cameraPos) const {
+  return header && cameraPos.length() < header->rStart * 0.5 &&
+         std::abs(cameraPos.y) >= 0.2 + CAMERA_SLAB_MARGIN;
+}
+
+bool OrbitTable::trace(const BlackHole &blackHole, const Ray &ray, const ShadingParams &shading,
+                       double stepSize, double maxDist, Vector3 &color) const {
+  if (!covers(ray.origin)) {
+    return false;
+  }
+
+  if (ray.origin.length() <= header->rs) {
+    color = Vector3(0, 0, 0);
+    return true;
+  }
+
+  OrbitalPlane plane(ray.origin, ray.direction.normalized());
+  if (std::abs(plane.e1.y) < 1e-9 && std::abs(plane.e2.y) < 1e-9) {
+    return false; // Orbit inside the disk plane
+  }
+
+  // (camera radius, b) -> orbit constant of the tabulated curve through the camera
+  double u0 = 1.0 / plane.r0;
+  double invB2 = plane.sinPsi < 1e-9 ? 1e24 : plane.inverseImpactSquared(header->rs);
+  double bOrbit = 1.0 / std::sqrt(std::max(invB2, 1e-24));
+  if (bOrbit > header->bMax) {
+    return false;
+  }
+
+  bool inward = plane.cosPsi < 0.0;
+  double coordinate = orbitCoordinate(bOrbit);
+  uint32_t i0 = static_cast<uint32_t>(coordinate);
+  uint32_t i1 = std::min(i0 + 1, header->orbitsPerSide * 2 - 1);
+
+  BlendedOrbit orbit{};
+  orbit.weight = coordinate - i0;
+  orbit.used = 2;
+  if (i1 == i0 || records[i0].captured != records[i1].captured) {
+    // Never blend across the shadow edge
+    if (orbit.weight >= 0.5) i0 = i1;
+    orbit.used = 1;
+  }
+  for (int k = 0; k < orbit.used; k++) {
+    const OrbitRecord &record = records[k == 0 ? i0 : i1];
+    if (!orbit.cursors[k].place(record, samples + record.firstSample, u0, inward)) {
+      return false;
+    }
+  }
+
+  double thetaEnd = orbit.blend(orbit.cursors[0].thetaEnd, orbit.cursors[1].thetaEnd);
+  double thetaDist = orbit.blend(orbit.cursors[0].thetaAtDistance(maxDist),
+                                 orbit.cursors[1].thetaAtDistance(maxDist));
+  bool captured = orbit.cursors[0].captured && thetaEnd <= thetaDist;
+  double thetaStop = std::min(thetaEnd, thetaDist);
+
+  // The orbital plane meets y = 0 along a line: crossings every pi from theta0
+  double theta0 = std::atan2(-plane.e1.y, plane.e2.y);
+  if (theta0 < 0.0) theta0 += PI;
+
+  color = Vector3(0, 0, 0);
+  double transmittance = 1.0;
+  for (double theta = theta0; theta < thetaStop && transmittance > 0.01; theta += PI) {
+    OrbitState state;
+    if (!orbit.at(theta, state)) {
+      break;
+    }
+    double r = 1.0 / state.u;
+    if (r < header->rs * 2.5 - 1.0 || r > header->rs * 12.0 + 1.0) {
+      continue; // Slab chord cannot reach the disk annulus
+    }
+
+    Vector3 pos = plane.position(theta, state.u);
+    Vector3 tangent = plane.tangent(theta, state.u, state.du);
+    if (std::abs(tangent.y) < MIN_SLAB_SLOPE) {
+      return false; // Grazing the disk: the straight-chord approximation breaks down
+    }
+    color += blackHole.integrateDiskCrossing(pos, tangent, shading, stepSize, transmittance);
+  }
+
+  if (captured) {
+    return true;
+  }
+
+  OrbitState exitState;
+  if (!orbit.at(thetaStop, exitState) && !orbit.at(thetaStop - PHI_STEP, exitState)) {
+    return false;
+  }
+  Vector3 exitDir = plane.tangent(thetaStop, exitState.u, exitState.du);
+  color += blackHole.sampleBackground(exitDir, shading.time) * transmittance;
+  return true;
+}
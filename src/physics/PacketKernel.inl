@@ -0,0 +1,316 @@
+// Lane-parallel RK4 kernel shared by the PacketTracer*.cpp translation units.
+// Each includer compiles it with its own -m flags; everything here has internal
+// linkage so the per-ISA copies never get merged by the linker.
+//
+// The loops below run over fixed-width float arrays with branch-free bodies
+// (selects instead of ifs) so the compiler maps each one onto a single vector
+// register. sin/exp/atan2 are polynomial approximations for the same reason.
+
+#include "../../include/physics/PacketTracer.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+constexpr float K_PI = 3.14159265f;
+constexpr float K_HALF_PI = 1.57079633f;
+
+// sin(x) with Cody-Waite reduction to [-pi, pi], folded to [-pi/2, pi/2]
+inline float laneSin(float x) {
+  float k = std::floor(x * 0.159154943f + 0.5f);
+  x = x - k * 6.28318548f;
+  x = x - k * -1.74845553e-7f;
+  x = x > K_HALF_PI ? K_PI - x : x;
+  x = x < -K_HALF_PI ? -K_PI - x : x;
+  float s = x * x;
+  float p = 2.75573192e-6f;
+  p = p * s - 1.98412698e-4f;
+  p = p * s + 8.33333333e-3f;
+  p = p * s - 1.66666667e-1f;
+  return x + x * s * p;
+}
+
+// exp(x) for x <= 0 via 2^k * P(f)
+inline float laneExp(float x) {
+  x = std::max(x, -87.0f);
+  float k = std::floor(x * 1.44269504f + 0.5f);
+  float f = x - k * 0.693145752f;
+  f = f - k * 1.42860677e-6f;
+  float p = 1.38888889e-3f;
+  p = p * f + 8.33333333e-3f;
+  p = p * f + 4.16666667e-2f;
+  p = p * f + 1.66666667e-1f;
+  p = p * f + 0.5f;
+  p = p * f + 1.0f;
+  p = p * f + 1.0f;
+  int32_t bits = (static_cast<int32_t>(k) + 127) << 23;
+  return p * std::bit_cast<float>(bits);
+}
+
+// atan2(y, x), max error ~1e-5 rad
+inline float laneAtan2(float y, float x) {
+  float ax = std::fabs(x);
+  float ay = std::fabs(y);
+  float mx = std::max(ax, ay);
+  float mn = std::min(ax, ay);
+  float a = mx > 0.0f ? mn / mx : 0.0f;
+  float s = a * a;
+  float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+  r = ay > ax ? K_HALF_PI - r : r;
+  r = x < 0.0f ? K_PI - r : r;
+  return y < 0.0f ? -r : r;
+}
+
+// Palettes indexed by colorMode (must match diskColor / disk_color)
+struct Palette {
+  float hot[3], mid[3], cold[3], bright[3], dim[3];
+};
+
+constexpr Palette PALETTES[4] = {
+    {{0.7f, 0.85f, 1.0f}, {0.75f, 0.85f, 1.0f}, {0.5f, 0.6f, 0.8f}, {0.85f, 0.92f, 1.0f}, {0.5f, 0.6f, 0.8f}},
+    {{1.0f, 0.9f, 0.7f}, {1.0f, 0.75f, 0.5f}, {0.9f, 0.6f, 0.4f}, {1.0f, 0.95f, 0.85f}, {0.8f, 0.5f, 0.3f}},
+    {{1.0f, 0.85f, 0.75f}, {1.0f, 0.6f, 0.5f}, {0.85f, 0.4f, 0.3f}, {1.0f, 0.9f, 0.85f}, {0.7f, 0.3f, 0.2f}},
+    {{1.0f, 1.0f, 1.0f}, {0.9f, 0.9f, 0.9f}, {0.7f, 0.7f, 0.7f}, {1.0f, 1.0f, 1.0f}, {0.6f, 0.6f, 0.6f}},
+};
+
+// Geodesic acceleration for all lanes: a = -1.5 rs |x × v|^2 / r^5 * x
+template <int W>
+inline void laneAcceleration(const float *px, const float *py, const float *pz,
+                             const float *vx, const float *vy, const float *vz,
+                             float rs, float *ax, float *ay, float *az) {
+  for (int i = 0; i < W; i++) {
+    float r2 = px[i] * px[i] + py[i] * py[i] + pz[i] * pz[i];
+    float r = std::sqrt(r2);
+    float hx = py[i] * vz[i] - pz[i] * vy[i];
+    float hy = pz[i] * vx[i] - px[i] * vz[i];
+    float hz = px[i] * vy[i] - py[i] * vx[i];
+    float h2 = hx * hx + hy * hy + hz * hz;
+    float factor = -1.5f * rs * h2 / (r2 * r2 * r);
+    ax[i] = px[i] * factor;
+    ay[i] = py[i] * factor;
+    az[i] = pz[i] * factor;
+  }
+}
+
+// Record = true also appends every lane's disk samples to params.records[lane] (raw, one
+// per step, unfolded) and follows paths past opacity, as BlackHole::trace does with a record
+template <int W, bool Record>
+void tracePacketLanes(RayPacket &packet, const PacketKernelParams &params) {
+  const float rs = params.rs;
+  const float rs2 = rs * rs;
+  const float innerR = rs * 2.5f;
+  const float outerR = rs * 12.0f;
+  const Palette &pal = PALETTES[std::clamp(params.colorMode, 0, 3)];
+
+  alignas(64) float px[W], py[W], pz[W], vx[W], vy[W], vz[W];
+  alignas(64) float cr[W], cg[W], cb[W], trans[W], dist[W];
+  alignas(64) float alive[W], escaped[W], rad[W], dt[W];
+  alignas(64) float envelope[W], doppler[W]; // Disk samples of the current step (Record only)
+
+  for (int i = 0; i < W; i++) {
+    bool valid = i < packet.count;
+    px[i] = valid ? packet.originX[i] : 0.0f;
+    py[i] = valid ? packet.originY[i] : 0.0f;
+    pz[i] = valid ? packet.originZ[i] : 100.0f;
+    vx[i] = valid ? packet.dirX[i] : 0.0f;
+    vy[i] = valid ? packet.dirY[i] : 0.0f;
+    vz[i] = valid ? packet.dirZ[i] : 1.0f;
+    cr[i] = cg[i] = cb[i] = 0.0f;
+    trans[i] = 1.0f;
+    dist[i] = 0.0f;
+    alive[i] = valid ? 1.0f : 0.0f;
+    escaped[i] = 0.0f;
+  }
+
+  while (true) {
+    // Loop condition and event horizon, in the same order as BlackHole::trace
+    float anyAlive = 0.0f;
+    float anyInSlab = 0.0f;
+    for (int i = 0; i < W; i++) {
+      bool live = alive[i] != 0.0f;
+      bool finished = live && !(dist[i] < params.maxDist && (Record || trans[i] > 0.01f));
+      escaped[i] = finished ? 1.0f : escaped[i];
+      live = live && !finished;
+      float r2 = px[i] * px[i] + py[i] * py[i] + pz[i] * pz[i];
+      live = live && !(r2 < rs2);
+      alive[i] = live ? 1.0f : 0.0f;
+      rad[i] = std::sqrt(r2);
+      anyAlive = std::max(anyAlive, alive[i]);
+      bool slab = live && rad[i] >= innerR && rad[i] <= outerR && std::fabs(py[i]) <= 0.2f;
+      anyInSlab = std::max(anyInSlab, slab ? 1.0f : 0.0f);
+    }
+    if (anyAlive == 0.0f) {
+      break;
+    }
+
+    // Volumetric accretion disk (skipped when no lane is inside the slab)
+    if (anyInSlab != 0.0f) {
+      for (int i = 0; i < W; i++) {
+        float r = rad[i];
+        bool slab = alive[i] != 0.0f && r >= innerR && r <= outerR && std::fabs(py[i]) <= 0.2f;
+
+        float angle = laneAtan2(pz[i], px[i]) + params.time;
+        float spiral = laneSin(angle * 3.0f + r * 0.5f);
+        float rings = laneSin(r * 2.0f);
+        float noise = (spiral + rings) * 0.5f + 0.5f;
+        float fade = r < rs * 3.0f ? (r - innerR) / (rs * 0.5f) : 1.0f;
+        fade = r > rs * 10.0f ? (outerR - r) / (rs * 2.0f) : fade;
+        float falloff = fade * laneExp(-std::fabs(py[i]) * 10.0f);
+        float density = noise * falloff;
+        bool emit = slab && density > 0.001f;
+
+        // Temperature gradient
+        float t = std::clamp((r - innerR) / (rs * 9.5f), 0.0f, 1.0f);
+        bool inner = t < 0.5f;
+        float w = inner ? t * 2.0f : (t - 0.5f) * 2.0f;
+        float baseR = inner ? pal.hot[0] + (pal.mid[0] - pal.hot[0]) * w : pal.mid[0] + (pal.cold[0] - pal.mid[0]) * w;
+        float baseG = inner ? pal.hot[1] + (pal.mid[1] - pal.hot[1]) * w : pal.mid[1] + (pal.cold[1] - pal.mid[1]) * w;
+        float baseB = inner ? pal.hot[2] + (pal.mid[2] - pal.hot[2]) * w : pal.mid[2] + (pal.cold[2] - pal.mid[2]) * w;
+
+        // Doppler factor of the Keplerian flow
+        float vOrbital = std::min(std::sqrt(rs / (2.0f * r)), 0.5f);
+        float rxz = std::sqrt(px[i] * px[i] + pz[i] * pz[i]);
+        float invRxz = rxz > 0.0f ? 1.0f / rxz : 0.0f;
+        float velX = pz[i] * invRxz * vOrbital;
+        float velZ = -px[i] * invRxz * vOrbital;
+        float gamma = 1.0f / std::sqrt(1.0f - vOrbital * vOrbital);
+        float betaParallel = -(velX * vx[i] + velZ * vz[i]);
+        // Recorded as is; shadeHits applies the Doppler switch itself
+        float flowDelta = 1.0f / (gamma * (1.0f - betaParallel));
+        float delta = params.doppler ? flowDelta : 1.0f;
+        float boost = delta * delta * delta;
+
+        bool approaching = delta > 1.0f;
+        float shift = approaching ? std::min((delta - 1.0f) * 2.0f, 0.4f) : std::min((1.0f - delta) * 2.0f, 0.3f);
+        float targetR = approaching ? pal.bright[0] : pal.dim[0];
+        float targetG = approaching ? pal.bright[1] : pal.dim[1];
+        float targetB = approaching ? pal.bright[2] : pal.dim[2];
+        float scale = density * 4.0f * boost * params.colorIntensity;
+        float emR = (baseR * (1.0f - shift) + targetR * shift) * scale;
+        float emG = (baseG * (1.0f - shift) + targetG * shift) * scale;
+        float emB = (baseB * (1.0f - shift) + targetB * shift) * scale;
+
+        // Beer's law with the same fixed dt as the scalar path
+        float stepTransmittance = laneExp(-density * 0.5f * params.stepSize);
+        float weight = emit ? trans[i] * (1.0f - stepTransmittance) : 0.0f;
+        cr[i] += emR * weight;
+        cg[i] += emG * weight;
+        cb[i] += emB * weight;
+        trans[i] = emit ? trans[i] * stepTransmittance : trans[i];
+        if constexpr (Record) {
+          envelope[i] = slab ? falloff : 0.0f;
+          doppler[i] = flowDelta;
+        }
+      }
+
+      // Same weight as the scalar recorder: optical depth per unit density for this step
+      if constexpr (Record) {
+        float w = 0.5f * params.stepSize;
+        for (int i = 0; i < packet.count; i++) {
+          if (envelope[i] > 0.0f) {
+            params.records[i].hits.push_back({rad[i], std::atan2(pz[i], px[i]), doppler[i], envelope[i] * w,
+                                              envelope[i] * envelope[i] * w});
+          }
+        }
+      }
+    }
+
+    // Adaptive step
+    for (int i = 0; i < W; i++) {
+      dt[i] = std::clamp(params.stepSize * (rad[i] / (rs * 2.0f + 0.1f)), 0.02f, 0.5f);
+    }
+
+    // RK4
+    alignas(64) float k1x[W], k1y[W], k1z[W], k2x[W], k2y[W], k2z[W];
+    alignas(64) float k3x[W], k3y[W], k3z[W], k4x[W], k4y[W], k4z[W];
+    alignas(64) float sx[W], sy[W], sz[W], svx[W], svy[W], svz[W];
+    alignas(64) float p2x[W], p2y[W], p2z[W], p3x[W], p3y[W], p3z[W], p4x[W], p4y[W], p4z[W];
+
+    laneAcceleration<W>(px, py, pz, vx, vy, vz, rs, k1x, k1y, k1z);
+    for (int i = 0; i < W; i++) {
+      float h = dt[i] * 0.5f;
+      sx[i] = px[i] + vx[i] * h;
+      sy[i] = py[i] + vy[i] * h;
+      sz[i] = pz[i] + vz[i] * h;
+      svx[i] = vx[i] + k1x[i] * h;
+      svy[i] = vy[i] + k1y[i] * h;
+      svz[i] = vz[i] + k1z[i] * h;
+      p2x[i] = svx[i];
+      p2y[i] = svy[i];
+      p2z[i] = svz[i];
+    }
+    laneAcceleration<W>(sx, sy, sz, svx, svy, svz, rs, k2x, k2y, k2z);
+    for (int i = 0; i < W; i++) {
+      float h = dt[i] * 0.5f;
+      sx[i] = px[i] + p2x[i] * h;
+      sy[i] = py[i] + p2y[i] * h;
+      sz[i] = pz[i] + p2z[i] * h;
+      svx[i] = vx[i] + k2x[i] * h;
+      svy[i] = vy[i] + k2y[i] * h;
+      svz[i] = vz[i] + k2z[i] * h;
+      p3x[i] = svx[i];
+      p3y[i] = svy[i];
+      p3z[i] = svz[i];
+    }
+    laneAcceleration<W>(sx, sy, sz, svx, svy, svz, rs, k3x, k3y, k3z);
+    for (int i = 0; i < W; i++) {
+      float h = dt[i];
+      sx[i] = px[i] + p3x[i] * h;
+      sy[i] = py[i] + p3y[i] * h;
+      sz[i] = pz[i] + p3z[i] * h;
+      svx[i] = vx[i] + k3x[i] * h;
+      svy[i] = vy[i] + k3y[i] * h;
+      svz[i] = vz[i] + k3z[i] * h;
+      p4x[i] = svx[i];
+      p4y[i] = svy[i];
+      p4z[i] = svz[i];
+    }
+    laneAcceleration<W>(sx, sy, sz, svx, svy, svz, rs, k4x, k4y, k4z);
+
+    for (int i = 0; i < W; i++) {
+      bool live = alive[i] != 0.0f;
+      float h = dt[i] / 6.0f;
+      float nvx = vx[i] + (k1x[i] + k2x[i] * 2.0f + k3x[i] * 2.0f + k4x[i]) * h;
+      float nvy = vy[i] + (k1y[i] + k2y[i] * 2.0f + k3y[i] * 2.0f + k4y[i]) * h;
+      float nvz = vz[i] + (k1z[i] + k2z[i] * 2.0f + k3z[i] * 2.0f + k4z[i]) * h;
+      float npx = px[i] + (vx[i] + p2x[i] * 2.0f + p3x[i] * 2.0f + p4x[i]) * h;
+      float npy = py[i] + (vy[i] + p2y[i] * 2.0f + p3y[i] * 2.0f + p4y[i]) * h;
+      float npz = pz[i] + (vz[i] + p2z[i] * 2.0f + p3z[i] * 2.0f + p4z[i]) * h;
+      float len = std::sqrt(nvx * nvx + nvy * nvy + nvz * nvz);
+      float inv = len > 0.0f ? 1.0f / len : 0.0f;
+
+      // Finished lanes keep their state frozen
+      px[i] = live ? npx : px[i];
+      py[i] = live ? npy : py[i];
+      pz[i] = live ? npz : pz[i];
+      vx[i] = live ? nvx * inv : vx[i];
+      vy[i] = live ? nvy * inv : vy[i];
+      vz[i] = live ? nvz * inv : vz[i];
+      dist[i] = live ? dist[i] + dt[i] : dist[i];
+    }
+  }
+
+  for (int i = 0; i < packet.count; i++) {
+    packet.colorR[i] = cr[i];
+    packet.colorG[i] = cg[i];
+    packet.colorB[i] = cb[i];
+    packet.transmittance[i] = trans[i];
+    packet.exitX[i] = vx[i];
+    packet.exitY[i] = vy[i];
+    packet.exitZ[i] = vz[i];
+    packet.escaped[i] = escaped[i] != 0.0f ? 1 : 0;
+  }
+}
+
+template <int W>
+void tracePacket(RayPacket &packet, const PacketKernelParams &params) {
+  if (params.records) {
+    tracePacketLanes<W, true>(packet, params);
+  } else {
+    tracePacketLanes<W, false>(packet, params);
+  }
+}
+
+} // namespace
@@ -0,0 +1,124 @@
+#include "../../include/physics/PacketTracer.hpp"
+#include "PacketKernel.inl"
+
+void packet_kernels::traceGeneric(RayPacket &packet, const PacketKernelParams &params) {
+  tracePacket<4>(packet, params);
+}
+
+PacketTracer::PacketTracer(const BlackHole &blackHole)
+    : blackHole(blackHole), selectedIsa(PacketIsa::Generic), lanes(4),
+      kernel(packet_kernels::traceGeneric) {
+  setIsa(detectIsa());
+}
+
+PacketIsa PacketTracer::detectIsa() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return PacketIsa::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return PacketIsa::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return PacketIsa::SSE4;
+  }
+#endif
+  return PacketIsa::Generic;
+}
+
+int PacketTracer::lanesFor(PacketIsa isa) {
+  switch (isa) {
+    case PacketIsa::AVX512:
+      return 16;
+    case PacketIsa::AVX2:
+      return 8;
+    case PacketIsa::SSE4:
+    case PacketIsa::Generic:
+    default:
+      return 4;
+  }
+}
+
+const char *PacketTracer::isaName(PacketIsa isa) {
+  switch (isa) {
+    case PacketIsa::AVX512:
+      return "AVX-512";
+    case PacketIsa::AVX2:
+      return "AVX2";
+    case PacketIsa::SSE4:
+      return "SSE4";
+    case PacketIsa::Generic:
+    default:
+      return "Generic";
+  }
+}
+
+void PacketTracer::setIsa(PacketIsa isa) {
+  // Never go wider than the hardware allows
+  if (static_cast<int>(isa) > static_cast<int>(detectIsa())) {
+    isa = detectIsa();
+  }
+
+  selectedIsa = isa;
+  lanes = lanesFor(isa);
+  switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    case PacketIsa::AVX512:
+      kernel = packet_kernels::traceAVX512;
+      break;
+    case PacketIsa::AVX2:
+      kernel = packet_kernels::traceAVX2;
+      break;
+    case PacketIsa::SSE4:
+      kernel = packet_kernels::traceSSE4;
+      break;
+#endif
+    default:
+      selectedIsa = PacketIsa::Generic;
+      lanes = 4;
+      kernel = packet_kernels::traceGeneric;
+      break;
+  }
+}
+
+void PacketTracer::trace(RayPacket &packet, const ShadingParams &shading, double stepSize,
+                         double maxDist, Vector3 *colors, HitRecord *records) const {
+  PacketKernelParams params;
+  params.rs = static_cast<float>(blackHole.rs);
+  params.time = static_cast<float>(shading.time);
+  params.colorMode = shading.colorMode;
+  params.colorIntensity = static_cast<float>(shading.colorIntensity);
+  params.doppler = shading.doppler ? 1 : 0;
+  params.stepSize = static_cast<float>(stepSize);
+  params.maxDist = static_cast<float>(maxDist);
+  params.records = records;
+
+  kernel(packet, params);
+
+  // The kernel appends one sample per step; fold them into hits as the scalar recorder does
+  if (records) {
+    std::vector<DiskHit> samples;
+    for (int i = 0; i < packet.count; i++) {
+      HitRecord &record = records[i];
+      samples.swap(record.hits);
+      record.hits.clear();
+      for (const DiskHit &sample : samples) {
+        blackHole.appendDiskHit(&record, sample.r, sample.phi, sample.doppler, sample.depth, sample.emissionDepth);
+      }
+      record.escaped = packet.escaped[i] != 0;
+      record.escapeDir = Vector3(packet.exitX[i], packet.exitY[i], packet.exitZ[i]);
+      record.transmittance = packet.transmittance[i];
+    }
+  }
+
+  // Background lookup stays scalar: it runs once per ray, not once per step
+  for (int i = 0; i < packet.count; i++) {
+    Vector3 color(packet.colorR[i], packet.colorG[i], packet.colorB[i]);
+    if (packet.escaped[i]) {
+      Vector3 exitDir(packet.exitX[i], packet.exitY[i], packet.exitZ[i]);
+      color += blackHole.sampleBackground(exitDir, shading.time) * packet.transmittance[i];
+    }
+    colors[i] = color;
+  }
+}
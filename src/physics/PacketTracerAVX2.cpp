@@ -0,0 +1,8 @@
+// AVX2 + FMA, 8 float lanes (compiled with -mavx2 -mfma, see Makefile)
+#if defined(__x86_64__) || defined(__i386__)
+#include "PacketKernel.inl"
+
+void packet_kernels::traceAVX2(RayPacket &packet, const PacketKernelParams &params) {
+  tracePacket<8>(packet, params);
+}
+#endif
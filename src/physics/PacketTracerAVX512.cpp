@@ -0,0 +1,8 @@
+// AVX-512F, 16 float lanes (compiled with -mavx512f -mprefer-vector-width=512, see Makefile)
+#if defined(__x86_64__) || defined(__i386__)
+#include "PacketKernel.inl"
+
+void packet_kernels::traceAVX512(RayPacket &packet, const PacketKernelParams &params) {
+  tracePacket<16>(packet, params);
+}
+#endif
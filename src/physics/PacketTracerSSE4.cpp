@@ -0,0 +1,8 @@
+// SSE4.1, 4 float lanes (compiled with -msse4.1, see Makefile)
+#if defined(__x86_64__) || defined(__i386__)
+#include "PacketKernel.inl"
+
+void packet_kernels::traceSSE4(RayPacket &packet, const PacketKernelParams &params) {
+  tracePacket<4>(packet, params);
+}
+#endif
@@ -0,0 +1,144 @@
+#include "../../include/physics/SkyMap.hpp"
+#include "../../include/utils/ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int BAND_ROWS = 16;            // Texel rows traced per pool task
+constexpr uint32_t BUSY = 0xffffffffu;   // Stamp while one thread stores a texel colour
+
+// Major axis and in-face axes of the six cube faces (+X, -X, +Y, -Y, +Z, -Z)
+const Vector3 FACE_AXIS[6] = {Vector3(1, 0, 0), Vector3(-1, 0, 0), Vector3(0, 1, 0),
+                              Vector3(0, -1, 0), Vector3(0, 0, 1), Vector3(0, 0, -1)};
+const Vector3 FACE_U[6] = {Vector3(0, 0, -1), Vector3(0, 0, 1), Vector3(1, 0, 0),
+                           Vector3(1, 0, 0), Vector3(1, 0, 0), Vector3(-1, 0, 0)};
+const Vector3 FACE_V[6] = {Vector3(0, -1, 0), Vector3(0, -1, 0), Vector3(0, 0, 1),
+                           Vector3(0, 0, -1), Vector3(0, -1, 0), Vector3(0, -1, 0)};
+
+} // namespace
+
+SkyMap::SkyMap() : faceSize(0), bandRows(BAND_ROWS), frame(0) {}
+
+Vector3 SkyMap::texelDirection(int face, int x, int y) const {
+  double s = 2.0 * (x + 0.5) / faceSize - 1.0;
+  double t = 2.0 * (y + 0.5) / faceSize - 1.0;
+  return (FACE_AXIS[face] + FACE_U[face] * s + FACE_V[face] * t).normalized();
+}
+
+void SkyMap::build(const BlackHole &blackHole, const Vector3 &position, int size, double stepSize,
+                   double maxDist, ThreadPool &pool, TraceStats *stats) {
+  origin = position;
+  faceSize = std::max(size, 1);
+  const int bandsPerFace = (faceSize + bandRows - 1) / bandRows;
+  const size_t texelCount = static_cast<size_t>(faceSize) * faceSize * 6;
+
+  texels.resize(texelCount);
+  bands.resize(static_cast<size_t>(bandsPerFace) * 6);
+  colors.assign(texelCount * 3, 0.0f);
+  stamps = std::make_unique<std::atomic<uint32_t>[]>(texelCount);
+  for (size_t i = 0; i < texelCount; i++) {
+    stamps[i].store(0, std::memory_order_relaxed);
+  }
+  frame = 0;
+
+  std::atomic<unsigned long long> steps(0);
+  std::atomic<unsigned long long> captured(0);
+  std::atomic<unsigned long long> nearCritical(0);
+  pool.parallelFor(bands.size(), [&](size_t bandIndex, unsigned) {
+    int face = static_cast<int>(bandIndex / bandsPerFace);
+    int y0 = static_cast<int>(bandIndex % bandsPerFace) * bandRows;
+    int y1 = std::min(y0 + bandRows, faceSize);
+    std::vector<DiskHit> &hits = bands[bandIndex];
+    hits.clear();
+
+    TraceStats bandStats;
+    HitRecord record;
+    for (int y = y0; y < y1; y++) {
+      for (int x = 0; x < faceSize; x++) {
+        record.hits.clear();
+        blackHole.trace(Ray(origin, texelDirection(face, x, y)), ShadingParams{}, stepSize, maxDist, &bandStats,
+                        &record);
+        Texel &texel = texels[(static_cast<size_t>(face) * faceSize + y) * faceSize + x];
+        texel.first = static_cast<uint32_t>(hits.size());
+        texel.count = static_cast<uint32_t>(record.hits.size());
+        texel.escapeDir[0] = static_cast<float>(record.escapeDir.x);
+        texel.escapeDir[1] = static_cast<float>(record.escapeDir.y);
+        texel.escapeDir[2] = static_cast<float>(record.escapeDir.z);
+        texel.escaped = record.escaped ? 1 : 0;
+        hits.insert(hits.end(), record.hits.begin(), record.hits.end());
+      }
+    }
+    steps.fetch_add(bandStats.steps, std::memory_order_relaxed);
+    captured.fetch_add(bandStats.capturedRays, std::memory_order_relaxed);
+    nearCritical.fetch_add(bandStats.nearCriticalRays, std::memory_order_relaxed);
+  });
+
+  if (stats) {
+    stats->steps += steps.load();
+    stats->capturedRays += captured.load();
+    stats->nearCriticalRays += nearCritical.load();
+  }
+}
+
+size_t SkyMap::hitCount() const {
+  size_t count = 0;
+  for (const std::vector<DiskHit> &hits : bands) {
+    count += hits.size();
+  }
+  return count;
+}
+
+void SkyMap::beginFrame(const ShadingParams &frameShading) {
+  shading = frameShading;
+  frame = frame + 1 == BUSY ? 1 : frame + 1;
+}
+
+Vector3 SkyMap::texelColor(const BlackHole &blackHole, size_t index) const {
+  uint32_t stamp = stamps[index].load(std::memory_order_acquire);
+  if (stamp == frame) {
+    return Vector3(colors[index * 3], colors[index * 3 + 1], colors[index * 3 + 2]);
+  }
+
+  const Texel &texel = texels[index];
+  size_t facePixels = static_cast<size_t>(faceSize) * faceSize;
+  size_t row = (index % facePixels) / faceSize;
+  size_t band = (index / facePixels) * ((faceSize + bandRows - 1) / bandRows) + row / bandRows;
+  Vector3 escapeDir(texel.escapeDir[0], texel.escapeDir[1], texel.escapeDir[2]);
+  Vector3 color = blackHole.shadeHits(bands[band].data() + texel.first, texel.count,
+                                      texel.escaped ? &escapeDir : nullptr, shading);
+
+  // Publish for the other pixels of this frame unless another thread is already doing so
+  if (stamps[index].compare_exchange_strong(stamp, BUSY, std::memory_order_acquire)) {
+    colors[index * 3] = static_cast<float>(color.x);
+    colors[index * 3 + 1] = static_cast<float>(color.y);
+    colors[index * 3 + 2] = static_cast<float>(color.z);
+    stamps[index].store(frame, std::memory_order_release);
+  }
+  return color;
+}
+
+Vector3 SkyMap::sample(const BlackHole &blackHole, const Vector3 &dir) const {
+  // Face of the major axis, then the in-face coordinates in [-1, 1]
+  double ax = std::abs(dir.x);
+  double ay = std::abs(dir.y);
+  double az = std::abs(dir.z);
+  int face = ax >= ay && ax >= az ? (dir.x >= 0.0 ? 0 : 1) : (ay >= az ? (dir.y >= 0.0 ? 2 : 3) : (dir.z >= 0.0 ? 4 : 5));
+  double major = std::max({ax, ay, az});
+  double s = dir.dot(FACE_U[face]) / major;
+  double t = dir.dot(FACE_V[face]) / major;
+
+  // Bilinear over texel centres (clamped at the face edges)
+  double fx = std::clamp((s + 1.0) * 0.5 * faceSize - 0.5, 0.0, faceSize - 1.0);
+  double fy = std::clamp((t + 1.0) * 0.5 * faceSize - 0.5, 0.0, faceSize - 1.0);
+  int x0 = static_cast<int>(fx);
+  int y0 = static_cast<int>(fy);
+  int x1 = std::min(x0 + 1, faceSize - 1);
+  int y1 = std::min(y0 + 1, faceSize - 1);
+  double wx = fx - x0;
+  double wy = fy - y0;
+
+  size_t faceBase = static_cast<size_t>(face) * faceSize * faceSize;
+  auto at = [&](int x, int y) { return texelColor(blackHole, faceBase + static_cast<size_t>(y) * faceSize + x); };
+  return (at(x0, y0) * (1.0 - wx) + at(x1, y0) * wx) * (1.0 - wy) + (at(x0, y1) * (1.0 - wx) + at(x1, y1) * wx) * wy;
+}
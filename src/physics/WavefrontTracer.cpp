@@ -0,0 +1,248 @@
+#include "../../include/physics/WavefrontTracer.hpp"
+#include "../../include/utils/ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr size_t CHUNK_RAYS = 1024; // Live rays per pool task in one pass
+
+// Must match the slab-stepping step controller in BlackHole::traceRK4
+constexpr double SLAB_FREE_STEP_SCALE = 4.0;
+constexpr double SLAB_MAX_STEP = 2.0;
+constexpr double SLAB_HALF_THICKNESS = 0.2;
+
+// Geodesic acceleration -1.5 rs |pos x vel|^2 / r^5 * pos (BlackHole::acceleration)
+inline void acceleration(double rs, double x, double y, double z, double vx, double vy, double vz, double &ax,
+                         double &ay, double &az) {
+  double r2 = x * x + y * y + z * z;
+  double hx = y * vz - z * vy;
+  double hy = z * vx - x * vz;
+  double hz = x * vy - y * vx;
+  double factor = -1.5 * rs * (hx * hx + hy * hy + hz * hz) / (r2 * r2 * std::sqrt(r2));
+  ax = x * factor;
+  ay = y * factor;
+  az = z * factor;
+}
+
+// One RK4 step for rays [begin, end) of the state buffers. A free function with restrict
+// parameters and a branch-free body, so the compiler vectorizes it across rays.
+void stepRays(double *__restrict px, double *__restrict py, double *__restrict pz, double *__restrict dx,
+              double *__restrict dy, double *__restrict dz, double *__restrict qx, double *__restrict qy,
+              double *__restrict qz, double *__restrict traveled, const double *__restrict scale, size_t begin,
+              size_t end, double rs, double stepSize) {
+  const double innerEntry = rs * 2.5 - 1.0;
+  const double outerEntry = rs * 12.0 + 1.0;
+
+  for (size_t i = begin; i < end; i++) {
+    double x = px[i], y = py[i], z = pz[i];
+    double vx = dx[i], vy = dy[i], vz = dz[i];
+
+    // Geometry-only step, stopped at the slab face when the ray is about to enter the disk
+    double r = std::sqrt(x * x + y * y + z * z);
+    double dt = std::clamp(stepSize * (r / (rs * 2 + 0.1)) * SLAB_FREE_STEP_SCALE, 0.02, SLAB_MAX_STEP) *
+                scale[i];
+    double aboveSlab = std::abs(y) - SLAB_HALF_THICKNESS;
+    double entry = aboveSlab / std::max(std::abs(vy), 1e-300);
+    double ex = x + vx * entry, ey = y + vy * entry, ez = z + vz * entry;
+    double entryR = std::sqrt(ex * ex + ey * ey + ez * ez);
+    bool clip = (aboveSlab > 0.0) & (y * vy < 0.0) & (entry > 0.02) & (entry < dt) & (entryR > innerEntry) &
+                (entryR < outerEntry);
+    dt = clip ? entry : dt;
+
+    double h = dt * 0.5;
+    double k1x, k1y, k1z;
+    acceleration(rs, x, y, z, vx, vy, vz, k1x, k1y, k1z);
+    double p2x = vx + k1x * h, p2y = vy + k1y * h, p2z = vz + k1z * h;
+    double k2x, k2y, k2z;
+    acceleration(rs, x + vx * h, y + vy * h, z + vz * h, p2x, p2y, p2z, k2x, k2y, k2z);
+    double p3x = vx + k2x * h, p3y = vy + k2y * h, p3z = vz + k2z * h;
+    double k3x, k3y, k3z;
+    acceleration(rs, x + p2x * h, y + p2y * h, z + p2z * h, p3x, p3y, p3z, k3x, k3y, k3z);
+    double p4x = vx + k3x * dt, p4y = vy + k3y * dt, p4z = vz + k3z * dt;
+    double k4x, k4y, k4z;
+    acceleration(rs, x + p3x * dt, y + p3y * dt, z + p3z * dt, p4x, p4y, p4z, k4x, k4y, k4z);
+
+    double sixth = dt / 6.0;
+    double nvx = vx + (k1x + 2.0 * k2x + 2.0 * k3x + k4x) * sixth;
+    double nvy = vy + (k1y + 2.0 * k2y + 2.0 * k3y + k4y) * sixth;
+    double nvz = vz + (k1z + 2.0 * k2z + 2.0 * k3z + k4z) * sixth;
+    double inverseLength = 1.0 / std::sqrt(nvx * nvx + nvy * nvy + nvz * nvz);
+
+    qx[i] = x;
+    qy[i] = y;
+    qz[i] = z;
+    px[i] = x + (vx + 2.0 * p2x + 2.0 * p3x + p4x) * sixth;
+    py[i] = y + (vy + 2.0 * p2y + 2.0 * p3y + p4y) * sixth;
+    pz[i] = z + (vz + 2.0 * p2z + 2.0 * p3z + p4z) * sixth;
+    dx[i] = nvx * inverseLength;
+    dy[i] = nvy * inverseLength;
+    dz[i] = nvz * inverseLength;
+    traveled[i] += dt;
+  }
+}
+
+} // namespace
+
+WavefrontTracer::WavefrontTracer(const BlackHole &blackHole) : blackHole(blackHole), rayCount(0) {}
+
+void WavefrontTracer::reset(size_t count) {
+  rayCount = count;
+  colors.resize(count);
+  for (std::vector<double> *buffer : {&posX, &posY, &posZ, &velX, &velY, &velZ, &prevX, &prevY, &prevZ, &colorR,
+                                      &colorG, &colorB, &transmittance, &distance, &stepScale}) {
+    buffer->resize(count);
+  }
+  rayIndex.resize(count);
+  live.assign(count, 0);
+  passCounts.clear();
+}
+
+void WavefrontTracer::setRay(size_t index, const Ray &ray, const ShadingParams &shading, TraceStats *stats) {
+  Ray start = ray;
+  Vector3 color;
+  double scale;
+  if (blackHole.prepareTrace(start, shading, color, scale, stats)) {
+    colors[index] = color;
+    live[index] = 0;
+    return;
+  }
+  if (start.origin.lengthSquared() < blackHole.rs * blackHole.rs) {
+    colors[index] = Vector3(0, 0, 0);
+    live[index] = 0;
+    return;
+  }
+
+  posX[index] = start.origin.x;
+  posY[index] = start.origin.y;
+  posZ[index] = start.origin.z;
+  velX[index] = start.direction.x;
+  velY[index] = start.direction.y;
+  velZ[index] = start.direction.z;
+  colorR[index] = 0.0;
+  colorG[index] = 0.0;
+  colorB[index] = 0.0;
+  transmittance[index] = 1.0;
+  distance[index] = 0.0;
+  stepScale[index] = scale;
+  rayIndex[index] = static_cast<uint32_t>(index);
+  live[index] = 1;
+}
+
+void WavefrontTracer::step(size_t begin, size_t end, double stepSize) {
+  stepRays(posX.data(), posY.data(), posZ.data(), velX.data(), velY.data(), velZ.data(), prevX.data(), prevY.data(),
+           prevZ.data(), distance.data(), stepScale.data(), begin, end, blackHole.rs, stepSize);
+}
+
+// Disk emission over each ray's last step, then the termination tests of traceRK4's loop head
+void WavefrontTracer::retire(size_t begin, size_t end, const ShadingParams &shading, double stepSize,
+                             double maxDist) {
+  const double rs2 = blackHole.rs * blackHole.rs;
+  const double exitRadius2 = blackHole.boundingRadius() * blackHole.boundingRadius();
+
+  for (size_t i = begin; i < end; i++) {
+    Vector3 pos(posX[i], posY[i], posZ[i]);
+    Vector3 vel(velX[i], velY[i], velZ[i]);
+    double T = transmittance[i];
+    Vector3 color = Vector3(colorR[i], colorG[i], colorB[i]) +
+                    blackHole.integrateDiskSegment(Vector3(prevX[i], prevY[i], prevZ[i]), pos, shading, stepSize, T);
+
+    double r2 = pos.lengthSquared();
+    bool escaped = false;
+    bool done = true;
+    if (!(distance[i] < maxDist && T > 0.01)) {
+      escaped = true;
+    } else if (r2 < rs2) {
+      escaped = false; // Black (absorbed)
+    } else if (blackHole.boundingSphere && r2 > exitRadius2 && pos.dot(vel) > 0.0) {
+      vel = blackHole.escapeDirection(pos, vel);
+      escaped = true;
+    } else {
+      done = false;
+    }
+
+    if (done) {
+      if (escaped) {
+        color += blackHole.sampleBackground(vel, shading.time) * T;
+      }
+      colors[rayIndex[i]] = color;
+      live[i] = 0;
+    } else {
+      colorR[i] = color.x;
+      colorG[i] = color.y;
+      colorB[i] = color.z;
+      transmittance[i] = T;
+    }
+  }
+}
+
+void WavefrontTracer::moveRay(size_t from, size_t to) {
+  posX[to] = posX[from];
+  posY[to] = posY[from];
+  posZ[to] = posZ[from];
+  velX[to] = velX[from];
+  velY[to] = velY[from];
+  velZ[to] = velZ[from];
+  colorR[to] = colorR[from];
+  colorG[to] = colorG[from];
+  colorB[to] = colorB[from];
+  transmittance[to] = transmittance[from];
+  distance[to] = distance[from];
+  stepScale[to] = stepScale[from];
+  rayIndex[to] = rayIndex[from];
+  live[to] = 1;
+}
+
+// Move the chunk's live rays to its front (order kept); returns how many there are
+size_t WavefrontTracer::compactChunk(size_t begin, size_t end) {
+  size_t write = begin;
+  for (size_t i = begin; i < end; i++) {
+    if (!live[i]) continue;
+    if (write != i) moveRay(i, write);
+    write++;
+  }
+  return write - begin;
+}
+
+void WavefrontTracer::run(ThreadPool &pool, const ShadingParams &shading, double stepSize, double maxDist,
+                          TraceStats *stats) {
+  passCounts.clear();
+  size_t active = rayCount;
+  bool first = true; // The first pass only drops the rays setRay() already finished
+  unsigned long long steps = 0;
+
+  while (active > 0) {
+    size_t chunks = (active + CHUNK_RAYS - 1) / CHUNK_RAYS;
+    chunkLive.assign(chunks, 0);
+    pool.parallelFor(chunks, [&](size_t chunk, unsigned) {
+      size_t begin = chunk * CHUNK_RAYS;
+      size_t end = std::min(begin + CHUNK_RAYS, active);
+      if (!first) {
+        step(begin, end, stepSize);
+        retire(begin, end, shading, stepSize, maxDist);
+      }
+      chunkLive[chunk] = compactChunk(begin, end);
+    });
+
+    // Close the gaps between chunks; each run moves left, never over unread rays
+    size_t write = chunkLive[0];
+    for (size_t chunk = 1; chunk < chunks; chunk++) {
+      size_t begin = chunk * CHUNK_RAYS;
+      for (size_t i = 0; i < chunkLive[chunk]; i++) {
+        if (write != begin + i) moveRay(begin + i, write);
+        write++;
+      }
+    }
+
+    if (!first) {
+      passCounts.push_back(active);
+      steps += active;
+    }
+    active = write;
+    first = false;
+  }
+
+  if (stats) {
+    stats->steps += steps;
+  }
+}
@@ -0,0 +1,1807 @@
+#include "../../include/rendering/CpuRTRenderer.h"
+#include "../../include/physics/BlackHole.hpp"
+#include "../../include/physics/DiskTexture.hpp"
+#include "../../include/physics/EmissionTable.hpp"
+#include "../../include/physics/OrbitTable.hpp"
+#include "../../include/physics/PacketTracer.hpp"
+#include "../../include/physics/SkyMap.hpp"
+#include "../../include/physics/WavefrontTracer.hpp"
+#include "../../include/utils/ThreadPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// External logging function from main.cpp
+extern void appLog(const std::string& message, bool isError = false);
+
+// Geodesic results for one pixel of the hit cache
+struct PixelHits {
+  uint32_t first; // Into the tile's hit list
+  uint32_t count;
+  float escapeDir[3];
+  uint32_t escaped;
+};
+
+// While the camera is still, ray paths do not change: the frame after the camera stops is
+// traced once with HitRecords, later frames only re-evaluate the recorded hits with the new
+// time, palette and intensity
+struct HitCache {
+  bool haveKey = false;
+  bool valid = false; // pixels / tileHits describe the frame keyed below
+  bool overBudget = false; // This view needs more than HIT_CACHE_MAX_BYTES: trace normally
+  CameraData camera;
+  int width = 0;
+  int height = 0;
+  CpuRenderOptions options; // Only the path-shaping fields are compared
+  std::vector<PixelHits> pixels;
+  std::vector<std::vector<DiskHit>> tileHits;
+};
+
+// Progressive refinement: every tile is first traced at a coarse pixel stride, then refined
+// by halving the stride while the frame budget lasts. The strides reached carry over to the
+// next frame while the camera, size and path options stay the same.
+struct Progressive {
+  bool haveKey = false;
+  CameraData camera;
+  int width = 0;
+  int height = 0;
+  int colorMode = 0;
+  float colorIntensity = 0.0f;
+  CpuRenderOptions options; // Only the path-shaping fields, tile size and Doppler are compared
+  std::vector<uint8_t> tileStride; // 0 = not traced yet, else the stride its pixels were traced at
+  size_t refreshCursor = 0;        // Next tile to re-trace once all tiles are at full resolution
+};
+
+// Temporal anti-aliasing: one jittered ray per pixel per frame, blended into an HDR history.
+// The camera is still, so only the disk pattern and the starfield move: sky pixels fetch the
+// history from where their star was last frame, disk pixels keep it in place but only for as
+// many frames as the spiral pattern stays put.
+struct TemporalHistory {
+  bool haveKey = false;
+  CameraData camera;
+  int width = 0;
+  int height = 0;
+  int colorMode = 0;
+  float colorIntensity = 0.0f;
+  CpuRenderOptions options; // Only the path-shaping fields and Doppler are compared
+  unsigned frame = 0;       // Frames blended since the reset (jitter sequence index)
+  double time = 0.0;        // Shading time of the history
+  std::vector<float> history; // HDR RGB
+  std::vector<float> blended; // Next history, written while `history` is read
+  std::vector<uint8_t> samples; // Frames blended into each history pixel
+  std::vector<uint8_t> blendedSamples;
+  std::vector<float> current; // This frame's HDR RGB
+  std::vector<float> longitude; // Sky direction seen by each pixel (rotates with time)
+  std::vector<float> latitude;
+  std::vector<uint8_t> kind;  // TemporalKind
+};
+
+// Checkerboard rendering: each frame traces the pixels with (x + y + parity) even and
+// fills the others from the previous frame, reprojected through the camera change
+struct Checkerboard {
+  bool haveFrame = false;
+  CameraData camera; // Of `previous`
+  int width = 0;
+  int height = 0;
+  int colorMode = 0;
+  float colorIntensity = 0.0f;
+  CpuRenderOptions options; // Only the path-shaping fields and Doppler are compared
+  unsigned parity = 0;
+  std::vector<uint8_t> previous; // Last output (BGRA)
+};
+
+// CPU implementation of the MetalRTRenderer C API.
+// Each frame is split into square tiles that a work-stealing pool traces with
+// BlackHole::trace (or the SIMD packet kernel, or orbit table lookups); the output matches the
+// ray_generation kernel (BGRA8).
+struct MetalRTRenderer {
+  BlackHole blackHole;
+  std::unique_ptr<PacketTracer> packetTracer;
+  std::unique_ptr<OrbitTable> orbitTable; // Loaded on first use
+  std::unique_ptr<WavefrontTracer> wavefront; // Created on first use
+  std::unique_ptr<DiskTexture> diskTexture;   // Baked on first use
+  std::unique_ptr<EmissionTable> emissionTable; // Built on first use
+  std::unique_ptr<ThreadPool> pool;
+  HitCache hitCache;
+  Progressive progressive;
+  TemporalHistory temporal;
+  Checkerboard checkerboard;
+  SkyMap skyMap;
+  CpuRenderOptions skyMapOptions; // Path-shaping options the sky map was built with
+  CpuRenderOptions options;
+  CpuRenderStats stats;
+  std::vector<uint8_t> pixelData;        // Main render loop buffer
+  std::vector<uint8_t> screenshotBuffer; // Separate buffer for screenshots
+  int width;
+  int height;
+  unsigned framesRendered = 0; // Paces the periodic stats log
+};
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+constexpr double STEP_SIZE = 0.1; // Must match STEP_SIZE in RayTracing.metal
+constexpr double MAX_DIST = 100.0;
+constexpr size_t HIT_CACHE_MAX_BYTES = size_t(256) << 20; // Disk hits kept for reshading
+constexpr int PROGRESSIVE_COARSE_STRIDE = 8; // First pass: one ray per 8x8 block
+constexpr double DISK_TEXTURE_TOLERANCE = 1e-3; // Largest density error the baked disk may add
+constexpr double EMISSION_TABLE_TOLERANCE = 1e-3; // Largest relative error the emission table may add
+constexpr unsigned LOG_INTERVAL = 60; // Frames between periodic stats lines
+
+// Temporal AA: blend weight floor 1/TEMPORAL_MAX_SAMPLES, and histories further than
+// TEMPORAL_MAX_SHIFT pixels away are dropped instead of fetched. Disk pixels average over at
+// most TEMPORAL_MAX_DISK_LAG radians of spiral phase.
+constexpr int TEMPORAL_MAX_SAMPLES = 16;
+constexpr double TEMPORAL_MAX_SHIFT = 4.0;
+constexpr double TEMPORAL_MAX_DISK_LAG = 0.1;
+constexpr double DISK_ROTATION_SPEED = 1.0; // Must match rotationSpeed in BlackHole::diskPattern
+constexpr double DISK_SPIRAL_ARMS = 3.0;    // Must match the spiral term in BlackHole::diskPattern
+constexpr double SKY_ROTATION_SPEED = 0.1;  // Must match the starfield drift in BlackHole::sampleBackground
+
+enum TemporalKind : uint8_t { TEMPORAL_HORIZON = 0, TEMPORAL_DISK = 1, TEMPORAL_SKY = 2 };
+
+// Checkerboard: above this camera translation per frame (as a fraction of its distance from
+// the hole) parallax makes the previous frame useless and missing pixels are interpolated
+constexpr double CHECKERBOARD_MAX_MOVE = 0.005;
+// Reprojected history is used in full up to this distance (pixels) from the old sample,
+// and faded out into the spatial estimate by the second
+constexpr double CHECKERBOARD_FADE_START = 0.25;
+constexpr double CHECKERBOARD_FADE_END = 0.75;
+
+// Adaptive subdivision: blocks up to ADAPTIVE_BLOCK pixels are interpolated from their
+// corners when all corners end the same way with close disk emission and transmittance,
+// and their escape directions spread at most ADAPTIVE_BEND_FACTOR times the primary rays'
+constexpr int ADAPTIVE_BLOCK = 8;
+constexpr double ADAPTIVE_COLOR_TOLERANCE = 0.01; // On Reinhard-mapped disk emission
+constexpr double ADAPTIVE_TRANSMITTANCE_TOLERANCE = 0.02;
+constexpr double ADAPTIVE_BEND_FACTOR = 2.0;
+
+int envInt(const char *name, int fallback) {
+  const char *value = std::getenv(name);
+  if (!value || value[0] == '\0') {
+    return fallback;
+  }
+  return std::atoi(value);
+}
+
+int envIntegrator(const char *name) {
+  const char *value = std::getenv(name);
+  if (value && std::strcmp(value, "binet") == 0) {
+    return static_cast<int>(Integrator::Binet);
+  }
+  if (value && std::strcmp(value, "rk45") == 0) {
+    return static_cast<int>(Integrator::DormandPrince);
+  }
+  return static_cast<int>(Integrator::RK4);
+}
+
+double envDouble(const char *name, double fallback) {
+  const char *value = std::getenv(name);
+  if (!value || value[0] == '\0') {
+    return fallback;
+  }
+  return std::atof(value);
+}
+
+// True once every LOG_INTERVAL frames, whichever render mode drew them
+bool periodicLogDue(MetalRTRenderer *renderer) {
+  return ++renderer->framesRendered % LOG_INTERVAL == 0;
+}
+
+const char *integratorName(Integrator integrator) {
+  switch (integrator) {
+    case Integrator::Binet:
+      return "Binet";
+    case Integrator::DormandPrince:
+      return "RK45";
+    case Integrator::RK4:
+    default:
+      return "RK4";
+  }
+}
+
+// Render strategies picked with BLACKHOLE_CPU_MODE; "trace" (or unset) traces every pixel
+void applyModeOption(CpuRenderOptions &options, const char *mode) {
+  if (!mode || mode[0] == '\0' || std::strcmp(mode, "trace") == 0) {
+    return;
+  }
+  if (std::strcmp(mode, "progressive") == 0) {
+    options.progressiveBudgetMs = std::max(envDouble("BLACKHOLE_CPU_PROGRESSIVE_MS", 12.0), 1.0);
+  } else if (std::strcmp(mode, "temporal") == 0) {
+    options.temporalAA = 1;
+  } else if (std::strcmp(mode, "checkerboard") == 0) {
+    options.checkerboard = 1;
+  } else if (std::strcmp(mode, "adaptive") == 0) {
+    options.adaptive = 1;
+  } else if (std::strcmp(mode, "wavefront") == 0) {
+    options.wavefront = 1;
+  } else if (std::strcmp(mode, "skymap") == 0) {
+    options.useSkyMap = 1;
+  } else if (std::strcmp(mode, "orbit-table") == 0) {
+    options.useOrbitTable = 1;
+  } else {
+    appLog(std::string("[CPU] Unknown BLACKHOLE_CPU_MODE '") + mode + "', tracing every pixel", true);
+  }
+}
+
+// The one place CpuRenderOptions get their defaults. Only the switches a user picks between
+// runs come from the environment (see the README); everything else is a tuning value that
+// cpu_rt_renderer_set_options can still change.
+CpuRenderOptions defaultOptions() {
+  CpuRenderOptions options{};
+  options.threadCount = std::max(0, envInt("BLACKHOLE_CPU_THREADS", 0));
+  options.tileSize = std::clamp(envInt("BLACKHOLE_CPU_TILE", 32), 4, 512);
+  options.useSimd = envInt("BLACKHOLE_CPU_SIMD", 1) != 0 ? 1 : 0;
+  options.simdIsa = static_cast<int>(PacketIsa::AVX512); // Widest the CPU supports
+  options.integrator = envIntegrator("BLACKHOLE_CPU_INTEGRATOR");
+  options.tolerance = 1e-6;
+  // Scalar-path shortcuts BlackHole leaves off; the packet kernel does not use them
+  options.boundingSphere = 1;
+  options.classifyRays = 1;
+  options.slabStepping = 1;
+  options.useHitCache = envInt("BLACKHOLE_CPU_HIT_CACHE", 1) != 0 ? 1 : 0;
+  options.skyMapSize = 512;
+  options.skyMapMove = 0.05;
+  options.diskTexture = 1;
+  options.emissionTable = 1;
+  options.doppler = 1;
+  options.specializedKernels = 1;
+  applyModeOption(options, std::getenv("BLACKHOLE_CPU_MODE"));
+  return options;
+}
+
+// Per-frame ray generation basis, precomputed from CameraData like the kernel does
+struct FrameSetup {
+  Vector3 origin;
+  Vector3 forward;
+  Vector3 right;
+  Vector3 up;
+  double aspectRatio;
+  double scale;
+  bool valid;
+};
+
+FrameSetup makeFrameSetup(const CameraData *camera, int width, int height) {
+  FrameSetup setup;
+  setup.origin = Vector3(camera->position[0], camera->position[1], camera->position[2]);
+  setup.forward = Vector3(camera->forward[0], camera->forward[1], camera->forward[2]);
+  setup.right = Vector3(camera->right[0], camera->right[1], camera->right[2]);
+  setup.up = Vector3(camera->up[0], camera->up[1], camera->up[2]);
+  setup.aspectRatio = static_cast<double>(width) / static_cast<double>(height);
+  setup.scale = std::tan(camera->fov * PI / 180.0 * 0.5);
+  // Invalid camera (all zeros) is reported in red, same as the shader
+  setup.valid = !(setup.origin.length() < 0.001 && setup.forward.length() < 0.001);
+  return setup;
+}
+
+// Ray through pixel (x, y), offset from its centre by (jitterX, jitterY) pixels
+Ray primaryRay(const FrameSetup &setup, int x, int y, int width, int height, double jitterX = 0.0,
+               double jitterY = 0.0) {
+  double px = (2.0 * (x + 0.5 + jitterX) / width - 1.0) * setup.aspectRatio * setup.scale;
+  double py = (1.0 - 2.0 * (y + 0.5 + jitterY) / height) * setup.scale;
+  return Ray(setup.origin, setup.forward + setup.right * px + setup.up * py);
+}
+
+// Fill a packet with up to `lanes` pixels of one row, `step` pixels apart
+void fillPacket(RayPacket &packet, const FrameSetup &setup, int x0, int count, int y,
+                int width, int height, int step = 1) {
+  packet.count = count;
+  for (int i = 0; i < count; i++) {
+    Ray ray = primaryRay(setup, x0 + i * step, y, width, height);
+    packet.originX[i] = static_cast<float>(ray.origin.x);
+    packet.originY[i] = static_cast<float>(ray.origin.y);
+    packet.originZ[i] = static_cast<float>(ray.origin.z);
+    packet.dirX[i] = static_cast<float>(ray.direction.x);
+    packet.dirY[i] = static_cast<float>(ray.direction.y);
+    packet.dirZ[i] = static_cast<float>(ray.direction.z);
+  }
+}
+
+// Reinhard tone mapping + gamma 2.2 to 8 bits, exactly as pow() would round it, from two
+// table loads. x = c / (c + 1) picks a bucket from its exponent and top 8 mantissa bits; a
+// bucket is narrow enough to hold at most one code step, so its lower code plus one compare
+// against that step's threshold is the answer.
+class ToneCurve {
+public:
+  ToneCurve() {
+    for (int k = 1; k < 256; k++) {
+      // Smallest x that rounds to code k
+      double lo = 0.0;
+      double hi = 1.0;
+      for (int i = 0; i < 128; i++) {
+        double mid = 0.5 * (lo + hi);
+        if (mid <= lo || mid >= hi)
+          break;
+        if (reference(mid) >= k)
+          hi = mid;
+        else
+          lo = mid;
+      }
+      threshold[k] = hi;
+    }
+    threshold[0] = 0.0;
+    threshold[256] = 2.0; // Unreachable: x < 1 here
+    for (int i = 0; i < BUCKETS; i++) {
+      uint64_t bits = static_cast<uint64_t>(i + ((1023 + MIN_EXPONENT) << MANTISSA_BITS)) << (52 - MANTISSA_BITS);
+      bucketCode[i] = reference(std::bit_cast<double>(bits));
+    }
+  }
+
+  uint8_t encode(double c) const {
+    double x = c / (c + 1.0);
+    if (!(x > 0.0))
+      return 0;
+    if (x >= 1.0)
+      return 255;
+    int64_t bucket = static_cast<int64_t>(std::bit_cast<uint64_t>(x) >> (52 - MANTISSA_BITS)) -
+                     (static_cast<int64_t>(1023 + MIN_EXPONENT) << MANTISSA_BITS);
+    uint8_t code = bucketCode[std::max<int64_t>(bucket, 0)]; // Below 2^MIN_EXPONENT everything is 0
+    return x >= threshold[code + 1] ? code + 1 : code;
+  }
+
+private:
+  static constexpr int MIN_EXPONENT = -24; // 2^-24 still encodes to 0
+  static constexpr int MANTISSA_BITS = 8;  // 256 buckets per octave: under half a code step each
+  static constexpr int BUCKETS = -MIN_EXPONENT << MANTISSA_BITS;
+
+  uint8_t bucketCode[BUCKETS];
+  double threshold[257];
+
+  static uint8_t reference(double x) {
+    double c = std::pow(std::max(x, 0.0), 1.0 / 2.2);
+    c = std::min(std::max(c, 0.0), 1.0);
+    return static_cast<uint8_t>(c * 255.0 + 0.5);
+  }
+};
+
+const ToneCurve TONE_CURVE;
+
+// Reinhard tone mapping + gamma, then write as BGRA (SDL_PIXELFORMAT_ARGB8888 on little-endian)
+void writeBGRA(Vector3 color, uint8_t *bgra) {
+  if (!std::isfinite(color.x) || !std::isfinite(color.y) || !std::isfinite(color.z)) {
+    color = Vector3(0.0, 1.0, 0.0); // Green for NaN/Inf
+  }
+
+  bgra[0] = TONE_CURVE.encode(color.z);
+  bgra[1] = TONE_CURVE.encode(color.y);
+  bgra[2] = TONE_CURVE.encode(color.x);
+  bgra[3] = 255;
+}
+
+// One tile of adaptive subdivision. Traced pixels keep their outcome split into disk
+// emission, transmittance and escape direction; interpolated pixels blend those and look up
+// the starfield along the blended direction, so stars inside smooth blocks survive.
+class AdaptiveTile {
+public:
+  AdaptiveTile(const BlackHole &blackHole, const FrameSetup &setup, const ShadingParams &shading, int x0,
+               int y0, int x1, int y1, int width, int height, uint8_t *output, TraceStats &stats)
+      : blackHole(blackHole), setup(setup), shading(shading), x0(x0), y0(y0), x1(x1), y1(y1), width(width),
+        height(height), output(output), stats(stats),
+        samples(static_cast<size_t>(x1 - x0) * (y1 - y0)), state(samples.size(), EMPTY) {
+    record.keepHits = false;
+  }
+
+  // Returns the number of rays actually traced
+  unsigned long long render() {
+    for (int ay = y0;; ay += ADAPTIVE_BLOCK) {
+      int by = std::min(ay + ADAPTIVE_BLOCK, y1 - 1);
+      for (int ax = x0;; ax += ADAPTIVE_BLOCK) {
+        int bx = std::min(ax + ADAPTIVE_BLOCK, x1 - 1);
+        refine(ax, ay, bx, by);
+        if (bx == x1 - 1) break;
+      }
+      if (by == y1 - 1) break;
+    }
+    return traced;
+  }
+
+private:
+  struct Sample {
+    Vector3 primaryDir;
+    Vector3 disk; // Emission gathered along the path
+    Vector3 escapeDir;
+    double transmittance;
+    bool escaped;
+  };
+  enum : uint8_t { EMPTY = 0, INTERPOLATED = 1, TRACED = 2 };
+
+  const BlackHole &blackHole;
+  const FrameSetup &setup;
+  const ShadingParams &shading;
+  int x0, y0, x1, y1;
+  int width, height;
+  uint8_t *output;
+  TraceStats &stats;
+  std::vector<Sample> samples;
+  std::vector<uint8_t> state;
+  HitRecord record;
+  unsigned long long traced = 0;
+
+  uint8_t *pixel(int x, int y) { return output + (static_cast<size_t>(y) * width + x) * 4; }
+
+  const Sample &traceAt(int x, int y) {
+    size_t index = static_cast<size_t>(y - y0) * (x1 - x0) + (x - x0);
+    Sample &sample = samples[index];
+    if (state[index] == TRACED) return sample;
+
+    Ray ray = primaryRay(setup, x, y, width, height);
+    Vector3 color = blackHole.trace(ray, shading, STEP_SIZE, MAX_DIST, &stats, &record);
+    sample.primaryDir = ray.direction;
+    sample.escaped = record.escaped;
+    sample.escapeDir = record.escapeDir;
+    sample.transmittance = record.escaped ? record.transmittance : 0.0;
+    sample.disk = color;
+    if (record.escaped) {
+      sample.disk -= blackHole.sampleBackground(record.escapeDir, shading.time) * record.transmittance;
+    }
+    writeBGRA(color, pixel(x, y));
+    state[index] = TRACED;
+    traced++;
+    return sample;
+  }
+
+  static bool similar(const Sample &a, const Sample &b) {
+    if (a.escaped != b.escaped) return false;
+    auto mapped = [](double c) { return c / (1.0 + std::max(c, 0.0)); };
+    if (std::abs(mapped(a.disk.x) - mapped(b.disk.x)) > ADAPTIVE_COLOR_TOLERANCE ||
+        std::abs(mapped(a.disk.y) - mapped(b.disk.y)) > ADAPTIVE_COLOR_TOLERANCE ||
+        std::abs(mapped(a.disk.z) - mapped(b.disk.z)) > ADAPTIVE_COLOR_TOLERANCE) {
+      return false;
+    }
+    if (std::abs(a.transmittance - b.transmittance) > ADAPTIVE_TRANSMITTANCE_TOLERANCE) return false;
+    if (!a.escaped) return true;
+
+    // Lensing magnifies strongly near the shadow edge and the photon ring
+    double spread = std::acos(std::clamp(a.primaryDir.dot(b.primaryDir), -1.0, 1.0));
+    return a.escapeDir.dot(b.escapeDir) >= std::cos(ADAPTIVE_BEND_FACTOR * spread);
+  }
+
+  void refine(int ax, int ay, int bx, int by) {
+    const Sample &c00 = traceAt(ax, ay);
+    const Sample &c10 = traceAt(bx, ay);
+    const Sample &c01 = traceAt(ax, by);
+    const Sample &c11 = traceAt(bx, by);
+    if (bx - ax <= 1 && by - ay <= 1) return; // Every pixel is a corner
+
+    if (similar(c00, c10) && similar(c00, c01) && similar(c00, c11) && similar(c10, c01) &&
+        similar(c10, c11) && similar(c01, c11)) {
+      interpolate(ax, ay, bx, by);
+      return;
+    }
+
+    int mx = (ax + bx) / 2;
+    int my = (ay + by) / 2;
+    if (bx - ax <= 1) {
+      refine(ax, ay, bx, my);
+      refine(ax, my, bx, by);
+    } else if (by - ay <= 1) {
+      refine(ax, ay, mx, by);
+      refine(mx, ay, bx, by);
+    } else {
+      refine(ax, ay, mx, my);
+      refine(mx, ay, bx, my);
+      refine(ax, my, mx, by);
+      refine(mx, my, bx, by);
+    }
+  }
+
+  void interpolate(int ax, int ay, int bx, int by) {
+    const Sample &c00 = traceAt(ax, ay);
+    const Sample &c10 = traceAt(bx, ay);
+    const Sample &c01 = traceAt(ax, by);
+    const Sample &c11 = traceAt(bx, by);
+    for (int y = ay; y <= by; y++) {
+      double fy = by > ay ? static_cast<double>(y - ay) / (by - ay) : 0.0;
+      for (int x = ax; x <= bx; x++) {
+        size_t index = static_cast<size_t>(y - y0) * (x1 - x0) + (x - x0);
+        if (state[index] == TRACED) continue; // Exact result from a finer neighbour block
+
+        double fx = bx > ax ? static_cast<double>(x - ax) / (bx - ax) : 0.0;
+        double w00 = (1.0 - fx) * (1.0 - fy);
+        double w10 = fx * (1.0 - fy);
+        double w01 = (1.0 - fx) * fy;
+        double w11 = fx * fy;
+        Vector3 color = c00.disk * w00 + c10.disk * w10 + c01.disk * w01 + c11.disk * w11;
+        if (c00.escaped) {
+          Vector3 escapeDir = c00.escapeDir * w00 + c10.escapeDir * w10 + c01.escapeDir * w01 + c11.escapeDir * w11;
+          double transmittance = c00.transmittance * w00 + c10.transmittance * w10 + c01.transmittance * w01 +
+                                 c11.transmittance * w11;
+          color += blackHole.sampleBackground(escapeDir.normalized(), shading.time) * transmittance;
+        }
+        writeBGRA(color, pixel(x, y));
+        state[index] = INTERPOLATED;
+      }
+    }
+  }
+};
+
+void applyPacketOptions(MetalRTRenderer *renderer) {
+  if (!renderer->packetTracer) {
+    renderer->packetTracer = std::make_unique<PacketTracer>(renderer->blackHole);
+  }
+  renderer->packetTracer->setIsa(static_cast<PacketIsa>(std::clamp(renderer->options.simdIsa, 0, 3)));
+}
+
+// The table is only built, mapped or written to its cache once it is enabled
+void applyOrbitTableOptions(MetalRTRenderer *renderer) {
+  if (!renderer->options.useOrbitTable || renderer->orbitTable) {
+    return;
+  }
+  renderer->orbitTable = std::make_unique<OrbitTable>();
+  if (!renderer->orbitTable->loadOrBuild(renderer->blackHole, OrbitTable::defaultCachePath())) {
+    appLog("[CPU] Orbit table unavailable, tracing every ray", true);
+    renderer->orbitTable.reset();
+    renderer->options.useOrbitTable = 0;
+  }
+}
+
+void applyDiskTextureOptions(MetalRTRenderer *renderer) {
+  if (renderer->options.diskTexture && !renderer->diskTexture) {
+    auto bakeStart = std::chrono::high_resolution_clock::now();
+    renderer->diskTexture = std::make_unique<DiskTexture>(renderer->blackHole);
+    std::ostringstream logMsg;
+    logMsg << "[CPU] Disk texture baked: " << renderer->diskTexture->radialSize() << "x"
+           << renderer->diskTexture->angularSize() << ", " << renderer->diskTexture->levelCount() << " levels, "
+           << (renderer->diskTexture->bytes() >> 10) << " KB in "
+           << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - bakeStart).count()
+           << " ms, max error " << renderer->diskTexture->maxError();
+    appLog(logMsg.str());
+    if (renderer->diskTexture->maxError() > DISK_TEXTURE_TOLERANCE) {
+      appLog("[CPU] Disk texture outside tolerance, evaluating the disk pattern per step", true);
+      renderer->diskTexture.reset();
+      renderer->options.diskTexture = 0;
+    }
+  }
+  renderer->blackHole.diskTexture = renderer->options.diskTexture ? renderer->diskTexture.get() : nullptr;
+}
+
+void applyEmissionTableOptions(MetalRTRenderer *renderer) {
+  if (renderer->options.emissionTable && !renderer->emissionTable) {
+    renderer->emissionTable = std::make_unique<EmissionTable>(renderer->blackHole);
+    std::ostringstream logMsg;
+    logMsg << "[CPU] Emission table built: " << EmissionTable::MODES << " palettes, "
+           << (renderer->emissionTable->bytes() >> 10) << " KB, max relative error "
+           << renderer->emissionTable->maxError();
+    appLog(logMsg.str());
+    if (renderer->emissionTable->maxError() > EMISSION_TABLE_TOLERANCE) {
+      appLog("[CPU] Emission table outside tolerance, shading the disk per sample", true);
+      renderer->emissionTable.reset();
+      renderer->options.emissionTable = 0;
+    }
+  }
+  renderer->blackHole.emissionTable = renderer->options.emissionTable ? renderer->emissionTable.get() : nullptr;
+}
+
+// Integrator and path flags of the scalar tracer, from the options
+void applyTracerOptions(MetalRTRenderer *renderer) {
+  renderer->blackHole.integrator = static_cast<Integrator>(renderer->options.integrator);
+  renderer->blackHole.tolerance = renderer->options.tolerance;
+  renderer->blackHole.boundingSphere = renderer->options.boundingSphere != 0;
+  renderer->blackHole.classifyRays = renderer->options.classifyRays != 0;
+  renderer->blackHole.slabStepping = renderer->options.slabStepping != 0;
+  renderer->blackHole.specializedKernels = renderer->options.specializedKernels != 0;
+}
+
+// Times every integrator's specialized trace kernels against the generic ones on a fixed
+// view from the default orbit, with slab stepping on and off (BLACKHOLE_CPU_KERNEL_BENCHMARK=1,
+// once at startup). Single threaded, best of a few runs; both must also agree exactly.
+void benchmarkTraceKernels(MetalRTRenderer *renderer) {
+  constexpr int COLUMNS = 96;
+  constexpr int ROWS = 54;
+  constexpr int RUNS = 5;
+
+  FrameSetup setup;
+  setup.origin = Vector3(0.0, 3.0, -20.0);
+  setup.forward = (setup.origin * -1.0).normalized();
+  setup.right = setup.forward.cross(Vector3(0.0, 1.0, 0.0)).normalized();
+  setup.up = setup.right.cross(setup.forward);
+  setup.aspectRatio = static_cast<double>(COLUMNS) / ROWS;
+  setup.scale = std::tan(60.0 * PI / 180.0 * 0.5);
+  setup.valid = true;
+
+  ShadingParams shading;
+  shading.time = 1.0;
+  shading.colorMode = 1;
+  shading.doppler = renderer->options.doppler != 0;
+
+  BlackHole &blackHole = renderer->blackHole;
+  applyTracerOptions(renderer);
+  std::ostringstream logMsg;
+  logMsg << "[CPU] Trace kernel benchmark (" << COLUMNS << "x" << ROWS << " rays, Doppler "
+         << (shading.doppler ? "on" : "off") << ", generic / specialized):" << std::fixed << std::setprecision(1);
+  for (int slab = 1; slab >= 0; slab--) {
+    blackHole.slabStepping = slab != 0;
+    logMsg << (slab ? " slab stepping" : "; point sampling");
+    for (int kind = 0; kind < 3; kind++) {
+      blackHole.integrator = static_cast<Integrator>(kind);
+      double bestMs[2] = {0.0, 0.0};
+      Vector3 sums[2];
+      for (int specialized = 0; specialized < 2; specialized++) {
+        blackHole.specializedKernels = specialized != 0;
+        for (int run = 0; run < RUNS; run++) {
+          Vector3 sum(0, 0, 0);
+          auto start = std::chrono::high_resolution_clock::now();
+          for (int y = 0; y < ROWS; y++) {
+            for (int x = 0; x < COLUMNS; x++) {
+              sum += blackHole.trace(primaryRay(setup, x, y, COLUMNS, ROWS), shading, STEP_SIZE, MAX_DIST);
+            }
+          }
+          double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start)
+                          .count();
+          bestMs[specialized] = run == 0 ? ms : std::min(bestMs[specialized], ms);
+          sums[specialized] = sum;
+        }
+      }
+      logMsg << (kind ? ", " : " ") << integratorName(blackHole.integrator) << " " << bestMs[0] << " / "
+             << bestMs[1] << " ms";
+      if (sums[0].x != sums[1].x || sums[0].y != sums[1].y || sums[0].z != sums[1].z) {
+        logMsg << " [output differs]";
+      }
+    }
+  }
+  appLog(logMsg.str());
+  applyTracerOptions(renderer);
+}
+
+// True when both option sets bend and sample rays identically
+bool samePathOptions(const CpuRenderOptions &a, const CpuRenderOptions &b) {
+  return a.integrator == b.integrator && a.tolerance == b.tolerance && a.boundingSphere == b.boundingSphere &&
+         a.classifyRays == b.classifyRays && a.slabStepping == b.slabStepping;
+}
+
+// True when a frame would trace exactly the same paths as the cached one
+bool sameHitCacheKey(const HitCache &cache, const CameraData *camera, int width, int height,
+                     const CpuRenderOptions &options) {
+  return cache.haveKey && std::memcmp(&cache.camera, camera, sizeof(CameraData)) == 0 &&
+         cache.width == width && cache.height == height && cache.options.tileSize == options.tileSize &&
+         samePathOptions(cache.options, options);
+}
+
+void ensurePool(MetalRTRenderer *renderer) {
+  unsigned wanted = static_cast<unsigned>(renderer->options.threadCount);
+  if (wanted == 0) {
+    wanted = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (!renderer->pool || renderer->pool->size() != wanted) {
+    renderer->pool = std::make_unique<ThreadPool>(wanted);
+  }
+}
+
+// Trace the tile's pixels on a `stride` grid, skipping those already traced on the
+// `previousStride` grid (0 = none), and fill each one's stride x stride block
+unsigned long long traceTileAtStride(const BlackHole &blackHole, const FrameSetup &setup, const ShadingParams &shading,
+                                     uint8_t *output, int width, int height, int x0, int y0, int x1, int y1,
+                                     int stride, int previousStride, TraceStats &stats) {
+  unsigned long long rays = 0;
+  for (int y = y0; y < y1; y += stride) {
+    for (int x = x0; x < x1; x += stride) {
+      if (previousStride > 0 && (x - x0) % previousStride == 0 && (y - y0) % previousStride == 0) continue;
+
+      uint8_t bgra[4];
+      writeBGRA(blackHole.trace(primaryRay(setup, x, y, width, height), shading, STEP_SIZE, MAX_DIST, &stats), bgra);
+      rays++;
+      for (int by = y; by < std::min(y + stride, y1); by++) {
+        uint8_t *pixel = output + (static_cast<size_t>(by) * width + x) * 4;
+        for (int bx = x; bx < std::min(x + stride, x1); bx++, pixel += 4) {
+          std::memcpy(pixel, bgra, 4);
+        }
+      }
+    }
+  }
+  return rays;
+}
+
+// Coarse pass for tiles not on screen yet, then stride halving for the coarsest tiles while
+// the budget lasts; once everything is at full resolution, tiles are re-traced round-robin
+// so the animation keeps moving
+void renderProgressive(MetalRTRenderer *renderer, const CameraData *camera, const FrameSetup &setup,
+                       const ShadingParams &shading, uint8_t *output,
+                       std::chrono::high_resolution_clock::time_point frameStart) {
+  const int width = renderer->width;
+  const int height = renderer->height;
+  const int tileSize = renderer->options.tileSize;
+  const int tilesX = (width + tileSize - 1) / tileSize;
+  const size_t tileCount = static_cast<size_t>(tilesX) * ((height + tileSize - 1) / tileSize);
+  const auto deadline =
+      frameStart + std::chrono::duration_cast<std::chrono::high_resolution_clock::duration>(
+                       std::chrono::duration<double, std::milli>(renderer->options.progressiveBudgetMs));
+
+  Progressive &state = renderer->progressive;
+  if (!state.haveKey || std::memcmp(&state.camera, camera, sizeof(CameraData)) != 0 || state.width != width ||
+      state.height != height || state.colorMode != shading.colorMode ||
+      state.colorIntensity != static_cast<float>(shading.colorIntensity) ||
+      state.options.tileSize != tileSize || state.options.doppler != renderer->options.doppler ||
+      !samePathOptions(state.options, renderer->options)) {
+    state.haveKey = true;
+    state.camera = *camera;
+    state.width = width;
+    state.height = height;
+    state.colorMode = shading.colorMode;
+    state.colorIntensity = static_cast<float>(shading.colorIntensity);
+    state.options = renderer->options;
+    state.tileStride.assign(tileCount, 0);
+    state.refreshCursor = 0;
+  }
+
+  std::atomic<unsigned long long> rays(0);
+  std::atomic<unsigned long long> steps(0);
+  std::atomic<unsigned long long> captured(0);
+  std::atomic<unsigned long long> nearCritical(0);
+
+  // Trace `tiles` one level finer (or again at full resolution); with a deadline, tiles not
+  // started in time keep their stride
+  std::vector<size_t> tiles;
+  auto refine = [&](bool checkDeadline) {
+    renderer->pool->parallelFor(tiles.size(), [&](size_t index, unsigned) {
+      if (checkDeadline && std::chrono::high_resolution_clock::now() >= deadline) return;
+      size_t tileIndex = tiles[index];
+      int x0 = static_cast<int>(tileIndex % tilesX) * tileSize;
+      int y0 = static_cast<int>(tileIndex / tilesX) * tileSize;
+      int previous = state.tileStride[tileIndex];
+      int stride = previous == 0 ? PROGRESSIVE_COARSE_STRIDE : std::max(previous / 2, 1);
+      TraceStats traceStats;
+      rays.fetch_add(traceTileAtStride(renderer->blackHole, setup, shading, output, width, height, x0, y0,
+                                       std::min(x0 + tileSize, width), std::min(y0 + tileSize, height), stride,
+                                       previous == stride ? 0 : previous, traceStats),
+                     std::memory_order_relaxed);
+      steps.fetch_add(traceStats.steps, std::memory_order_relaxed);
+      captured.fetch_add(traceStats.capturedRays, std::memory_order_relaxed);
+      nearCritical.fetch_add(traceStats.nearCriticalRays, std::memory_order_relaxed);
+      state.tileStride[tileIndex] = static_cast<uint8_t>(stride);
+    });
+  };
+
+  // Something must be on screen: the coarse pass ignores the budget
+  for (size_t i = 0; i < tileCount; i++) {
+    if (state.tileStride[i] == 0) tiles.push_back(i);
+  }
+  if (!tiles.empty()) refine(false);
+
+  int coarsest = *std::max_element(state.tileStride.begin(), state.tileStride.end());
+  while (coarsest > 1 && std::chrono::high_resolution_clock::now() < deadline) {
+    tiles.clear();
+    for (size_t i = 0; i < tileCount; i++) {
+      if (state.tileStride[i] == coarsest) tiles.push_back(i);
+    }
+    refine(true);
+    coarsest = *std::max_element(state.tileStride.begin(), state.tileStride.end());
+  }
+
+  if (coarsest == 1 && std::chrono::high_resolution_clock::now() < deadline) {
+    // Converged: refresh from the cursor in tile order; tiles skipped past the first one the
+    // deadline stopped are simply refreshed again next time
+    std::vector<uint8_t> refreshed(tileCount, 0);
+    tiles.clear();
+    for (size_t i = 0; i < tileCount; i++) {
+      tiles.push_back((state.refreshCursor + i) % tileCount);
+    }
+    renderer->pool->parallelFor(tiles.size(), [&](size_t index, unsigned) {
+      if (std::chrono::high_resolution_clock::now() >= deadline) return;
+      size_t tileIndex = tiles[index];
+      int x0 = static_cast<int>(tileIndex % tilesX) * tileSize;
+      int y0 = static_cast<int>(tileIndex / tilesX) * tileSize;
+      TraceStats traceStats;
+      rays.fetch_add(traceTileAtStride(renderer->blackHole, setup, shading, output, width, height, x0, y0,
+                                       std::min(x0 + tileSize, width), std::min(y0 + tileSize, height), 1, 0,
+                                       traceStats),
+                     std::memory_order_relaxed);
+      steps.fetch_add(traceStats.steps, std::memory_order_relaxed);
+      captured.fetch_add(traceStats.capturedRays, std::memory_order_relaxed);
+      nearCritical.fetch_add(traceStats.nearCriticalRays, std::memory_order_relaxed);
+      refreshed[index] = 1;
+    });
+    size_t advanced = 0;
+    while (advanced < tileCount && refreshed[advanced]) advanced++;
+    state.refreshCursor = (state.refreshCursor + advanced) % tileCount;
+  }
+
+  size_t converged = std::count(state.tileStride.begin(), state.tileStride.end(), 1);
+  CpuRenderStats &stats = renderer->stats;
+  stats = CpuRenderStats{};
+  stats.frameMs =
+      std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+  stats.raysTraced = rays.load();
+  stats.stepsPerRay = stats.raysTraced > 0 ? static_cast<double>(steps.load()) / stats.raysTraced : 0.0;
+  stats.capturedRays = captured.load();
+  stats.nearCriticalRays = nearCritical.load();
+  stats.threadCount = static_cast<int>(renderer->pool->size());
+  stats.tileCount = static_cast<int>(tileCount);
+  stats.simdLanes = 1;
+  stats.kernelName = integratorName(renderer->blackHole.integrator);
+  stats.progressiveStride = coarsest;
+  stats.progressiveConverged = 100.0 * converged / tileCount;
+
+  if (periodicLogDue(renderer)) {
+    std::ostringstream logMsg;
+    logMsg << "[CPU] Progressive " << width << "x" << height << " in " << stats.frameMs << " ms (budget "
+           << renderer->options.progressiveBudgetMs << " ms, " << stats.raysTraced << " rays), coarsest stride "
+           << stats.progressiveStride << ", " << stats.progressiveConverged << "% of tiles converged";
+    appLog(logMsg.str());
+  }
+}
+
+// Radical inverse of i in `base`: a low-discrepancy sequence in [0, 1) for the pixel jitter
+double halton(unsigned i, unsigned base) {
+  double f = 1.0;
+  double result = 0.0;
+  while (i > 0) {
+    f /= base;
+    result += f * (i % base);
+    i /= base;
+  }
+  return result;
+}
+
+// Trace one jittered ray per pixel, reproject the history along the starfield rotation since
+// its time and blend the new samples in
+void renderTemporal(MetalRTRenderer *renderer, const CameraData *camera, const FrameSetup &setup,
+                    const ShadingParams &shading, uint8_t *output,
+                    std::chrono::high_resolution_clock::time_point frameStart) {
+  const int width = renderer->width;
+  const int height = renderer->height;
+  const int tileSize = renderer->options.tileSize;
+  const int tilesX = (width + tileSize - 1) / tileSize;
+  const int tilesY = (height + tileSize - 1) / tileSize;
+  const size_t pixelCount = static_cast<size_t>(width) * height;
+
+  TemporalHistory &state = renderer->temporal;
+  if (!state.haveKey || std::memcmp(&state.camera, camera, sizeof(CameraData)) != 0 || state.width != width ||
+      state.height != height || state.colorMode != shading.colorMode ||
+      state.colorIntensity != static_cast<float>(shading.colorIntensity) ||
+      state.options.doppler != renderer->options.doppler || !samePathOptions(state.options, renderer->options)) {
+    state.haveKey = true;
+    state.camera = *camera;
+    state.width = width;
+    state.height = height;
+    state.colorMode = shading.colorMode;
+    state.colorIntensity = static_cast<float>(shading.colorIntensity);
+    state.options = renderer->options;
+    state.frame = 0;
+    state.history.assign(pixelCount * 3, 0.0f);
+    state.blended.resize(pixelCount * 3);
+    state.samples.assign(pixelCount, 0);
+    state.blendedSamples.resize(pixelCount);
+    state.current.resize(pixelCount * 3);
+    state.longitude.resize(pixelCount);
+    state.latitude.resize(pixelCount);
+    state.kind.resize(pixelCount);
+  }
+
+  // The first frame after a reset samples pixel centres, later ones walk a Halton (2, 3) pattern
+  const double jitterX = state.frame == 0 ? 0.0 : halton(state.frame, 2) - 0.5;
+  const double jitterY = state.frame == 0 ? 0.0 : halton(state.frame, 3) - 0.5;
+
+  std::atomic<unsigned long long> steps(0);
+  std::atomic<unsigned long long> captured(0);
+  std::atomic<unsigned long long> nearCritical(0);
+  renderer->pool->parallelFor(static_cast<size_t>(tilesX) * tilesY, [&](size_t tileIndex, unsigned) {
+    int x0 = static_cast<int>(tileIndex % tilesX) * tileSize;
+    int y0 = static_cast<int>(tileIndex / tilesX) * tileSize;
+    int x1 = std::min(x0 + tileSize, width);
+    int y1 = std::min(y0 + tileSize, height);
+    TraceStats traceStats;
+    HitRecord record;
+    record.keepHits = false;
+    for (int y = y0; y < y1; y++) {
+      for (int x = x0; x < x1; x++) {
+        Vector3 color = renderer->blackHole.trace(primaryRay(setup, x, y, width, height, jitterX, jitterY), shading,
+                                                  STEP_SIZE, MAX_DIST, &traceStats, &record);
+        size_t i = static_cast<size_t>(y) * width + x;
+        state.current[i * 3] = static_cast<float>(color.x);
+        state.current[i * 3 + 1] = static_cast<float>(color.y);
+        state.current[i * 3 + 2] = static_cast<float>(color.z);
+
+        // Any disk emission (the horizon itself is black) outweighs the faint starfield
+        if (record.escaped ? record.transmittance < 1.0 : color.lengthSquared() > 0.0) {
+          state.kind[i] = TEMPORAL_DISK;
+        } else if (record.escaped) {
+          state.kind[i] = TEMPORAL_SKY;
+          state.longitude[i] = static_cast<float>(std::atan2(record.escapeDir.z, record.escapeDir.x));
+          state.latitude[i] = static_cast<float>(std::asin(std::clamp(record.escapeDir.y, -1.0, 1.0)));
+        } else {
+          state.kind[i] = TEMPORAL_HORIZON;
+        }
+      }
+    }
+    steps.fetch_add(traceStats.steps, std::memory_order_relaxed);
+    captured.fetch_add(traceStats.capturedRays, std::memory_order_relaxed);
+    nearCritical.fetch_add(traceStats.nearCriticalRays, std::memory_order_relaxed);
+  });
+
+  // A star seen at longitude l now was at l + speed * dt when the history was shaded: find where
+  // that is on screen from the local Jacobian of (longitude, latitude) and fetch the history
+  // there. The disk's spiral turns over its static rings, envelope and Doppler shading, so no
+  // single screen motion fits it; its history stays in place and is shortened instead.
+  const double dt = state.frame == 0 ? 0.0 : shading.time - state.time;
+  const double diskPhaseStep = std::abs(DISK_SPIRAL_ARMS * DISK_ROTATION_SPEED * dt);
+  const int diskMaxSamples =
+      diskPhaseStep * TEMPORAL_MAX_SAMPLES > TEMPORAL_MAX_DISK_LAG
+          ? std::max(1, static_cast<int>(TEMPORAL_MAX_DISK_LAG / diskPhaseStep))
+          : TEMPORAL_MAX_SAMPLES;
+  renderer->pool->parallelFor(static_cast<size_t>(height), [&](size_t row, unsigned) {
+    const int y = static_cast<int>(row);
+    for (int x = 0; x < width; x++) {
+      size_t i = static_cast<size_t>(y) * width + x;
+      const uint8_t kind = state.kind[i];
+      float *out = &state.blended[i * 3];
+      const float *cur = &state.current[i * 3];
+
+      // Derivative of (longitude, latitude) along one axis from sky neighbours
+      auto derivative = [&](int dx, int dy, double &dLongitude, double &dLatitude) {
+        int count = 0;
+        dLongitude = 0.0;
+        dLatitude = 0.0;
+        for (int side = -1; side <= 1; side += 2) {
+          int nx = x + side * dx;
+          int ny = y + side * dy;
+          if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+          size_t n = static_cast<size_t>(ny) * width + nx;
+          if (state.kind[n] != TEMPORAL_SKY) continue;
+          dLongitude +=
+              side * std::remainder(static_cast<double>(state.longitude[n]) - state.longitude[i], 2.0 * PI);
+          dLatitude += side * (static_cast<double>(state.latitude[n]) - state.latitude[i]);
+          count++;
+        }
+        if (count == 0) return false;
+        dLongitude /= count;
+        dLatitude /= count;
+        return true;
+      };
+
+      bool fetched = false;
+      float previous[3] = {0.0f, 0.0f, 0.0f};
+      int previousSamples = 0;
+      if (state.frame > 0) {
+        double shiftX = 0.0;
+        double shiftY = 0.0;
+        bool aligned = true;
+        if (kind == TEMPORAL_SKY && dt != 0.0) {
+          double turn = SKY_ROTATION_SPEED * dt;
+          double ax, rx, ay, ry;
+          aligned = derivative(1, 0, ax, rx) && derivative(0, 1, ay, ry);
+          double det = ax * ry - ay * rx;
+          aligned = aligned && std::abs(det) > 1e-12;
+          if (aligned) {
+            shiftX = turn * ry / det;
+            shiftY = -turn * rx / det;
+            aligned = shiftX * shiftX + shiftY * shiftY <= TEMPORAL_MAX_SHIFT * TEMPORAL_MAX_SHIFT;
+          }
+        }
+
+        if (aligned) {
+          // Bilinear fetch over the taps that saw the same kind of surface
+          double fx = x + shiftX;
+          double fy = y + shiftY;
+          int bx = static_cast<int>(std::floor(fx));
+          int by = static_cast<int>(std::floor(fy));
+          double tx = fx - bx;
+          double ty = fy - by;
+          double weightSum = 0.0;
+          double sum[3] = {0.0, 0.0, 0.0};
+          for (int k = 0; k < 4; k++) {
+            int sx = bx + (k & 1);
+            int sy = by + (k >> 1);
+            if (sx < 0 || sy < 0 || sx >= width || sy >= height) continue;
+            size_t s = static_cast<size_t>(sy) * width + sx;
+            if (state.kind[s] != kind || state.samples[s] == 0) continue;
+            double w = ((k & 1) ? tx : 1.0 - tx) * ((k >> 1) ? ty : 1.0 - ty);
+            if (w <= 0.0) continue;
+            sum[0] += state.history[s * 3] * w;
+            sum[1] += state.history[s * 3 + 1] * w;
+            sum[2] += state.history[s * 3 + 2] * w;
+            weightSum += w;
+            previousSamples = std::max<int>(previousSamples, state.samples[s]);
+          }
+          if (weightSum > 0.25) {
+            for (int c = 0; c < 3; c++) previous[c] = static_cast<float>(sum[c] / weightSum);
+            fetched = true;
+          }
+        }
+      }
+
+      if (fetched) {
+        // Clamp the history to this frame's 3x3 neighbourhood so reprojection misses and
+        // resampling blur cannot leave trails or haze behind
+        float low[3] = {cur[0], cur[1], cur[2]};
+        float high[3] = {cur[0], cur[1], cur[2]};
+        for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, height - 1); ny++) {
+          for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, width - 1); nx++) {
+            const float *n = &state.current[(static_cast<size_t>(ny) * width + nx) * 3];
+            for (int c = 0; c < 3; c++) {
+              low[c] = std::min(low[c], n[c]);
+              high[c] = std::max(high[c], n[c]);
+            }
+          }
+        }
+        for (int c = 0; c < 3; c++) previous[c] = std::clamp(previous[c], low[c], high[c]);
+
+        int maxSamples = kind == TEMPORAL_DISK ? diskMaxSamples : TEMPORAL_MAX_SAMPLES;
+        int samples = std::min(previousSamples + 1, maxSamples);
+        float alpha = 1.0f / samples;
+        for (int c = 0; c < 3; c++) out[c] = previous[c] + (cur[c] - previous[c]) * alpha;
+        state.blendedSamples[i] = static_cast<uint8_t>(samples);
+      } else {
+        for (int c = 0; c < 3; c++) out[c] = cur[c];
+        state.blendedSamples[i] = 1;
+      }
+      writeBGRA(Vector3(out[0], out[1], out[2]), output + i * 4);
+    }
+  });
+  state.history.swap(state.blended);
+  state.samples.swap(state.blendedSamples);
+  state.time = shading.time;
+  state.frame++;
+
+  CpuRenderStats &stats = renderer->stats;
+  stats = CpuRenderStats{};
+  stats.frameMs =
+      std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+  stats.raysTraced = pixelCount;
+  stats.stepsPerRay = static_cast<double>(steps.load()) / pixelCount;
+  stats.capturedRays = captured.load();
+  stats.nearCriticalRays = nearCritical.load();
+  stats.threadCount = static_cast<int>(renderer->pool->size());
+  stats.tileCount = tilesX * tilesY;
+  stats.simdLanes = 1;
+  stats.kernelName = integratorName(renderer->blackHole.integrator);
+  stats.temporalSamples = static_cast<int>(std::min<unsigned>(state.frame, 1u << 30));
+
+  if (periodicLogDue(renderer)) {
+    std::ostringstream logMsg;
+    logMsg << "[CPU] Temporal AA " << width << "x" << height << " in " << stats.frameMs << " ms, "
+           << stats.temporalSamples << " jittered frames since the last reset";
+    appLog(logMsg.str());
+  }
+}
+
+// 8-bit luma, for picking the interpolation direction
+inline int lumaBGRA(const uint8_t *p) {
+  return (29 * p[0] + 150 * p[1] + 77 * p[2]) >> 8;
+}
+
+// Checkerboard rendering: trace the half of the pixels with (x + y + parity) even, then fill
+// each other pixel from its four traced neighbours, and replace that with the previous frame's
+// sample along the same ray (reprojected through the camera rotation, clamped to the neighbours)
+// where one lies close by. Without a usable previous frame (first frame, settings changed, or
+// the camera moved far enough for parallax to matter) the spatial estimate stands.
+void renderCheckerboard(MetalRTRenderer *renderer, const CameraData *camera, const FrameSetup &setup,
+                        const ShadingParams &shading, const PacketTracer *packetTracer, uint8_t *output,
+                        std::chrono::high_resolution_clock::time_point frameStart) {
+  const int width = renderer->width;
+  const int height = renderer->height;
+  const int tileSize = renderer->options.tileSize;
+  const int tilesX = (width + tileSize - 1) / tileSize;
+  const int tilesY = (height + tileSize - 1) / tileSize;
+  const int lanes = packetTracer ? packetTracer->width() : 1;
+
+  Checkerboard &state = renderer->checkerboard;
+  const FrameSetup previous = makeFrameSetup(&state.camera, width, height);
+  const bool reuse = state.haveFrame && state.width == width && state.height == height &&
+                     state.colorMode == shading.colorMode &&
+                     state.colorIntensity == static_cast<float>(shading.colorIntensity) &&
+                     state.options.doppler == renderer->options.doppler &&
+                     samePathOptions(state.options, renderer->options) &&
+                     (setup.origin - previous.origin).length() <= CHECKERBOARD_MAX_MOVE * setup.origin.length();
+  const bool sameCamera = reuse && std::memcmp(&state.camera, camera, sizeof(CameraData)) == 0;
+  const unsigned parity = state.parity;
+
+  std::atomic<unsigned long long> tracedRays(0);
+  std::atomic<unsigned long long> steps(0);
+  std::atomic<unsigned long long> captured(0);
+  std::atomic<unsigned long long> nearCritical(0);
+  renderer->pool->parallelFor(static_cast<size_t>(tilesX) * tilesY, [&](size_t tileIndex, unsigned) {
+    int x0 = static_cast<int>(tileIndex % tilesX) * tileSize;
+    int y0 = static_cast<int>(tileIndex / tilesX) * tileSize;
+    int x1 = std::min(x0 + tileSize, width);
+    int y1 = std::min(y0 + tileSize, height);
+    TraceStats traceStats;
+    unsigned long long traced = 0;
+    for (int y = y0; y < y1; y++) {
+      uint8_t *row = output + static_cast<size_t>(y) * width * 4;
+      const int first = x0 + ((x0 + y + parity) & 1);
+      if (packetTracer) {
+        // Every other pixel of the row: twice the spread of the full-frame packets, still coherent
+        RayPacket packet;
+        Vector3 colors[RayPacket::MAX_LANES];
+        for (int x = first; x < x1; x += 2 * lanes) {
+          int count = std::min(lanes, (x1 - x + 1) / 2);
+          fillPacket(packet, setup, x, count, y, width, height, 2);
+          packetTracer->trace(packet, shading, STEP_SIZE, MAX_DIST, colors);
+          for (int i = 0; i < count; i++) {
+            writeBGRA(colors[i], row + static_cast<size_t>(x + 2 * i) * 4);
+          }
+          traced += count;
+        }
+        continue;
+      }
+      for (int x = first; x < x1; x += 2) {
+        writeBGRA(renderer->blackHole.trace(primaryRay(setup, x, y, width, height), shading, STEP_SIZE, MAX_DIST,
+                                            &traceStats),
+                  row + static_cast<size_t>(x) * 4);
+        traced++;
+      }
+    }
+    tracedRays.fetch_add(traced, std::memory_order_relaxed);
+    steps.fetch_add(traceStats.steps, std::memory_order_relaxed);
+    captured.fetch_add(traceStats.capturedRays, std::memory_order_relaxed);
+    nearCritical.fetch_add(traceStats.nearCriticalRays, std::memory_order_relaxed);
+  });
+
+  // Fill the untraced pixels; every neighbour they read was traced above
+  const double previousScaleX = previous.aspectRatio * previous.scale;
+  renderer->pool->parallelFor(static_cast<size_t>(height), [&](size_t rowIndex, unsigned) {
+    const int y = static_cast<int>(rowIndex);
+    uint8_t *row = output + static_cast<size_t>(y) * width * 4;
+    for (int x = (y + parity + 1) & 1; x < width; x += 2) {
+      uint8_t *pixel = row + static_cast<size_t>(x) * 4;
+      const uint8_t *left = x > 0 ? pixel - 4 : nullptr;
+      const uint8_t *right = x + 1 < width ? pixel + 4 : nullptr;
+      const uint8_t *above = y > 0 ? pixel - static_cast<size_t>(width) * 4 : nullptr;
+      const uint8_t *below = y + 1 < height ? pixel + static_cast<size_t>(width) * 4 : nullptr;
+
+      // Spatial estimate: average the pair across the weaker gradient (a missing partner
+      // counts as the other one), which keeps edges from zippering
+      const uint8_t *a = left ? left : right;
+      const uint8_t *b = right ? right : left;
+      const uint8_t *c = above ? above : below;
+      const uint8_t *d = below ? below : above;
+      if (!a || (c && std::abs(lumaBGRA(c) - lumaBGRA(d)) < std::abs(lumaBGRA(a) - lumaBGRA(b)))) {
+        a = c;
+        b = d;
+      }
+      if (!a) {
+        continue; // 1x1 frame: the one pixel is traced on even frames
+      }
+      for (int k = 0; k < 3; k++) {
+        pixel[k] = static_cast<uint8_t>((a[k] + b[k] + 1) >> 1);
+      }
+      pixel[3] = 255;
+      if (!reuse) {
+        continue;
+      }
+
+      // Where this pixel's ray pointed in the previous view. Rotation only: the move is small
+      // enough that parallax stays under a pixel for everything but the nearest disk.
+      double sx = x;
+      double sy = y;
+      if (!sameCamera) {
+        Vector3 dir = primaryRay(setup, x, y, width, height).direction;
+        double depth = dir.dot(previous.forward);
+        if (depth <= 0.0) {
+          continue;
+        }
+        sx = (dir.dot(previous.right) / depth / previousScaleX + 1.0) * 0.5 * width - 0.5;
+        sy = (1.0 - dir.dot(previous.up) / depth / previous.scale) * 0.5 * height - 0.5;
+        if (!(sx >= 0.0 && sy >= 0.0 && sx <= width - 1 && sy <= height - 1)) {
+          continue;
+        }
+      }
+
+      // Nearest pixel the previous frame traced (its reconstructed half would only blur more
+      // every frame). An odd-pixel pan lines the old samples up with this frame's: they then
+      // sit a pixel away and add nothing, so the history fades out with the distance.
+      int nx = static_cast<int>(std::lround(sx));
+      int ny = static_cast<int>(std::lround(sy));
+      if (((nx + ny + parity) & 1) == 0) {
+        double dx = sx - nx;
+        double dy = sy - ny;
+        if (std::abs(dx) >= std::abs(dy) ? width > 1 : height == 1) {
+          nx += (dx >= 0.0 ? nx + 1 < width : nx == 0) ? 1 : -1;
+        } else {
+          ny += (dy >= 0.0 ? ny + 1 < height : ny == 0) ? 1 : -1;
+        }
+      }
+      double distance = std::hypot(sx - nx, sy - ny);
+      double weight = std::clamp((CHECKERBOARD_FADE_END - distance) / (CHECKERBOARD_FADE_END - CHECKERBOARD_FADE_START),
+                                 0.0, 1.0);
+      if (weight <= 0.0) {
+        continue;
+      }
+      const uint8_t *history = &state.previous[(static_cast<size_t>(ny) * width + nx) * 4];
+      for (int k = 0; k < 3; k++) {
+        // Disk animation and disocclusion: never leave the range of the traced neighbours
+        int low = 255;
+        int high = 0;
+        for (const uint8_t *n : {left, right, above, below}) {
+          if (n) {
+            low = std::min(low, static_cast<int>(n[k]));
+            high = std::max(high, static_cast<int>(n[k]));
+          }
+        }
+        int fetched = std::clamp(static_cast<int>(history[k]), low, high);
+        pixel[k] = static_cast<uint8_t>(pixel[k] + (fetched - pixel[k]) * weight + 0.5);
+      }
+    }
+  });
+
+  state.haveFrame = true;
+  state.camera = *camera;
+  state.width = width;
+  state.height = height;
+  state.colorMode = shading.colorMode;
+  state.colorIntensity = static_cast<float>(shading.colorIntensity);
+  state.options = renderer->options;
+  state.parity ^= 1u;
+  state.previous.assign(output, output + static_cast<size_t>(width) * height * 4);
+
+  CpuRenderStats &stats = renderer->stats;
+  stats = CpuRenderStats{};
+  stats.frameMs =
+      std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+  stats.raysTraced = tracedRays.load();
+  stats.stepsPerRay = packetTracer ? 0.0 : static_cast<double>(steps.load()) / std::max(stats.raysTraced, 1ull);
+  stats.capturedRays = captured.load();
+  stats.nearCriticalRays = nearCritical.load();
+  stats.threadCount = static_cast<int>(renderer->pool->size());
+  stats.tileCount = tilesX * tilesY;
+  stats.simdLanes = lanes;
+  stats.kernelName = packetTracer ? PacketTracer::isaName(packetTracer->isa())
+                                  : integratorName(renderer->blackHole.integrator);
+  stats.checkerboardFill = reuse ? 1 : 2;
+
+  if (periodicLogDue(renderer)) {
+    std::ostringstream logMsg;
+    logMsg << "[CPU] Checkerboard " << width << "x" << height << " in " << stats.frameMs << " ms, "
+           << stats.raysTraced << " rays traced, rest " << (reuse ? "from the previous frame" : "interpolated");
+    appLog(logMsg.str());
+  }
+}
+
+void renderFrame(MetalRTRenderer *renderer, const CameraData *camera, float time,
+                 int colorMode, float colorIntensity, uint8_t *output, bool interactive) {
+  auto frameStart = std::chrono::high_resolution_clock::now();
+
+  const int width = renderer->width;
+  const int height = renderer->height;
+  const int tileSize = renderer->options.tileSize;
+  const int tilesX = (width + tileSize - 1) / tileSize;
+  const int tilesY = (height + tileSize - 1) / tileSize;
+
+  FrameSetup setup = makeFrameSetup(camera, width, height);
+
+  ShadingParams shading;
+  shading.time = std::isfinite(time) ? time : 0.0;
+  shading.colorMode = colorMode;
+  shading.colorIntensity = colorIntensity;
+  shading.doppler = renderer->options.doppler != 0;
+
+  ensurePool(renderer);
+  std::atomic<unsigned long long> raysTraced(0);
+  std::atomic<unsigned long long> tableRays(0);
+  std::atomic<unsigned long long> tracedRays(0);
+  std::atomic<unsigned long long> tracedSteps(0);
+  std::atomic<unsigned long long> capturedRays(0);
+  std::atomic<unsigned long long> nearCriticalRays(0);
+
+  // The packet kernel implements RK4 only
+  applyTracerOptions(renderer);
+  const PacketTracer *packetTracer = renderer->options.useSimd && renderer->blackHole.integrator == Integrator::RK4
+                                         ? renderer->packetTracer.get()
+                                         : nullptr;
+  const int lanes = packetTracer ? packetTracer->width() : 1;
+  // Progressive, temporal and checkerboard frames build on earlier ones: live view only, never
+  // screenshots. A live frame without the mode drops its history; a screenshot leaves it alone,
+  // each mode's own key check catches any change it missed
+  if (interactive && renderer->options.progressiveBudgetMs > 0.0 && setup.valid) {
+    renderProgressive(renderer, camera, setup, shading, output, frameStart);
+    return;
+  }
+  if (interactive) {
+    renderer->progressive.haveKey = false;
+  }
+  if (interactive && renderer->options.temporalAA && setup.valid) {
+    renderTemporal(renderer, camera, setup, shading, output, frameStart);
+    return;
+  }
+  if (interactive) {
+    renderer->temporal.haveKey = false;
+  }
+  if (interactive && renderer->options.checkerboard && setup.valid) {
+    renderCheckerboard(renderer, camera, setup, shading, packetTracer, output, frameStart);
+    return;
+  }
+  if (interactive) {
+    renderer->checkerboard.haveFrame = false;
+  }
+
+  const OrbitTable *orbitTable = renderer->options.useOrbitTable ? renderer->orbitTable.get() : nullptr;
+  if (orbitTable && !orbitTable->covers(setup.origin)) {
+    orbitTable = nullptr; // Camera in the disk plane: every ray would fall back anyway
+  }
+
+  // Sky map: geodesics depend only on the camera position, so look-around and FOV changes
+  // resample the cubemap; it is re-traced once the camera has moved far enough
+  SkyMap *skyMap = renderer->options.useSkyMap && setup.valid ? &renderer->skyMap : nullptr;
+  bool skyMapRebuilt = false;
+  TraceStats skyMapStats;
+  if (skyMap) {
+    if (!skyMap->isReady() || skyMap->size() != renderer->options.skyMapSize ||
+        (skyMap->center() - setup.origin).length() > renderer->options.skyMapMove ||
+        !samePathOptions(renderer->skyMapOptions, renderer->options)) {
+      auto buildStart = std::chrono::high_resolution_clock::now();
+      skyMap->build(renderer->blackHole, setup.origin, renderer->options.skyMapSize, STEP_SIZE, MAX_DIST,
+                    *renderer->pool, &skyMapStats);
+      renderer->skyMapOptions = renderer->options;
+      skyMapRebuilt = true;
+
+      std::ostringstream logMsg;
+      logMsg << "[CPU] Sky map rebuilt: 6x" << skyMap->size() << "^2 texels, " << skyMap->hitCount()
+             << " disk hits in "
+             << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - buildStart)
+                    .count()
+             << " ms";
+      appLog(logMsg.str());
+    }
+    skyMap->beginFrame(shading);
+    packetTracer = nullptr;
+    orbitTable = nullptr;
+  }
+
+  // Adaptive subdivision needs each traced ray's outcome: scalar tracing only
+  const bool adaptive = renderer->options.adaptive && setup.valid && !skyMap;
+  // Wavefront: tiles only start the rays, then the frame's live rays are stepped together
+  const bool wavefront = renderer->options.wavefront && setup.valid && !skyMap && !adaptive &&
+                         renderer->blackHole.integrator == Integrator::RK4 && renderer->blackHole.slabStepping;
+  if (adaptive || wavefront) {
+    packetTracer = nullptr;
+    orbitTable = nullptr;
+  }
+
+  // Hit cache: record on the second frame at the same camera, reshade on every frame after
+  // that. The record comes from the kernel that drew the live frames (the packet kernel or
+  // per-pixel trace()), so recording costs about what a live frame does and reshading cannot
+  // pop to another kernel's image. Screenshots neither use nor reset the live view's cache.
+  HitCache &cache = renderer->hitCache;
+  bool reshading = false;
+  bool recording = false;
+  if (interactive) {
+    if (renderer->options.useHitCache && setup.valid && !skyMap && !orbitTable && !adaptive && !wavefront) {
+      if (sameHitCacheKey(cache, camera, width, height, renderer->options)) {
+        reshading = cache.valid;
+        recording = !cache.valid && !cache.overBudget;
+      } else {
+        cache.haveKey = true;
+        cache.valid = false;
+        cache.overBudget = false;
+        cache.camera = *camera;
+        cache.width = width;
+        cache.height = height;
+        cache.options = renderer->options;
+      }
+    } else {
+      cache.haveKey = false;
+      cache.valid = false;
+    }
+  }
+  if (recording) {
+    cache.pixels.resize(static_cast<size_t>(width) * height);
+    cache.tileHits.resize(static_cast<size_t>(tilesX) * tilesY);
+  }
+  if (wavefront) {
+    if (!renderer->wavefront) {
+      renderer->wavefront = std::make_unique<WavefrontTracer>(renderer->blackHole);
+    }
+    renderer->wavefront->reset(static_cast<size_t>(width) * height);
+  }
+
+  renderer->pool->parallelFor(
+      static_cast<size_t>(tilesX) * tilesY, [&](size_t tileIndex, unsigned) {
+        int x0 = static_cast<int>(tileIndex % tilesX) * tileSize;
+        int y0 = static_cast<int>(tileIndex / tilesX) * tileSize;
+        int x1 = std::min(x0 + tileSize, width);
+        int y1 = std::min(y0 + tileSize, height);
+        TraceStats traceStats;
+        unsigned long long scalarRays = 0;
+
+        if (skyMap) {
+          for (int y = y0; y < y1; y++) {
+            uint8_t *row = output + (static_cast<size_t>(y) * width) * 4;
+            for (int x = x0; x < x1; x++) {
+              writeBGRA(skyMap->sample(renderer->blackHole, primaryRay(setup, x, y, width, height).direction),
+                        row + static_cast<size_t>(x) * 4);
+            }
+          }
+          raysTraced.fetch_add(static_cast<unsigned long long>(x1 - x0) * (y1 - y0), std::memory_order_relaxed);
+          return;
+        }
+
+        if (reshading) {
+          const std::vector<DiskHit> &hits = cache.tileHits[tileIndex];
+          for (int y = y0; y < y1; y++) {
+            uint8_t *row = output + (static_cast<size_t>(y) * width) * 4;
+            for (int x = x0; x < x1; x++) {
+              const PixelHits &pixel = cache.pixels[static_cast<size_t>(y) * width + x];
+              Vector3 escapeDir(pixel.escapeDir[0], pixel.escapeDir[1], pixel.escapeDir[2]);
+              writeBGRA(renderer->blackHole.shadeHits(hits.data() + pixel.first, pixel.count,
+                                                      pixel.escaped ? &escapeDir : nullptr, shading),
+                        row + static_cast<size_t>(x) * 4);
+            }
+          }
+          raysTraced.fetch_add(static_cast<unsigned long long>(x1 - x0) * (y1 - y0), std::memory_order_relaxed);
+          return;
+        }
+
+        if (recording) {
+          // Output is shaded from the record too, so the following reshaded frames match it
+          std::vector<DiskHit> &hits = cache.tileHits[tileIndex];
+          hits.clear();
+          auto keep = [&](int x, int y, const HitRecord &record) {
+            PixelHits &pixel = cache.pixels[static_cast<size_t>(y) * width + x];
+            pixel.first = static_cast<uint32_t>(hits.size());
+            pixel.count = static_cast<uint32_t>(record.hits.size());
+            pixel.escapeDir[0] = static_cast<float>(record.escapeDir.x);
+            pixel.escapeDir[1] = static_cast<float>(record.escapeDir.y);
+            pixel.escapeDir[2] = static_cast<float>(record.escapeDir.z);
+            pixel.escaped = record.escaped ? 1 : 0;
+            hits.insert(hits.end(), record.hits.begin(), record.hits.end());
+            writeBGRA(renderer->blackHole.shadeHits(record.hits.data(), record.hits.size(),
+                                                    record.escaped ? &record.escapeDir : nullptr, shading),
+                      output + (static_cast<size_t>(y) * width + x) * 4);
+          };
+          if (packetTracer) {
+            RayPacket packet;
+            Vector3 colors[RayPacket::MAX_LANES];
+            HitRecord records[RayPacket::MAX_LANES];
+            for (int y = y0; y < y1; y++) {
+              for (int x = x0; x < x1; x += lanes) {
+                int count = std::min(lanes, x1 - x);
+                fillPacket(packet, setup, x, count, y, width, height);
+                for (int i = 0; i < count; i++) {
+                  records[i].hits.clear();
+                }
+                packetTracer->trace(packet, shading, STEP_SIZE, MAX_DIST, colors, records);
+                for (int i = 0; i < count; i++) {
+                  keep(x + i, y, records[i]);
+                }
+              }
+            }
+          } else {
+            HitRecord record;
+            for (int y = y0; y < y1; y++) {
+              for (int x = x0; x < x1; x++) {
+                record.hits.clear();
+                renderer->blackHole.trace(primaryRay(setup, x, y, width, height), shading, STEP_SIZE, MAX_DIST,
+                                          &traceStats, &record);
+                keep(x, y, record);
+              }
+            }
+            scalarRays = static_cast<unsigned long long>(x1 - x0) * (y1 - y0);
+          }
+          tracedRays.fetch_add(scalarRays, std::memory_order_relaxed);
+          tracedSteps.fetch_add(traceStats.steps, std::memory_order_relaxed);
+          capturedRays.fetch_add(traceStats.capturedRays, std::memory_order_relaxed);
+          nearCriticalRays.fetch_add(traceStats.nearCriticalRays, std::memory_order_relaxed);
+          raysTraced.fetch_add(static_cast<unsigned long long>(x1 - x0) * (y1 - y0), std::memory_order_relaxed);
+          return;
+        }
+
+        if (wavefront) {
+          for (int y = y0; y < y1; y++) {
+            for (int x = x0; x < x1; x++) {
+              renderer->wavefront->setRay(static_cast<size_t>(y) * width + x, primaryRay(setup, x, y, width, height),
+                                          shading, &traceStats);
+            }
+          }
+          scalarRays = static_cast<unsigned long long>(x1 - x0) * (y1 - y0);
+          tracedRays.fetch_add(scalarRays, std::memory_order_relaxed);
+          tracedSteps.fetch_add(traceStats.steps, std::memory_order_relaxed);
+          capturedRays.fetch_add(traceStats.capturedRays, std::memory_order_relaxed);
+          nearCriticalRays.fetch_add(traceStats.nearCriticalRays, std::memory_order_relaxed);
+          raysTraced.fetch_add(scalarRays, std::memory_order_relaxed);
+          return;
+        }
+
+        if (adaptive) {
+          AdaptiveTile tile(renderer->blackHole, setup, shading, x0, y0, x1, y1, width, height, output,
+                            traceStats);
+          scalarRays = tile.render();
+          tracedRays.fetch_add(scalarRays, std::memory_order_relaxed);
+          tracedSteps.fetch_add(traceStats.steps, std::memory_order_relaxed);
+          capturedRays.fetch_add(traceStats.capturedRays, std::memory_order_relaxed);
+          nearCriticalRays.fetch_add(traceStats.nearCriticalRays, std::memory_order_relaxed);
+          raysTraced.fetch_add(static_cast<unsigned long long>(x1 - x0) * (y1 - y0), std::memory_order_relaxed);
+          return;
+        }
+
+        for (int y = y0; y < y1; y++) {
+          uint8_t *row = output + (static_cast<size_t>(y) * width) * 4;
+          if (!setup.valid) {
+            for (int x = x0; x < x1; x++) {
+              uint8_t *pixel = row + static_cast<size_t>(x) * 4;
+              pixel[0] = 0;
+              pixel[1] = 0;
+              pixel[2] = 255;
+              pixel[3] = 255;
+            }
+            continue;
+          }
+
+          if (orbitTable) {
+            // Table lookup per pixel; rays it cannot resolve (grazing the disk) are traced
+            unsigned long long resolved = 0;
+            for (int x = x0; x < x1; x++) {
+              Ray ray = primaryRay(setup, x, y, width, height);
+              Vector3 color;
+              if (orbitTable->trace(renderer->blackHole, ray, shading, STEP_SIZE, MAX_DIST, color)) {
+                resolved++;
+              } else {
+                color = renderer->blackHole.trace(ray, shading, STEP_SIZE, MAX_DIST, &traceStats);
+                scalarRays++;
+              }
+              writeBGRA(color, row + static_cast<size_t>(x) * 4);
+            }
+            tableRays.fetch_add(resolved, std::memory_order_relaxed);
+            continue;
+          }
+
+          if (packetTracer) {
+            // Runs of `lanes` adjacent pixels stay coherent for most of their path
+            RayPacket packet;
+            Vector3 colors[RayPacket::MAX_LANES];
+            for (int x = x0; x < x1; x += lanes) {
+              int count = std::min(lanes, x1 - x);
+              fillPacket(packet, setup, x, count, y, width, height);
+              packetTracer->trace(packet, shading, STEP_SIZE, MAX_DIST, colors);
+              for (int i = 0; i < count; i++) {
+                writeBGRA(colors[i], row + static_cast<size_t>(x + i) * 4);
+              }
+            }
+            continue;
+          }
+
+          for (int x = x0; x < x1; x++) {
+            Ray ray = primaryRay(setup, x, y, width, height);
+            writeBGRA(renderer->blackHole.trace(ray, shading, STEP_SIZE, MAX_DIST, &traceStats),
+                      row + static_cast<size_t>(x) * 4);
+          }
+          scalarRays += static_cast<unsigned long long>(x1 - x0);
+        }
+        tracedRays.fetch_add(scalarRays, std::memory_order_relaxed);
+        tracedSteps.fetch_add(traceStats.steps, std::memory_order_relaxed);
+        capturedRays.fetch_add(traceStats.capturedRays, std::memory_order_relaxed);
+        nearCriticalRays.fetch_add(traceStats.nearCriticalRays, std::memory_order_relaxed);
+        raysTraced.fetch_add(static_cast<unsigned long long>(x1 - x0) * (y1 - y0),
+                             std::memory_order_relaxed);
+      });
+
+  if (wavefront) {
+    TraceStats waveStats;
+    renderer->wavefront->run(*renderer->pool, shading, STEP_SIZE, MAX_DIST, &waveStats);
+    tracedSteps.fetch_add(waveStats.steps, std::memory_order_relaxed);
+    renderer->pool->parallelFor(static_cast<size_t>(height), [&](size_t y, unsigned) {
+      uint8_t *row = output + y * width * 4;
+      for (int x = 0; x < width; x++) {
+        writeBGRA(renderer->wavefront->color(y * width + x), row + static_cast<size_t>(x) * 4);
+      }
+    });
+  }
+
+  auto frameEnd = std::chrono::high_resolution_clock::now();
+  renderer->stats.frameMs = std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+  renderer->stats.raysTraced = raysTraced.load();
+  renderer->stats.tableRays = tableRays.load();
+  renderer->stats.stepsPerRay =
+      tracedRays.load() > 0 ? static_cast<double>(tracedSteps.load()) / tracedRays.load() : 0.0;
+  renderer->stats.capturedRays = capturedRays.load();
+  renderer->stats.nearCriticalRays = nearCriticalRays.load();
+  renderer->stats.threadCount = static_cast<int>(renderer->pool->size());
+  renderer->stats.tileCount = tilesX * tilesY;
+  renderer->stats.simdLanes = lanes;
+  renderer->stats.cachedHits = 0;
+  renderer->stats.skyMapRebuilt = skyMapRebuilt ? 1 : 0;
+  renderer->stats.adaptiveSavedPercent =
+      adaptive && renderer->stats.raysTraced > 0
+          ? 100.0 * (1.0 - static_cast<double>(tracedRays.load()) / renderer->stats.raysTraced)
+          : 0.0;
+  if (skyMapRebuilt) {
+    // The build traced the map's texels instead of the frame's pixels
+    size_t texels = static_cast<size_t>(skyMap->size()) * skyMap->size() * 6;
+    renderer->stats.stepsPerRay = static_cast<double>(skyMapStats.steps) / texels;
+    renderer->stats.capturedRays = skyMapStats.capturedRays;
+    renderer->stats.nearCriticalRays = skyMapStats.nearCriticalRays;
+  }
+  if (skyMap) {
+    renderer->stats.cachedHits = skyMap->hitCount();
+  } else if (recording || reshading) {
+    for (const std::vector<DiskHit> &hits : cache.tileHits) {
+      renderer->stats.cachedHits += hits.size();
+    }
+  }
+  if (recording) {
+    cache.valid = renderer->stats.cachedHits * sizeof(DiskHit) <= HIT_CACHE_MAX_BYTES;
+    if (!cache.valid) {
+      // Keep the key so this view is not recorded again every frame
+      cache.overBudget = true;
+      cache.pixels = std::vector<PixelHits>();
+      cache.tileHits = std::vector<std::vector<DiskHit>>();
+      renderer->stats.cachedHits = 0;
+      appLog("[CPU] Hit cache over budget for this view, tracing every frame");
+    }
+  }
+  renderer->stats.hitCacheState = reshading ? 2 : (recording ? 1 : 0);
+  renderer->stats.progressiveStride = 0;
+  renderer->stats.progressiveConverged = 0.0;
+  renderer->stats.temporalSamples = 0;
+  renderer->stats.checkerboardFill = 0;
+  renderer->stats.wavefrontPasses = wavefront ? static_cast<int>(renderer->wavefront->activeCounts().size()) : 0;
+  renderer->stats.kernelName = skyMap          ? "Sky map"
+                                : reshading    ? "Hit cache"
+                                : wavefront    ? "Wavefront"
+                                : orbitTable   ? "Orbit table"
+                                : packetTracer ? PacketTracer::isaName(packetTracer->isa())
+                                               : integratorName(renderer->blackHole.integrator);
+
+  if (periodicLogDue(renderer)) {
+    std::ostringstream logMsg;
+    logMsg << "[CPU] " << width << "x" << height << " in " << renderer->stats.frameMs << " ms ("
+           << renderer->stats.tileCount << " tiles on " << renderer->stats.threadCount << " threads, "
+           << renderer->stats.kernelName << " kernel)";
+    if (renderer->stats.stepsPerRay > 0.0) {
+      logMsg << ", " << renderer->stats.stepsPerRay << " steps/ray";
+    }
+    if (renderer->stats.capturedRays + renderer->stats.nearCriticalRays > 0) {
+      logMsg << ", " << renderer->stats.capturedRays << " captured / " << renderer->stats.nearCriticalRays
+             << " near-critical";
+    }
+    if (adaptive) {
+      logMsg << ", adaptive sampling saved " << renderer->stats.adaptiveSavedPercent << "% of rays";
+    }
+    if (wavefront && renderer->stats.wavefrontPasses > 0) {
+      // Where the tail starts: passes until half, 90% and 99% of the integrated rays were done
+      const std::vector<size_t> &counts = renderer->wavefront->activeCounts();
+      auto passWhenLive = [&](double fraction) {
+        size_t pass = 0;
+        while (pass < counts.size() && counts[pass] > counts[0] * fraction) pass++;
+        return pass;
+      };
+      logMsg << ", " << counts.size() << " wavefront passes (" << counts[0] << " rays; 50%/90%/99% done by pass "
+             << passWhenLive(0.5) << "/" << passWhenLive(0.1) << "/" << passWhenLive(0.01) << ")";
+    }
+    if (orbitTable && renderer->stats.raysTraced > 0) {
+      logMsg << ", " << (100.0 * renderer->stats.tableRays / renderer->stats.raysTraced)
+             << "% of rays from orbit table";
+    }
+    appLog(logMsg.str());
+  }
+}
+
+} // namespace
+
+MetalRTRenderer *metal_rt_renderer_create(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    appLog("[CPU] Invalid renderer size", true);
+    return nullptr;
+  }
+
+  MetalRTRenderer *renderer = new MetalRTRenderer();
+  renderer->blackHole = BlackHole(1.0);
+  renderer->options = defaultOptions();
+  renderer->stats = CpuRenderStats{};
+  renderer->width = width;
+  renderer->height = height;
+  renderer->pixelData.resize(static_cast<size_t>(width) * height * 4);
+  ensurePool(renderer);
+  applyPacketOptions(renderer);
+  applyOrbitTableOptions(renderer);
+  applyDiskTextureOptions(renderer);
+  applyEmissionTableOptions(renderer);
+  if (envInt("BLACKHOLE_CPU_KERNEL_BENCHMARK", 0) != 0) {
+    benchmarkTraceKernels(renderer);
+  }
+
+  std::ostringstream logMsg;
+  logMsg << "[CPU] Tiled CPU renderer initialized at " << width << "x" << height << " with "
+         << renderer->pool->size() << " threads, " << renderer->options.tileSize << "px tiles, "
+         << (renderer->options.useSimd ? PacketTracer::isaName(renderer->packetTracer->isa()) : "scalar")
+         << " kernel";
+  appLog(logMsg.str());
+  return renderer;
+}
+
+void metal_rt_renderer_destroy(MetalRTRenderer *renderer) {
+  if (renderer) {
+    delete renderer;
+  }
+}
+
+void metal_rt_renderer_resize(MetalRTRenderer *renderer, int width, int height) {
+  if (!renderer || width <= 0 || height <= 0) return;
+
+  renderer->width = width;
+  renderer->height = height;
+  renderer->pixelData.resize(static_cast<size_t>(width) * height * 4);
+}
+
+void metal_rt_renderer_render(MetalRTRenderer *renderer,
+                              const CameraData *camera, float time, int colorMode, float colorIntensity) {
+  if (!renderer || !camera) return;
+  renderFrame(renderer, camera, time, colorMode, colorIntensity, renderer->pixelData.data(), true);
+}
+
+const void *metal_rt_renderer_get_pixels(MetalRTRenderer *renderer) {
+  if (!renderer) return nullptr;
+  return renderer->pixelData.data();
+}
+
+const void *metal_rt_renderer_render_and_get_pixels(MetalRTRenderer *renderer,
+                                                     const CameraData *camera, float time, int colorMode, float colorIntensity) {
+  if (!renderer || !camera) return nullptr;
+
+  renderer->screenshotBuffer.resize(metal_rt_renderer_get_pixel_data_size(renderer));
+  renderFrame(renderer, camera, time, colorMode, colorIntensity, renderer->screenshotBuffer.data(), false);
+  return renderer->screenshotBuffer.data();
+}
+
+size_t metal_rt_renderer_get_pixel_data_size(MetalRTRenderer *renderer) {
+  if (!renderer) return 0;
+  return static_cast<size_t>(renderer->width) * renderer->height * 4;
+}
+
+void cpu_rt_renderer_get_options(const MetalRTRenderer *renderer, CpuRenderOptions *options) {
+  if (!renderer || !options) return;
+  *options = renderer->options;
+}
+
+void cpu_rt_renderer_set_options(MetalRTRenderer *renderer, const CpuRenderOptions *options) {
+  if (!renderer || !options) return;
+  renderer->options.threadCount = std::max(0, options->threadCount);
+  renderer->options.tileSize = std::clamp(options->tileSize, 4, 512);
+  renderer->options.useSimd = options->useSimd != 0 ? 1 : 0;
+  renderer->options.simdIsa = std::clamp(options->simdIsa, 0, 3);
+  renderer->options.useOrbitTable = options->useOrbitTable != 0 ? 1 : 0;
+  renderer->options.integrator = std::clamp(options->integrator, 0, 2);
+  renderer->options.tolerance = std::clamp(options->tolerance, 1e-12, 1e-1);
+  renderer->options.boundingSphere = options->boundingSphere != 0 ? 1 : 0;
+  renderer->options.classifyRays = options->classifyRays != 0 ? 1 : 0;
+  renderer->options.slabStepping = options->slabStepping != 0 ? 1 : 0;
+  renderer->options.useHitCache = options->useHitCache != 0 ? 1 : 0;
+  renderer->options.useSkyMap = options->useSkyMap != 0 ? 1 : 0;
+  renderer->options.skyMapSize = std::clamp(options->skyMapSize, 16, 4096);
+  renderer->options.skyMapMove = std::max(options->skyMapMove, 0.0);
+  renderer->options.adaptive = options->adaptive != 0 ? 1 : 0;
+  renderer->options.wavefront = options->wavefront != 0 ? 1 : 0;
+  renderer->options.progressiveBudgetMs = std::max(options->progressiveBudgetMs, 0.0);
+  renderer->options.temporalAA = options->temporalAA != 0 ? 1 : 0;
+  renderer->options.checkerboard = options->checkerboard != 0 ? 1 : 0;
+  renderer->options.diskTexture = options->diskTexture != 0 ? 1 : 0;
+  renderer->options.emissionTable = options->emissionTable != 0 ? 1 : 0;
+  renderer->options.doppler = options->doppler != 0 ? 1 : 0;
+  renderer->options.specializedKernels = options->specializedKernels != 0 ? 1 : 0;
+  ensurePool(renderer);
+  applyPacketOptions(renderer);
+  applyOrbitTableOptions(renderer);
+  applyDiskTextureOptions(renderer);
+  applyEmissionTableOptions(renderer);
+}
+
+ThreadPool *cpu_rt_renderer_get_thread_pool(MetalRTRenderer *renderer) {
+  if (!renderer) return nullptr;
+  ensurePool(renderer);
+  return renderer->pool.get();
+}
+
+void cpu_rt_renderer_get_stats(const MetalRTRenderer *renderer, CpuRenderStats *stats) {
+  if (!renderer || !stats) return;
+  *stats = renderer->stats;
+}
+
+int cpu_rt_renderer_get_active_counts(const MetalRTRenderer *renderer, unsigned long long *counts, int maxCounts) {
+  if (!renderer || renderer->stats.wavefrontPasses == 0) return 0;
+  const std::vector<size_t> &passCounts = renderer->wavefront->activeCounts();
+  if (counts) {
+    for (int i = 0; i < maxCounts && i < static_cast<int>(passCounts.size()); i++) {
+      counts[i] = passCounts[i];
+    }
+  }
+  return static_cast<int>(passCounts.size());
+}
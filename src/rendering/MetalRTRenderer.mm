@@ -12,6 +12,7 @@ struct MetalRTRenderer {
   id<MTLTexture> outputTexture;
   std::vector<uint8_t> pixelData;  // Main render loop buffer
   std::vector<uint8_t> screenshotBuffer;  // Separate buffer for screenshots
+  std::vector<uint8_t> readbackBuffer;  // RGBA texture readback, sized with the texture
   int width;
   int height;
 };
@@ -40,6 +41,7 @@ MetalRTRenderer *metal_rt_renderer_create(int width, int height) {
     renderer->width = width;
     renderer->height = height;
     renderer->pixelData.resize(width * height * 4);
+    renderer->readbackBuffer.resize(width * height * 4);
 
     // Get Metal device
     renderer->device = MTLCreateSystemDefaultDevice();
@@ -159,6 +161,7 @@ void metal_rt_renderer_resize(MetalRTRenderer *renderer, int width, int height)
     renderer->width = width;
     renderer->height = height;
     renderer->pixelData.resize(width * height * 4);
+    renderer->readbackBuffer.resize(width * height * 4);
     
     // Recreate output texture with new size
     MTLTextureDescriptor *textureDesc = [MTLTextureDescriptor
@@ -265,18 +268,16 @@ void metal_rt_renderer_render(MetalRTRenderer *renderer,
     // SDL ARGB8888 expects ARGB (A=byte0, R=byte1, G=byte2, B=byte3) on little-endian
     // So we need to convert: RGBA -> ARGB
     size_t bytesPerRow = renderer->width * 4;
-    size_t totalBytes = bytesPerRow * renderer->height;
     
-    // Temporary buffer for RGBA data
-    std::vector<uint8_t> tempBuffer(totalBytes);
+    // RGBA readback into the buffer kept with the texture (no per-frame allocation)
     [renderer->outputTexture
-           getBytes:tempBuffer.data()
+           getBytes:renderer->readbackBuffer.data()
         bytesPerRow:bytesPerRow
          fromRegion:MTLRegionMake2D(0, 0, renderer->width, renderer->height)
         mipmapLevel:0];
     
     // Convert RGBA to BGRA (SDL_PIXELFORMAT_ARGB8888 on little-endian is BGRA in memory)
-    uint8_t *rgba = tempBuffer.data();
+    uint8_t *rgba = renderer->readbackBuffer.data();
     uint8_t *bgra = renderer->pixelData.data();
     size_t pixelCount = static_cast<size_t>(renderer->width) * static_cast<size_t>(renderer->height);
     for (size_t i = 0; i < pixelCount; i++) {
@@ -367,10 +368,8 @@ const void *metal_rt_renderer_render_and_get_pixels(MetalRTRenderer *renderer,
     
     // Read pixels directly from texture (fresh data)
     size_t bytesPerRow = renderer->width * 4;
-    size_t totalBytes = bytesPerRow * renderer->height;
     
-    std::vector<uint8_t> tempBuffer(totalBytes);
-    [renderer->outputTexture getBytes:tempBuffer.data()
+    [renderer->outputTexture getBytes:renderer->readbackBuffer.data()
                             bytesPerRow:bytesPerRow
                          fromRegion:MTLRegionMake2D(0, 0, renderer->width, renderer->height)
                         mipmapLevel:0];
@@ -380,7 +379,7 @@ const void *metal_rt_renderer_render_and_get_pixels(MetalRTRenderer *renderer,
     renderer->screenshotBuffer.resize(totalBytesNeeded);
     
     // Convert RGBA to BGRA into SCREENSHOT BUFFER (not pixelData!)
-    uint8_t *rgba = tempBuffer.data();
+    uint8_t *rgba = renderer->readbackBuffer.data();
     uint8_t *bgra = renderer->screenshotBuffer.data();
     size_t pixelCount = static_cast<size_t>(renderer->width) * static_cast<size_t>(renderer->height);
     for (size_t i = 0; i < pixelCount; i++) {
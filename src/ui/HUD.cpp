@@ -40,7 +40,7 @@ std::string formatResolution(int width, int height, ResolutionManager* resolutio
   return std::to_string(width) + "×" + std::to_string(height);
 }
 
-void HUD::renderHints(bool showHints, CinematicMode mode, int fps, int windowWidth, int windowHeight, ResolutionManager* resolutionManager, int colorMode, float colorIntensity, bool isMusicMuted) {
+void HUD::renderHints(bool showHints, CinematicMode mode, int fps, int windowWidth, int windowHeight, ResolutionManager* resolutionManager, int colorMode, float colorIntensity, bool isMusicMuted, int autoWidth, int autoHeight) {
   if (!showHints || !font)
     return;
 
@@ -56,6 +56,9 @@ void HUD::renderHints(bool showHints, CinematicMode mode, int fps, int windowWid
   intensityStream << std::fixed << std::setprecision(1) << colorIntensity << "x";
   std::string intensityStr = intensityStream.str();
 
+  // Dynamic resolution state
+  std::string autoResolutionStr = autoWidth > 0 ? std::to_string(autoWidth) + "×" + std::to_string(autoHeight) : "Off";
+
   // Define hints array with key and description separated
   struct HintLine {
     std::string key;
@@ -77,6 +80,7 @@ void HUD::renderHints(bool showHints, CinematicMode mode, int fps, int windowWid
     {"C", "Color: " + colorModeStr, false, false},
     {"+/-", "Change Resolution", false, false},
     {"Shift +/-", "Intensity: " + intensityStr, false, false},
+    {"P", "Auto Resolution: " + autoResolutionStr, false, false},
     {"", "", true, false}, // Separator
     {"Cmd+R", "Start Recording", false, false},
     {"Enter/Esc/Q", "Stop Recording", false, false},
@@ -0,0 +1,76 @@
+#include "../../include/utils/DynamicResolution.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr double MIN_SCALE = 0.25;     // Never trace fewer than 1/16 of the output pixels
+constexpr double SMOOTHING = 0.2;      // Weight of the newest frame time
+constexpr int WARMUP_FRAMES = 2;       // Frames ignored after a resize (buffers and caches rebuild)
+constexpr int SETTLE_FRAMES = 10;      // Frames measured at a size before it may change again
+constexpr double MIN_SCALE_STEP = 0.02; // Smaller corrections are not worth a resize
+
+} // namespace
+
+DynamicResolution::DynamicResolution(double targetMs, double hysteresis)
+    : outputWidth(0), outputHeight(0), width(0), height(0), targetMs(0.0), hysteresis(0.0), scale(1.0),
+      smoothedMs(0.0), samples(0) {
+  setTargetMs(targetMs);
+  setHysteresis(hysteresis);
+}
+
+void DynamicResolution::setOutputSize(int newWidth, int newHeight) {
+  outputWidth = std::max(newWidth, 1);
+  outputHeight = std::max(newHeight, 1);
+  applyScale(scale);
+}
+
+void DynamicResolution::setTargetMs(double ms) {
+  targetMs = std::max(ms, 1.0);
+}
+
+void DynamicResolution::setHysteresis(double fraction) {
+  hysteresis = std::clamp(fraction, 0.0, 0.9);
+}
+
+bool DynamicResolution::update(double traceMs) {
+  samples++;
+  if (samples <= WARMUP_FRAMES) {
+    return false;
+  }
+  smoothedMs = samples == WARMUP_FRAMES + 1 ? traceMs : smoothedMs + (traceMs - smoothedMs) * SMOOTHING;
+  if (samples < WARMUP_FRAMES + SETTLE_FRAMES) {
+    return false;
+  }
+
+  // Inside the band: hold the current size
+  if (smoothedMs <= targetMs * (1.0 + hysteresis) && smoothedMs >= targetMs * (1.0 - hysteresis)) {
+    return false;
+  }
+
+  double wanted = std::clamp(scale * std::sqrt(targetMs / std::max(smoothedMs, 0.01)), MIN_SCALE, 1.0);
+  if (std::abs(wanted - scale) < MIN_SCALE_STEP) {
+    return false;
+  }
+
+  int oldWidth = width;
+  int oldHeight = height;
+  applyScale(wanted);
+  samples = 0;
+  return width != oldWidth || height != oldHeight;
+}
+
+void DynamicResolution::reset() {
+  samples = 0;
+  smoothedMs = 0.0;
+  applyScale(1.0);
+}
+
+void DynamicResolution::applyScale(double newScale) {
+  scale = std::clamp(newScale, MIN_SCALE, 1.0);
+  // Even sizes keep the output aspect ratio within a pixel
+  width = std::max(2, static_cast<int>(std::lround(outputWidth * scale / 2.0)) * 2);
+  height = std::max(2, static_cast<int>(std::lround(outputHeight * scale / 2.0)) * 2);
+  width = std::min(width, outputWidth);
+  height = std::min(height, outputHeight);
+}
@@ -0,0 +1,82 @@
+#include "../../include/utils/FramePool.hpp"
+
+FramePool::FramePool() : frameBytes(0), generation(1), liveFrames(0), allocationCount(0) {}
+
+FramePool::~FramePool() = default;
+
+void FramePool::resize(int width, int height) {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t bytes = static_cast<size_t>(width) * height * 4;
+  if (bytes == frameBytes) {
+    return;
+  }
+  frameBytes = bytes;
+  generation++;
+  liveFrames -= static_cast<int>(idle.size());
+  idle.clear();
+}
+
+void FramePool::reserve(int count) {
+  std::lock_guard<std::mutex> lock(mutex);
+  while (liveFrames < count && frameBytes > 0) {
+    idle.push_back(allocate(frameBytes, generation));
+    liveFrames++;
+  }
+}
+
+FramePool::Frame *FramePool::acquire(int width, int height) {
+  size_t bytes = static_cast<size_t>(width) * height * 4;
+  std::unique_ptr<Frame> frame;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (bytes > frameBytes) {
+      frame = allocate(bytes, 0);
+    } else if (!idle.empty()) {
+      frame = std::move(idle.back());
+      idle.pop_back();
+    } else {
+      frame = allocate(frameBytes, generation);
+      liveFrames++;
+    }
+  }
+  frame->width = width;
+  frame->height = height;
+  return frame.release();
+}
+
+void FramePool::release(Frame *frame) {
+  if (!frame) {
+    return;
+  }
+  std::unique_ptr<Frame> owned(frame);
+  std::lock_guard<std::mutex> lock(mutex);
+  if (frame->generation == generation) {
+    idle.push_back(std::move(owned));
+  } else if (frame->generation != 0) {
+    liveFrames--; // Allocated before the last resize()
+  }
+}
+
+uint64_t FramePool::allocations() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return allocationCount;
+}
+
+int FramePool::frameCount() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return liveFrames;
+}
+
+size_t FramePool::bytes() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return static_cast<size_t>(liveFrames) * frameBytes;
+}
+
+std::unique_ptr<FramePool::Frame> FramePool::allocate(size_t bytes, uint64_t frameGeneration) {
+  auto frame = std::make_unique<Frame>();
+  frame->pixels.resize(bytes); // Zero-filled, so the pages are faulted in here rather than mid-capture
+  frame->owner = this;
+  frame->generation = frameGeneration;
+  allocationCount++;
+  return frame;
+}
@@ -0,0 +1,95 @@
+#include "../../include/utils/FrameQueue.hpp"
+#include <algorithm>
+
+FrameQueue::FrameQueue(int initialSlots, FullPolicy policy, int slotLimit)
+    : fullPolicy(policy), sequence(0), pending(nullptr), current(nullptr),
+      freeHead(0), freeTail(0), readyHead(0), readyTail(0), events(0), slotCount(0), closed(false),
+      droppedFrames(0) {
+  initialSlots = std::max(initialSlots, 1);
+  maxSlots = static_cast<size_t>(policy == FullPolicy::Grow ? std::max(slotLimit, initialSlots) : initialSlots);
+  freeRing.resize(maxSlots);
+  readyRing.resize(maxSlots);
+  for (int i = 0; i < initialSlots; i++) {
+    slots.push_back(std::make_unique<Slot>());
+    freeRing[i] = slots.back().get();
+  }
+  freeHead.store(initialSlots, std::memory_order_relaxed);
+  slotCount.store(initialSlots, std::memory_order_relaxed);
+}
+
+FrameQueue::Slot *FrameQueue::acquire() {
+  if (closed.load(std::memory_order_relaxed)) {
+    return nullptr;
+  }
+
+  int64_t index = sequence++;
+  uint64_t t = freeTail.load(std::memory_order_relaxed);
+  Slot *slot = nullptr;
+  while (!slot) {
+    uint64_t h = freeHead.load(std::memory_order_acquire);
+    if (h != t) {
+      slot = freeRing[t % maxSlots];
+      freeTail.store(t + 1, std::memory_order_release);
+    } else if (fullPolicy == FullPolicy::Drop) {
+      droppedFrames.fetch_add(1, std::memory_order_relaxed);
+      return nullptr;
+    } else if (fullPolicy == FullPolicy::Grow && slots.size() < maxSlots) {
+      slots.push_back(std::make_unique<Slot>());
+      slot = slots.back().get();
+      slotCount.store(static_cast<int>(slots.size()), std::memory_order_relaxed);
+    } else {
+      // Block (and Grow at its cap) until the consumer releases a slot
+      freeHead.wait(h, std::memory_order_acquire);
+    }
+  }
+
+  slot->index = index;
+  pending = slot;
+  return slot;
+}
+
+void FrameQueue::publish() {
+  uint64_t h = readyHead.load(std::memory_order_relaxed);
+  readyRing[h % maxSlots] = pending;
+  pending = nullptr;
+  readyHead.store(h + 1, std::memory_order_release);
+  events.fetch_add(1, std::memory_order_release);
+  events.notify_one();
+}
+
+void FrameQueue::close() {
+  closed.store(true, std::memory_order_release);
+  events.fetch_add(1, std::memory_order_release);
+  events.notify_one();
+}
+
+FrameQueue::Slot *FrameQueue::front() {
+  uint64_t t = readyTail.load(std::memory_order_relaxed);
+  while (true) {
+    // Read the event count before the checks so a publish or close in between wakes the wait
+    uint32_t seen = events.load(std::memory_order_acquire);
+    if (readyHead.load(std::memory_order_acquire) != t) {
+      current = readyRing[t % maxSlots];
+      return current;
+    }
+    if (closed.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    events.wait(seen, std::memory_order_acquire);
+  }
+}
+
+void FrameQueue::pop() {
+  readyTail.fetch_add(1, std::memory_order_release);
+  uint64_t h = freeHead.load(std::memory_order_relaxed);
+  freeRing[h % maxSlots] = current;
+  current = nullptr;
+  freeHead.store(h + 1, std::memory_order_release);
+  freeHead.notify_one();
+}
+
+int FrameQueue::depth() const {
+  uint64_t t = readyTail.load(std::memory_order_acquire);
+  uint64_t h = readyHead.load(std::memory_order_acquire);
+  return static_cast<int>(h - t);
+}
@@ -0,0 +1,31 @@
+// Non-macOS implementations of SaveDialog.h and IconLoader.h
+// (the Cocoa versions live in SaveDialog.mm / IconLoader.mm)
+#include "../../include/utils/SaveDialog.h"
+#include "../../include/utils/IconLoader.h"
+#include <string>
+
+// External logging function from main.cpp
+extern void appLog(const std::string& message, bool isError = false);
+
+// No native dialog available: report "cancelled" so the recording
+// stays at its temporary location
+std::string showSaveDialog(const std::string& defaultFilename) {
+  appLog("[DIALOG] No save dialog on this platform, keeping " + defaultFilename);
+  return std::string();
+}
+
+// Screenshots are written to the working directory under their default name
+std::string showSaveDialogPNG(const std::string& defaultFilename) {
+  return defaultFilename;
+}
+
+// Not running from an app bundle
+const char* getBundleResourcesPath() {
+  return nullptr;
+}
+
+// Window icons come from the desktop entry on Linux; nothing to do here
+void loadWindowIcon(SDL_Window* window, const char* iconPath) {
+  (void)window;
+  (void)iconPath;
+}
@@ -0,0 +1,126 @@
+#include "../../include/utils/ThreadPool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : currentTask(nullptr), generation(0), activeWorkers(0), stopping(false) {
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (unsigned i = 0; i < threadCount; i++) {
+    queues.push_back(std::make_unique<WorkQueue>());
+  }
+
+  // Worker 0 is the thread calling parallelFor()
+  for (unsigned i = 1; i < threadCount; i++) {
+    threads.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    stopping = true;
+  }
+  startCondition.notify_all();
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t, unsigned)> &task) {
+  if (count == 0) {
+    return;
+  }
+
+  // Single worker (or single item): no point waking anyone
+  if (queues.size() == 1 || count == 1) {
+    for (size_t i = 0; i < count; i++) {
+      task(i, 0);
+    }
+    return;
+  }
+
+  // Seed each worker with a contiguous block so neighbouring tiles share caches
+  size_t workerCount = queues.size();
+  for (size_t w = 0; w < workerCount; w++) {
+    size_t begin = count * w / workerCount;
+    size_t end = count * (w + 1) / workerCount;
+    std::lock_guard<std::mutex> lock(queues[w]->mutex);
+    for (size_t i = begin; i < end; i++) {
+      queues[w]->indices.push_back(i);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    currentTask = &task;
+    activeWorkers = static_cast<unsigned>(threads.size());
+    generation++;
+  }
+  startCondition.notify_all();
+
+  drain(0, task);
+
+  // Wait for the helpers to run out of work (their last item may still be running)
+  std::unique_lock<std::mutex> lock(stateMutex);
+  doneCondition.wait(lock, [this] { return activeWorkers == 0; });
+  currentTask = nullptr;
+}
+
+void ThreadPool::workerLoop(unsigned workerId) {
+  uint64_t seenGeneration = 0;
+  while (true) {
+    const std::function<void(size_t, unsigned)> *task = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(stateMutex);
+      startCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+      if (stopping) {
+        return;
+      }
+      seenGeneration = generation;
+      task = currentTask;
+    }
+
+    drain(workerId, *task);
+
+    {
+      std::lock_guard<std::mutex> lock(stateMutex);
+      activeWorkers--;
+    }
+    doneCondition.notify_one();
+  }
+}
+
+void ThreadPool::drain(unsigned workerId, const std::function<void(size_t, unsigned)> &task) {
+  size_t index;
+  while (popLocal(workerId, index) || steal(workerId, index)) {
+    task(index, workerId);
+  }
+}
+
+bool ThreadPool::popLocal(unsigned workerId, size_t &index) {
+  WorkQueue &queue = *queues[workerId];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.indices.empty()) {
+    return false;
+  }
+  index = queue.indices.front();
+  queue.indices.pop_front();
+  return true;
+}
+
+bool ThreadPool::steal(unsigned thiefId, size_t &index) {
+  // Visit victims starting after ourselves so thieves spread out
+  size_t workerCount = queues.size();
+  for (size_t offset = 1; offset < workerCount; offset++) {
+    WorkQueue &victim = *queues[(thiefId + offset) % workerCount];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.indices.empty()) {
+      index = victim.indices.back();
+      victim.indices.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,162 @@
+#include "../../include/utils/Upscaler.hpp"
+#include "../../include/utils/ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+constexpr int ROWS_PER_TASK = 16;
+constexpr int BORDER = 2;         // Clamped margin around the source: the 4x4 taps reach 1 left, 2 right
+constexpr float EDGE_GAIN = 2.0f;    // Edge strength per unit of luma gradient (per texel); 1 = full edge
+constexpr float FLAT_LUMA = 1.0f / 64.0f; // Quads with less luma spread than this are blended bilinearly
+
+// Catmull-Rom weights of the taps at -1, 0, 1, 2 for a sample at t in [0, 1)
+inline void catmullRom(float t, float *w) {
+  float t2 = t * t;
+  float t3 = t2 * t;
+  w[0] = -0.5f * t3 + t2 - 0.5f * t;
+  w[1] = 1.5f * t3 - 2.5f * t2 + 1.0f;
+  w[2] = -1.5f * t3 + 2.0f * t2 + 0.5f * t;
+  w[3] = 0.5f * t3 - 0.5f * t2;
+}
+
+} // namespace
+
+Upscaler::Upscaler() : sharedPool(nullptr) {}
+
+Upscaler::~Upscaler() = default;
+
+void Upscaler::setThreadPool(ThreadPool *shared) {
+  sharedPool = shared;
+}
+
+void Upscaler::upscale(const uint8_t *src, int srcWidth, int srcHeight, uint8_t *dst, int dstWidth,
+                       int dstHeight) {
+  if (srcWidth == dstWidth && srcHeight == dstHeight) {
+    std::memcpy(dst, src, static_cast<size_t>(srcWidth) * srcHeight * 4);
+    return;
+  }
+
+  if (!sharedPool && !ownPool) {
+    ownPool = std::make_unique<ThreadPool>();
+  }
+  ThreadPool &pool = sharedPool ? *sharedPool : *ownPool;
+
+  // Source and its luma (0..1) with a BORDER-texel clamped margin, so taps need no bounds checks
+  const int paddedWidth = srcWidth + 2 * BORDER;
+  const int paddedHeight = srcHeight + 2 * BORDER;
+  padded.resize(static_cast<size_t>(paddedWidth) * paddedHeight * 4);
+  luma.resize(static_cast<size_t>(paddedWidth) * paddedHeight);
+  size_t padTasks = (paddedHeight + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+  pool.parallelFor(padTasks, [&](size_t task, unsigned) {
+    int y1 = std::min(static_cast<int>(task + 1) * ROWS_PER_TASK, paddedHeight);
+    for (int y = static_cast<int>(task) * ROWS_PER_TASK; y < y1; y++) {
+      const uint8_t *row = src + static_cast<size_t>(std::clamp(y - BORDER, 0, srcHeight - 1)) * srcWidth * 4;
+      for (int x = 0; x < paddedWidth; x++) {
+        const uint8_t *p = row + std::clamp(x - BORDER, 0, srcWidth - 1) * 4;
+        size_t i = static_cast<size_t>(y) * paddedWidth + x;
+        std::memcpy(&padded[i * 4], p, 4);
+        luma[i] = (0.114f * p[0] + 0.587f * p[1] + 0.299f * p[2]) / 255.0f;
+      }
+    }
+  });
+
+  // Source position of every output column: nearest texel to the left and the fraction
+  const float scaleX = static_cast<float>(srcWidth) / dstWidth;
+  const float scaleY = static_cast<float>(srcHeight) / dstHeight;
+  columnTexel.resize(dstWidth);
+  columnFraction.resize(dstWidth);
+  for (int x = 0; x < dstWidth; x++) {
+    float sx = (x + 0.5f) * scaleX - 0.5f;
+    columnTexel[x] = static_cast<int>(std::floor(sx));
+    columnFraction[x] = sx - columnTexel[x];
+  }
+
+  size_t tasks = (dstHeight + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+  pool.parallelFor(tasks, [&](size_t task, unsigned) {
+    int y1 = std::min(static_cast<int>(task + 1) * ROWS_PER_TASK, dstHeight);
+    for (int y = static_cast<int>(task) * ROWS_PER_TASK; y < y1; y++) {
+      float sy = (y + 0.5f) * scaleY - 0.5f;
+      int iy = static_cast<int>(std::floor(sy));
+      float fy = sy - iy;
+      uint8_t *out = dst + static_cast<size_t>(y) * dstWidth * 4;
+
+      const ptrdiff_t stride = paddedWidth;
+      for (int x = 0; x < dstWidth; x++, out += 4) {
+        const int ix = columnTexel[x];
+        const float fx = columnFraction[x];
+        const size_t base = static_cast<size_t>(iy + BORDER) * paddedWidth + (ix + BORDER);
+        const uint8_t *quad[4] = {&padded[base * 4], &padded[(base + 1) * 4], &padded[(base + stride) * 4],
+                                  &padded[(base + stride + 1) * 4]};
+
+        // Ringing clamp range: the 2x2 texels around the sample point. A flat quad is the answer.
+        uint8_t low[3], high[3];
+        for (int c = 0; c < 3; c++) {
+          low[c] = std::min(std::min(quad[0][c], quad[1][c]), std::min(quad[2][c], quad[3][c]));
+          high[c] = std::max(std::max(quad[0][c], quad[1][c]), std::max(quad[2][c], quad[3][c]));
+        }
+        if (low[0] == high[0] && low[1] == high[1] && low[2] == high[2]) {
+          out[0] = low[0];
+          out[1] = low[1];
+          out[2] = low[2];
+          out[3] = 255;
+          continue;
+        }
+
+        // Luma gradient at the sample point: bilinear blend of the central differences
+        // of the four nearest texels
+        const float *l = &luma[base];
+        float lumaLow = std::min(std::min(l[0], l[1]), std::min(l[stride], l[stride + 1]));
+        float lumaHigh = std::max(std::max(l[0], l[1]), std::max(l[stride], l[stride + 1]));
+        float gx = ((l[1] - l[-1]) * (1.0f - fx) + (l[2] - l[0]) * fx) * (1.0f - fy) +
+                   ((l[stride + 1] - l[stride - 1]) * (1.0f - fx) + (l[stride + 2] - l[stride]) * fx) * fy;
+        float gy = ((l[stride] - l[-stride]) * (1.0f - fx) + (l[stride + 1] - l[1 - stride]) * fx) * (1.0f - fy) +
+                   ((l[2 * stride] - l[0]) * (1.0f - fx) + (l[2 * stride + 1] - l[1]) * fx) * fy;
+        float length = std::sqrt(gx * gx + gy * gy);
+        float strength = lumaHigh - lumaLow < FLAT_LUMA ? 0.0f : std::min(length * EDGE_GAIN, 1.0f);
+
+        // Separable weights: Catmull-Rom across the edge keeps it sharp, a tent along it
+        // smooths the staircase. Both reproduce linear ramps, so any blend of them does too.
+        float wx[4], wy[4];
+        catmullRom(fx, wx);
+        catmullRom(fy, wy);
+        if (strength > 0.0f) {
+          float alongX = std::abs(gy) / length * strength; // x runs along an edge whose gradient is in y
+          float alongY = std::abs(gx) / length * strength;
+          const float tentX[4] = {0.0f, 1.0f - fx, fx, 0.0f};
+          const float tentY[4] = {0.0f, 1.0f - fy, fy, 0.0f};
+          for (int k = 0; k < 4; k++) {
+            wx[k] += (tentX[k] - wx[k]) * alongX;
+            wy[k] += (tentY[k] - wy[k]) * alongY;
+          }
+        } else {
+          // Flat quad: plain bilinear
+          wx[0] = wx[3] = wy[0] = wy[3] = 0.0f;
+          wx[1] = 1.0f - fx;
+          wx[2] = fx;
+          wy[1] = 1.0f - fy;
+          wy[2] = fy;
+        }
+
+        // Each axis' weights sum to 1
+        float sum[3] = {0.0f, 0.0f, 0.0f};
+        for (int ty = 0; ty < 4; ty++) {
+          const uint8_t *row = &padded[(base + (ty - 1) * stride - 1) * 4];
+          for (int tx = 0; tx < 4; tx++) {
+            float w = wx[tx] * wy[ty];
+            sum[0] += row[tx * 4] * w;
+            sum[1] += row[tx * 4 + 1] * w;
+            sum[2] += row[tx * 4 + 2] * w;
+          }
+        }
+
+        for (int c = 0; c < 3; c++) {
+          float value = std::clamp(sum[c], static_cast<float>(low[c]), static_cast<float>(high[c]));
+          out[c] = static_cast<uint8_t>(value + 0.5f);
+        }
+        out[3] = 255;
+      }
+    }
+  });
+}
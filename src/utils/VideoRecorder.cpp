@@ -1,11 +1,21 @@
 #include "../../include/utils/VideoRecorder.hpp"
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <ctime>
 #include <iomanip>
 #include <sstream>
+#include <cmath>
+#include <cerrno>
 #include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/file.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <vector>
 
 // External logging function from main.cpp
@@ -22,17 +32,457 @@ extern "C" {
 }
 
 struct FFmpegContext {
-  AVFormatContext* formatContext;
-  AVCodecContext* codecContext;
-  AVStream* videoStream;
-  AVFrame* frame;
-  AVPacket* packet;
-  SwsContext* swsContext;
-  int frameCount;
+  AVFormatContext* formatContext = nullptr;
+  AVCodecContext* codecContext = nullptr; // Null for the final file of a segmented recording (stream copy)
+  AVStream* videoStream = nullptr;
+  AVFrame* frame = nullptr;
+  AVPacket* packet = nullptr;
+  SwsContext* swsContext = nullptr;
+  int frameCount = 0;
+  int64_t nextPts = 0;       // One past the last written frame's pts (video length in frames)
+  bool headerWritten = false;
+
+  // Music stream-copied into the recording as frames are encoded (null without audio)
+  AVFormatContext* audioInput = nullptr;
+  AVStream* audioStream = nullptr; // Output stream
+  int audioInputIndex = -1;
+  AVPacket* audioPacket = nullptr; // Read ahead, written once the video reaches it
+  bool audioPending = false;
+  bool audioEnded = false;
+  int64_t audioLoopOffset = 0; // Added to input timestamps on each pass over the file (input time base)
+  int64_t audioEnd = 0;        // End of the last packet read, offset included (input time base)
+};
+
+// One encoder instance of a segmented recording, fed its segments' frames in order
+struct VideoRecorder::SegmentWorker {
+  std::unique_ptr<FrameQueue> queue;
+  std::thread thread;
 };
 
+namespace {
+
+// Default queue: a few frames of slack, blocking the render thread rather than losing frames
+constexpr int DEFAULT_QUEUE_SLOTS = 4;
+constexpr int DEFAULT_QUEUE_MAX_SLOTS = 16;
+// Segment encoders: frames reserved for each when recording starts; the rest of a
+// segment comes from the pool as it is needed
+constexpr int SEGMENT_RESERVED_SLOTS = 4;
+
+void freeContext(FFmpegContext* ctx) {
+  if (ctx->swsContext) {
+    sws_freeContext(ctx->swsContext);
+    ctx->swsContext = nullptr;
+  }
+  
+  if (ctx->packet) {
+    av_packet_free(&ctx->packet);
+  }
+
+  if (ctx->audioPacket) {
+    av_packet_free(&ctx->audioPacket);
+  }
+
+  if (ctx->audioInput) {
+    avformat_close_input(&ctx->audioInput);
+  }
+  
+  if (ctx->frame) {
+    av_frame_free(&ctx->frame);
+  }
+  
+  if (ctx->codecContext) {
+    avcodec_free_context(&ctx->codecContext);
+  }
+  
+  if (ctx->formatContext) {
+    if (!(ctx->formatContext->oformat->flags & AVFMT_NOFILE)) {
+      avio_closep(&ctx->formatContext->pb);
+    }
+    avformat_free_context(ctx->formatContext);
+  }
+  
+  delete ctx;
+}
+
+// Fragmented MP4: an empty moov up front, then a self-contained fragment every
+// `fragmentSeconds`, so the muxer keeps no per-sample index for the whole recording
+// and a file cut short is readable up to its last complete fragment
+AVDictionary* muxerOptions(double fragmentSeconds) {
+  AVDictionary* options = nullptr;
+  if (fragmentSeconds > 0) {
+    av_dict_set(&options, "movflags", "empty_moov+default_base_moof", 0);
+    av_dict_set_int(&options, "frag_duration", static_cast<int64_t>(fragmentSeconds * 1000000.0), 0);
+  }
+  return options;
+}
+
+bool endsWith(const std::string& text, const std::string& suffix) {
+  return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool fileExists(const std::string& path) {
+  struct stat info;
+  return stat(path.c_str(), &info) == 0;
+}
+
+// Where open sessions leave their markers: a per-user directory in the platform cache
+// ($XDG_CACHE_HOME, else ~/Library/Caches on macOS or ~/.cache), not the shared /tmp the
+// recordings are written to. Created on first use; empty if there is no home directory.
+std::string sessionDirectory() {
+  std::string cacheDir;
+  const char* xdgCache = std::getenv("XDG_CACHE_HOME");
+  const char* home = std::getenv("HOME");
+  if (xdgCache && xdgCache[0] == '/') {
+    cacheDir = xdgCache;
+  } else if (home && home[0] != '\0') {
+#ifdef __APPLE__
+    cacheDir = std::string(home) + "/Library/Caches";
+#else
+    cacheDir = std::string(home) + "/.cache";
+#endif
+  } else {
+    return std::string();
+  }
+
+  std::string directory = cacheDir + "/blackhole-sim/recordings";
+  std::string path = directory + "/";
+  for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+    if (mkdir(path.substr(0, slash).c_str(), 0700) != 0 && errno != EEXIST) {
+      return std::string();
+    }
+  }
+  return directory;
+}
+
+void closeOutput(AVFormatContext* output) {
+  if (!(output->oformat->flags & AVFMT_NOFILE)) {
+    avio_closep(&output->pb);
+  }
+  avformat_free_context(output);
+}
+
+// Write the output's header. If the muxer rejects it with the stream-copied music attached,
+// the output is rebuilt around the video stream alone (a stream cannot be removed from a
+// format context) and the header retried, so a codec the container refuses costs the audio
+// track rather than the recording. Returns the avformat_write_header result.
+int writeHeader(FFmpegContext* ctx, const std::string& path, double fragmentSeconds) {
+  AVDictionary* options = muxerOptions(fragmentSeconds);
+  int ret = avformat_write_header(ctx->formatContext, &options);
+  av_dict_free(&options);
+  if (ret >= 0 || !ctx->audioStream) {
+    return ret;
+  }
+
+  char errbuf[AV_ERROR_MAX_STRING_SIZE];
+  av_strerror(ret, errbuf, AV_ERROR_MAX_STRING_SIZE);
+  appLog(std::string("[FFMPEG] Muxer rejected the audio stream (") + errbuf + "), recording video only", true);
+
+  AVFormatContext* output = nullptr;
+  if (avformat_alloc_output_context2(&output, nullptr, nullptr, path.c_str()) < 0 || !output) {
+    return ret;
+  }
+  AVStream* video = avformat_new_stream(output, nullptr);
+  if (!video || avcodec_parameters_copy(video->codecpar, ctx->videoStream->codecpar) < 0) {
+    closeOutput(output);
+    return ret;
+  }
+  video->codecpar->codec_tag = 0;
+  video->time_base = ctx->videoStream->time_base;
+
+  closeOutput(ctx->formatContext);
+  ctx->formatContext = output;
+  ctx->videoStream = video;
+  ctx->audioStream = nullptr;
+  ctx->audioInputIndex = -1;
+  av_packet_free(&ctx->audioPacket);
+  avformat_close_input(&ctx->audioInput);
+
+  if (!(output->oformat->flags & AVFMT_NOFILE)) {
+    ret = avio_open(&output->pb, path.c_str(), AVIO_FLAG_WRITE);
+    if (ret < 0) {
+      return ret;
+    }
+  }
+  options = muxerOptions(fragmentSeconds);
+  ret = avformat_write_header(output, &options);
+  av_dict_free(&options);
+  return ret;
+}
+
+// Add the audio file as a stream-copied second stream of the output (before its header)
+bool openAudioInput(FFmpegContext* ctx, const std::string& path) {
+  int ret = avformat_open_input(&ctx->audioInput, path.c_str(), nullptr, nullptr);
+  if (ret < 0) {
+    char errbuf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(ret, errbuf, AV_ERROR_MAX_STRING_SIZE);
+    std::ostringstream errMsg;
+    errMsg << "[FFMPEG] Could not open audio " << path << ": " << errbuf;
+    appLog(errMsg.str(), true);
+    return false;
+  }
+  avformat_find_stream_info(ctx->audioInput, nullptr);
+  
+  for (unsigned int i = 0; i < ctx->audioInput->nb_streams; i++) {
+    if (ctx->audioInput->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+      ctx->audioInputIndex = i;
+      break;
+    }
+  }
+  if (ctx->audioInputIndex < 0) {
+    appLog("[FFMPEG] No audio stream in " + path, true);
+    avformat_close_input(&ctx->audioInput);
+    return false;
+  }
+  
+  // Stream copy: the packets go into the recording as they are
+  AVStream* inStream = ctx->audioInput->streams[ctx->audioInputIndex];
+  ctx->audioStream = avformat_new_stream(ctx->formatContext, nullptr);
+  if (!ctx->audioStream || !(ctx->audioPacket = av_packet_alloc())) {
+    avformat_close_input(&ctx->audioInput);
+    ctx->audioStream = nullptr;
+    return false;
+  }
+  avcodec_parameters_copy(ctx->audioStream->codecpar, inStream->codecpar);
+  ctx->audioStream->codecpar->codec_tag = 0;
+  
+  // Explicitly set channel layout for MP4 compatibility
+  if (ctx->audioStream->codecpar->ch_layout.nb_channels == 2) {
+    av_channel_layout_default(&ctx->audioStream->codecpar->ch_layout, 2); // Stereo
+  } else if (ctx->audioStream->codecpar->ch_layout.nb_channels == 1) {
+    av_channel_layout_default(&ctx->audioStream->codecpar->ch_layout, 1); // Mono
+  }
+  ctx->audioStream->time_base = inStream->time_base;
+  
+  std::ostringstream logMsg;
+  logMsg << "[FFMPEG] Recording audio from " << path << " into the same file";
+  appLog(logMsg.str());
+  return true;
+}
+
+// Write audio packets that start before `seconds` of video, looping the file
+void writeAudioUntil(FFmpegContext* ctx, double seconds) {
+  if (!ctx->audioStream || ctx->audioEnded) {
+    return;
+  }
+  
+  AVStream* inStream = ctx->audioInput->streams[ctx->audioInputIndex];
+  int64_t startTime = inStream->start_time != AV_NOPTS_VALUE ? inStream->start_time : 0;
+  while (true) {
+    if (!ctx->audioPending) {
+      int ret = av_read_frame(ctx->audioInput, ctx->audioPacket);
+      if (ret < 0) {
+        // End of the file: start it over, as the music loops in the app (give up if a
+        // whole pass produced nothing)
+        if (ctx->audioEnd <= ctx->audioLoopOffset ||
+            av_seek_frame(ctx->audioInput, ctx->audioInputIndex, startTime, AVSEEK_FLAG_BACKWARD) < 0) {
+          ctx->audioEnded = true;
+          return;
+        }
+        ctx->audioLoopOffset = ctx->audioEnd - startTime;
+        continue;
+      }
+      if (ctx->audioPacket->stream_index != ctx->audioInputIndex) {
+        av_packet_unref(ctx->audioPacket);
+        continue;
+      }
+      if (ctx->audioPacket->pts == AV_NOPTS_VALUE) {
+        ctx->audioPacket->pts = ctx->audioEnd - ctx->audioLoopOffset;
+      }
+      if (ctx->audioPacket->dts == AV_NOPTS_VALUE) {
+        ctx->audioPacket->dts = ctx->audioPacket->pts;
+      }
+      ctx->audioPacket->pts += ctx->audioLoopOffset;
+      ctx->audioPacket->dts += ctx->audioLoopOffset;
+      ctx->audioEnd = ctx->audioPacket->pts + ctx->audioPacket->duration;
+      ctx->audioPending = true;
+    }
+    
+    // Keep the packet for later if the video has not reached it yet
+    if (ctx->audioPacket->pts * av_q2d(inStream->time_base) >= seconds) {
+      return;
+    }
+    
+    ctx->audioPacket->stream_index = ctx->audioStream->index;
+    av_packet_rescale_ts(ctx->audioPacket, inStream->time_base, ctx->audioStream->time_base);
+    ctx->audioPacket->pos = -1;
+    av_interleaved_write_frame(ctx->formatContext, ctx->audioPacket);
+    av_packet_unref(ctx->audioPacket);
+    ctx->audioPending = false;
+  }
+}
+
+// Output with a stream-copied stream per source, header written (nullptr on failure)
+AVFormatContext* openCopyOutput(const std::string& path, const std::vector<AVStream*>& sources) {
+  AVFormatContext* output = nullptr;
+  if (avformat_alloc_output_context2(&output, nullptr, nullptr, path.c_str()) < 0 || !output) {
+    return nullptr;
+  }
+  for (AVStream* source : sources) {
+    AVStream* stream = avformat_new_stream(output, nullptr);
+    if (!stream || avcodec_parameters_copy(stream->codecpar, source->codecpar) < 0) {
+      closeOutput(output);
+      return nullptr;
+    }
+    stream->codecpar->codec_tag = 0;
+    stream->time_base = source->time_base;
+  }
+  if ((!(output->oformat->flags & AVFMT_NOFILE) && avio_open(&output->pb, path.c_str(), AVIO_FLAG_WRITE) < 0) ||
+      avformat_write_header(output, nullptr) < 0) {
+    closeOutput(output);
+    return nullptr;
+  }
+  return output;
+}
+
+// Rewrite an interrupted fragmented recording with a complete index. A plain MP4 cut
+// short has no moov, so opening it fails and it is left as it is.
+bool recoverFragmented(const std::string& path) {
+  AVFormatContext* input = nullptr;
+  if (avformat_open_input(&input, path.c_str(), nullptr, nullptr) < 0) {
+    return false;
+  }
+  if (avformat_find_stream_info(input, nullptr) < 0 || input->nb_streams == 0) {
+    avformat_close_input(&input);
+    return false;
+  }
+
+  std::string temp = path + ".recovered.mp4";
+  std::vector<AVStream*> sources(input->streams, input->streams + input->nb_streams);
+  AVFormatContext* output = openCopyOutput(temp, sources);
+  if (!output) {
+    avformat_close_input(&input);
+    return false;
+  }
+
+  int64_t packets = 0;
+  AVPacket* packet = av_packet_alloc();
+  while (packet && av_read_frame(input, packet) >= 0) {
+    av_packet_rescale_ts(packet, input->streams[packet->stream_index]->time_base,
+                         output->streams[packet->stream_index]->time_base);
+    packet->pos = -1;
+    if (av_interleaved_write_frame(output, packet) >= 0) {
+      packets++;
+    }
+    av_packet_unref(packet);
+  }
+  av_packet_free(&packet);
+
+  bool recovered = packets > 0 && av_write_trailer(output) >= 0;
+  closeOutput(output);
+  avformat_close_input(&input);
+  if (recovered && std::rename(temp.c_str(), path.c_str()) == 0) {
+    return true;
+  }
+  std::remove(temp.c_str());
+  return false;
+}
+
+// Join the finished segments of an interrupted segmented recording ("<segment>
+// <first frame> <path>" lines, in completion order) into `output`, with the music in
+// `audioPath` stream-copied alongside as the recording had it (empty: video only)
+bool recoverSegments(const std::string& output, const std::string& listPath, const std::string& audioPath) {
+  std::map<int64_t, std::pair<int64_t, std::string>> segments;
+  std::ifstream list(listPath);
+  std::string line;
+  while (std::getline(list, line)) {
+    std::istringstream fields(line);
+    int64_t segment, startFrame;
+    std::string path;
+    if (fields >> segment >> startFrame && std::getline(fields >> std::ws, path) && fileExists(path)) {
+      segments[segment] = {startFrame, path};
+    }
+  }
+  if (segments.empty()) {
+    std::remove(listPath.c_str()); // Stopped before any segment finished
+    return false;
+  }
+
+  FFmpegContext* ctx = new FFmpegContext();
+  int64_t end = 0; // Past the last packet written (output time base), for segments without a frame rate
+  for (const auto& entry : segments) {
+    AVFormatContext* input = nullptr;
+    if (avformat_open_input(&input, entry.second.second.c_str(), nullptr, nullptr) < 0) {
+      continue;
+    }
+    if (avformat_find_stream_info(input, nullptr) < 0 || input->nb_streams == 0) {
+      avformat_close_input(&input);
+      continue;
+    }
+
+    // The output takes its video parameters from the first readable segment
+    if (!ctx->headerWritten) {
+      AVStream* source = input->streams[0];
+      if (avformat_alloc_output_context2(&ctx->formatContext, nullptr, nullptr, output.c_str()) < 0 ||
+          !ctx->formatContext) {
+        avformat_close_input(&input);
+        break;
+      }
+      ctx->videoStream = avformat_new_stream(ctx->formatContext, nullptr);
+      if (!ctx->videoStream || avcodec_parameters_copy(ctx->videoStream->codecpar, source->codecpar) < 0) {
+        avformat_close_input(&input);
+        break;
+      }
+      ctx->videoStream->codecpar->codec_tag = 0;
+      ctx->videoStream->time_base = source->time_base;
+      if (!audioPath.empty() && fileExists(audioPath) && !openAudioInput(ctx, audioPath)) {
+        appLog("[FFMPEG] Could not add the audio stream to " + output + " (recovering video only)", true);
+      }
+      if ((!(ctx->formatContext->oformat->flags & AVFMT_NOFILE) &&
+           avio_open(&ctx->formatContext->pb, output.c_str(), AVIO_FLAG_WRITE) < 0) ||
+          writeHeader(ctx, output, 0.0) < 0) {
+        avformat_close_input(&input);
+        break;
+      }
+      ctx->headerWritten = true;
+    }
+
+    AVStream* inStream = input->streams[0];
+    AVRational outTimeBase = ctx->videoStream->time_base;
+    AVRational rate = inStream->avg_frame_rate.num > 0 ? inStream->avg_frame_rate : inStream->r_frame_rate;
+    int64_t offset = rate.num > 0 ? av_rescale_q(entry.second.first, av_inv_q(rate), outTimeBase) : end;
+
+    AVPacket* packet = av_packet_alloc();
+    while (packet && av_read_frame(input, packet) >= 0) {
+      if (packet->stream_index == inStream->index) {
+        av_packet_rescale_ts(packet, inStream->time_base, outTimeBase);
+        if (packet->pts != AV_NOPTS_VALUE) {
+          packet->pts += offset;
+          end = std::max(end, packet->pts + packet->duration);
+        }
+        if (packet->dts != AV_NOPTS_VALUE) {
+          packet->dts += offset;
+        }
+        packet->stream_index = ctx->videoStream->index;
+        packet->pos = -1;
+        av_interleaved_write_frame(ctx->formatContext, packet);
+        writeAudioUntil(ctx, end * av_q2d(outTimeBase));
+      }
+      av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&input);
+  }
+
+  bool recovered = ctx->headerWritten && av_write_trailer(ctx->formatContext) >= 0;
+  freeContext(ctx);
+  if (recovered) {
+    for (const auto& entry : segments) {
+      std::remove(entry.second.second.c_str());
+    }
+    std::remove(listPath.c_str());
+  }
+  return recovered;
+}
+
+} // namespace
+
 VideoRecorder::VideoRecorder()
-    : recording(false), filename(""), audioFilePath(""), frameWidth(0), frameHeight(0), frameRate(60), ffmpegContext(nullptr) {
+    : recording(false), filename(""), audioFilePath(""), frameWidth(0), frameHeight(0), frameRate(60), ffmpegContext(nullptr),
+      queuePolicy(FrameQueue::FullPolicy::Block), queueSlots(DEFAULT_QUEUE_SLOTS), queueMaxSlots(DEFAULT_QUEUE_MAX_SLOTS),
+      maxQueueDepth(0), framesQueued(0), framesEncoded(0), lastLatencyUs(0), totalLatencyUs(0), maxLatencyUs(0),
+      segmentSeconds(0.0), segmentWorkerCount(2), segmentSlots(0), segmentFrames(0),
+      nextSegmentToAppend(0),
+      fragmentSeconds(0.0), encodersBusy(0), peakEncoders(0), encoderBusyUs(0), markerFd(-1) {
 }
 
 VideoRecorder::~VideoRecorder() {
@@ -69,29 +519,155 @@ bool VideoRecorder::startRecording(const std::string& file, int width, int heigh
   }
   appLog(logMsg.str());
   
+  segmentFrames = segmentSeconds > 0 ? std::max(1, static_cast<int>(std::lround(segmentSeconds * frameRate))) : 0;
+
   // Initialize encoder first, only set recording flag if successful
-  if (initializeEncoder()) {
-    recording = true;
-    return true;
-  } else {
+  if (!initializeEncoder()) {
     recording = false;
     return false;
   }
+
+  // Removed once the file is finished; one left behind marks a session to recover and
+  // names its output and music. It stays open and locked while recording, so another
+  // instance starting meanwhile sees the session is live rather than abandoned.
+  std::string sessions = sessionDirectory();
+  std::string base = filename.substr(filename.find_last_of('/') + 1);
+  markerPath = sessions.empty() ? std::string() : sessions + "/" + base + ".recording";
+  markerFd = markerPath.empty() ? -1 : open(markerPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (markerFd >= 0 && flock(markerFd, LOCK_EX | LOCK_NB) == 0) {
+    std::string contents = "output " + filename + "\n";
+    if (!audioFilePath.empty()) {
+      contents += "audio " + audioFilePath + "\n";
+    }
+    if (write(markerFd, contents.data(), contents.size()) != static_cast<ssize_t>(contents.size())) {
+      appLog("[FFMPEG] Could not write the session marker " + markerPath, true);
+    }
+  } else {
+    appLog("[FFMPEG] Could not create the session marker; this recording cannot be recovered after a crash", true);
+    if (markerFd >= 0) {
+      close(markerFd);
+      markerFd = -1;
+      std::remove(markerPath.c_str());
+    }
+    markerPath.clear();
+  }
+
+  maxQueueDepth = 0;
+  framesQueued = 0;
+  framesEncoded = 0;
+  lastLatencyUs = 0;
+  totalLatencyUs = 0;
+  maxLatencyUs = 0;
+  encodersBusy = 0;
+  peakEncoders = 0;
+  encoderBusyUs = 0;
+  recordingStart = std::chrono::steady_clock::now();
+  frameQueue = std::make_unique<FrameQueue>(queueSlots, queuePolicy, queueMaxSlots);
+
+  if (segmentFrames > 0) {
+    // Closed-GOP segments encoded in parallel; the encoder thread dispatches frames to
+    // the workers and appends finished segments to the output in order
+    finishedSegments.clear();
+    segmentFiles.clear();
+    nextSegmentToAppend = 0;
+    segmentListPath = filename + ".segments";
+    std::FILE* list = std::fopen(segmentListPath.c_str(), "w");
+    if (list) {
+      std::fclose(list);
+    }
+    for (int i = 0; i < segmentWorkerCount; i++) {
+      auto worker = std::make_unique<SegmentWorker>();
+      worker->queue = std::make_unique<FrameQueue>(segmentWorkerSlots(), FrameQueue::FullPolicy::Block);
+      worker->thread = std::thread(&VideoRecorder::segmentLoop, this, worker->queue.get());
+      segmentWorkers.push_back(std::move(worker));
+    }
+    std::ostringstream segMsg;
+    segMsg << "[FFMPEG] Segmented encoding: " << segmentFrames << " frames per segment, " << segmentWorkerCount
+           << " encoders holding up to " << segmentWorkerSlots() << " frames each";
+    appLog(segMsg.str());
+    std::cout << "Started recording to: " << filename << " (" << frameWidth << "×" << frameHeight << "@" << frameRate << "fps)" << std::endl;
+  }
+
+  encoderThread = std::thread(&VideoRecorder::encodeLoop, this);
+  recording = true;
+  return true;
+}
+
+void VideoRecorder::setQueuePolicy(FrameQueue::FullPolicy policy, int slots, int maxSlots) {
+  queuePolicy = policy;
+  queueSlots = std::max(slots, 1);
+  queueMaxSlots = std::max(maxSlots, queueSlots);
+}
+
+void VideoRecorder::setSegmentedEncoding(double seconds, int workers, int slotsPerWorker) {
+  segmentSeconds = std::max(seconds, 0.0);
+  segmentWorkerCount = std::max(workers, 1);
+  segmentSlots = std::max(slotsPerWorker, 0);
+}
+
+int VideoRecorder::segmentWorkerSlots() const {
+  int frames = segmentFrames > 0 ? segmentFrames
+                                 : std::max(1, static_cast<int>(std::lround(segmentSeconds * frameRate)));
+  return segmentSlots > 0 ? std::min(segmentSlots, frames) : frames;
+}
+
+int VideoRecorder::getMaxFramesInFlight() const {
+  // The slot being encoded stays in the queue until it is popped
+  int frames = queuePolicy == FrameQueue::FullPolicy::Grow ? queueMaxSlots : queueSlots;
+  if (segmentSeconds > 0) {
+    // Each worker's slots, plus the one the dispatcher waits to hand over
+    frames += segmentWorkerCount * segmentWorkerSlots() + 1;
+  }
+  return frames;
+}
+
+int VideoRecorder::getFramesToReserve() const {
+  int frames = queuePolicy == FrameQueue::FullPolicy::Grow ? queueMaxSlots : queueSlots;
+  if (segmentSeconds > 0) {
+    frames += segmentWorkerCount * std::min(SEGMENT_RESERVED_SLOTS, segmentWorkerSlots()) + 1;
+  }
+  return frames;
+}
+
+RecorderStats VideoRecorder::getStats() const {
+  RecorderStats stats{};
+  stats.queueDepth = frameQueue ? frameQueue->depth() : 0;
+  stats.maxQueueDepth = maxQueueDepth;
+  stats.queueSlots = frameQueue ? frameQueue->capacity() : queueSlots;
+  stats.framesQueued = framesQueued;
+  stats.framesEncoded = framesEncoded.load(std::memory_order_relaxed);
+  stats.droppedFrames = frameQueue ? frameQueue->dropped() : 0;
+  stats.lastLatencyMs = lastLatencyUs.load(std::memory_order_relaxed) / 1000.0;
+  stats.averageLatencyMs =
+      stats.framesEncoded > 0 ? totalLatencyUs.load(std::memory_order_relaxed) / 1000.0 / stats.framesEncoded : 0.0;
+  stats.maxLatencyMs = maxLatencyUs.load(std::memory_order_relaxed) / 1000.0;
+  stats.peakEncoders = peakEncoders.load(std::memory_order_relaxed);
+  auto wallUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - recordingStart).count();
+  stats.averageEncoders = wallUs > 0 ? static_cast<double>(encoderBusyUs.load(std::memory_order_relaxed)) / wallUs : 0.0;
+  return stats;
 }
 
 bool VideoRecorder::initializeEncoder() {
   FFmpegContext* ctx = new FFmpegContext();
-  ctx->formatContext = nullptr;
-  ctx->codecContext = nullptr;
-  ctx->videoStream = nullptr;
-  ctx->frame = nullptr;
-  ctx->packet = nullptr;
-  ctx->swsContext = nullptr;
-  ctx->frameCount = 0;
   ffmpegContext = ctx;
-  
+
+  // Segmented: the workers open their own encoders, and the final file's muxer opens
+  // with the first finished segment
+  if (segmentFrames > 0) {
+    return true;
+  }
+
+  if (!openEncoder(ctx, filename, false)) {
+    cleanupEncoder();
+    return false;
+  }
+  std::cout << "Started recording to: " << filename << " (" << frameWidth << "×" << frameHeight << "@" << frameRate << "fps)" << std::endl;
+  return true;
+}
+
+bool VideoRecorder::openEncoder(FFmpegContext* ctx, const std::string& path, bool segment) {
   // Allocate format context
-  int ret = avformat_alloc_output_context2(&ctx->formatContext, nullptr, nullptr, filename.c_str());
+  int ret = avformat_alloc_output_context2(&ctx->formatContext, nullptr, nullptr, path.c_str());
   if (ret < 0 || !ctx->formatContext) {
     char errbuf[AV_ERROR_MAX_STRING_SIZE];
     av_strerror(ret, errbuf, AV_ERROR_MAX_STRING_SIZE);
@@ -99,7 +675,6 @@ bool VideoRecorder::initializeEncoder() {
     errMsg << "[FFMPEG] Could not create output context: " << errbuf;
     appLog(errMsg.str(), true);
     std::cerr << "Could not create output context: " << errbuf << std::endl;
-    cleanupEncoder();
     return false;
   }
   
@@ -134,21 +709,21 @@ bool VideoRecorder::initializeEncoder() {
   if (!codec) {
     appLog("[FFMPEG] H.264 codec not found", true);
     std::cerr << "H.264 codec not found" << std::endl;
-    cleanupEncoder();
     return false;
   }
   
-  std::ostringstream logMsg;
-  logMsg << "[FFMPEG] Using encoder: " << codec->name;
-  appLog(logMsg.str());
-  std::cout << "Using encoder: " << codec->name << std::endl;
+  if (!segment) {
+    std::ostringstream logMsg;
+    logMsg << "[FFMPEG] Using encoder: " << codec->name;
+    appLog(logMsg.str());
+    std::cout << "Using encoder: " << codec->name << std::endl;
+  }
   
   // Create codec context
   ctx->codecContext = avcodec_alloc_context3(codec);
   if (!ctx->codecContext) {
     appLog("[FFMPEG] Could not allocate codec context", true);
     std::cerr << "Could not allocate codec context" << std::endl;
-    cleanupEncoder();
     return false;
   }
   
@@ -167,7 +742,7 @@ bool VideoRecorder::initializeEncoder() {
   if (strcmp(codec->name, "libx264") == 0) {
     // libx264 supports preset and crf
     ctx->codecContext->gop_size = 10;
-    ctx->codecContext->max_b_frames = 1;
+    ctx->codecContext->max_b_frames = segment ? 0 : 1; // Segments join end to end: no reordering across them
     if (av_opt_set(ctx->codecContext->priv_data, "preset", "medium", 0) < 0) {
       std::cerr << "Warning: Could not set preset" << std::endl;
     }
@@ -226,7 +801,7 @@ bool VideoRecorder::initializeEncoder() {
   } else {
     // For other encoders, try generic options
     ctx->codecContext->gop_size = 10;
-    ctx->codecContext->max_b_frames = 1;
+    ctx->codecContext->max_b_frames = segment ? 0 : 1;
     av_opt_set(ctx->codecContext->priv_data, "crf", "23", 0);
   }
   
@@ -239,7 +814,6 @@ bool VideoRecorder::initializeEncoder() {
     errMsg << "[FFMPEG] Could not open codec: " << errbuf;
     appLog(errMsg.str(), true);
     std::cerr << "Could not open codec: " << errbuf << std::endl;
-    cleanupEncoder();
     return false;
   }
   
@@ -248,7 +822,6 @@ bool VideoRecorder::initializeEncoder() {
   if (!ctx->videoStream) {
     appLog("[FFMPEG] Could not create video stream", true);
     std::cerr << "Could not create video stream" << std::endl;
-    cleanupEncoder();
     return false;
   }
   
@@ -259,24 +832,28 @@ bool VideoRecorder::initializeEncoder() {
   ctx->videoStream->codecpar->height = frameHeight;
   ctx->videoStream->time_base = {1, frameRate};
   avcodec_parameters_from_context(ctx->videoStream->codecpar, ctx->codecContext);
+
+  // Audio goes into the same file as it records: no remux pass when recording stops
+  if (!segment && !audioFilePath.empty() && !openAudioInput(ctx, audioFilePath)) {
+    appLog("[FFMPEG] Could not add the audio stream (recording video only)", true);
+  }
   
   // Open output file
   if (!(ctx->formatContext->oformat->flags & AVFMT_NOFILE)) {
-    ret = avio_open(&ctx->formatContext->pb, filename.c_str(), AVIO_FLAG_WRITE);
+    ret = avio_open(&ctx->formatContext->pb, path.c_str(), AVIO_FLAG_WRITE);
     if (ret < 0) {
       char errbuf[AV_ERROR_MAX_STRING_SIZE];
       av_strerror(ret, errbuf, AV_ERROR_MAX_STRING_SIZE);
       std::ostringstream errMsg;
-      errMsg << "[FFMPEG] Could not open output file " << filename << ": " << errbuf;
+      errMsg << "[FFMPEG] Could not open output file " << path << ": " << errbuf;
       appLog(errMsg.str(), true);
-      std::cerr << "Could not open output file " << filename << ": " << errbuf << std::endl;
-      cleanupEncoder();
+      std::cerr << "Could not open output file " << path << ": " << errbuf << std::endl;
       return false;
     }
   }
   
-  // Write header
-  ret = avformat_write_header(ctx->formatContext, nullptr);
+  // Write header (segments are finalized within seconds; only the recording fragments)
+  ret = writeHeader(ctx, path, segment ? 0.0 : fragmentSeconds);
   if (ret < 0) {
     char errbuf[AV_ERROR_MAX_STRING_SIZE];
     av_strerror(ret, errbuf, AV_ERROR_MAX_STRING_SIZE);
@@ -284,15 +861,14 @@ bool VideoRecorder::initializeEncoder() {
     errMsg << "[FFMPEG] Could not write header: " << errbuf;
     appLog(errMsg.str(), true);
     std::cerr << "Could not write header: " << errbuf << std::endl;
-    cleanupEncoder();
     return false;
   }
+  ctx->headerWritten = true;
   
   // Allocate frame
   ctx->frame = av_frame_alloc();
   if (!ctx->frame) {
     std::cerr << "Could not allocate frame" << std::endl;
-    cleanupEncoder();
     return false;
   }
   
@@ -302,7 +878,6 @@ bool VideoRecorder::initializeEncoder() {
   
   if (av_frame_get_buffer(ctx->frame, 0) < 0) {
     std::cerr << "Could not allocate frame buffer" << std::endl;
-    cleanupEncoder();
     return false;
   }
   
@@ -310,7 +885,6 @@ bool VideoRecorder::initializeEncoder() {
   ctx->packet = av_packet_alloc();
   if (!ctx->packet) {
     std::cerr << "Could not allocate packet" << std::endl;
-    cleanupEncoder();
     return false;
   }
   
@@ -324,40 +898,107 @@ bool VideoRecorder::initializeEncoder() {
   
   if (!ctx->swsContext) {
     std::cerr << "Could not create swscale context" << std::endl;
-    cleanupEncoder();
     return false;
   }
   
-  std::cout << "Started recording to: " << filename << " (" << frameWidth << "×" << frameHeight << "@" << frameRate << "fps)" << std::endl;
   return true;
 }
 
-bool VideoRecorder::addFrame(const void* pixels, int width, int height) {
-  if (!recording || !ffmpegContext) {
+bool VideoRecorder::addFrame(FramePool::Frame* frame) {
+  if (!recording || !frameQueue) {
+    frame->owner->release(frame);
     return false;
   }
   
-  FFmpegContext* ctx = static_cast<FFmpegContext*>(ffmpegContext);
-  
-  if (width != frameWidth || height != frameHeight) {
+  if (frame->width != frameWidth || frame->height != frameHeight) {
     std::cerr << "Frame size mismatch!" << std::endl;
+    frame->owner->release(frame);
     return false;
   }
   
+  // Hand the frame to a free slot; the encoder thread does the rest
+  FrameQueue::Slot* slot = frameQueue->acquire();
+  if (!slot) {
+    frame->owner->release(frame);
+    return false;
+  }
+  frame->capturedAt = std::chrono::steady_clock::now();
+  slot->frame = frame;
+  frameQueue->publish();
+  framesQueued++;
+  maxQueueDepth = std::max(maxQueueDepth, frameQueue->depth());
+  return true;
+}
+
+void VideoRecorder::encodeLoop() {
+  FFmpegContext* ctx = static_cast<FFmpegContext*>(ffmpegContext);
+  while (FrameQueue::Slot* slot = frameQueue->front()) {
+    if (segmentFrames > 0) {
+      // Route to the worker that owns this frame's segment. Its queue holds a whole
+      // segment, so this only waits while the worker is still on its previous one
+      int64_t segment = slot->index / segmentFrames;
+      FrameQueue& queue = *segmentWorkers[segment % segmentWorkers.size()]->queue;
+      FrameQueue::Slot* target = queue.acquire();
+      target->frame = slot->frame;
+      target->index = slot->index; // Keep the capture sequence number, not the worker's
+      queue.publish();
+      slot->frame = nullptr;
+      frameQueue->pop();
+      appendFinishedSegments(false);
+      continue;
+    }
+
+    encodeFrame(ctx, *slot->frame, slot->index);
+    writeAudioUntil(ctx, static_cast<double>(slot->index + 1) / frameRate);
+    finishFrame(slot->frame);
+    slot->frame = nullptr;
+    frameQueue->pop();
+  }
+
+  if (segmentFrames > 0) {
+    for (auto& worker : segmentWorkers) {
+      worker->queue->close();
+    }
+    for (auto& worker : segmentWorkers) {
+      worker->thread.join();
+    }
+    segmentWorkers.clear();
+    appendFinishedSegments(true);
+  }
+}
+
+void VideoRecorder::finishFrame(FramePool::Frame* frame) {
+  auto latency = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - frame->capturedAt).count();
+  frame->owner->release(frame);
+
+  uint64_t us = static_cast<uint64_t>(std::max<int64_t>(latency, 0));
+  lastLatencyUs.store(us, std::memory_order_relaxed);
+  totalLatencyUs.fetch_add(us, std::memory_order_relaxed);
+  uint64_t previous = maxLatencyUs.load(std::memory_order_relaxed);
+  while (us > previous && !maxLatencyUs.compare_exchange_weak(previous, us, std::memory_order_relaxed)) {
+  }
+  framesEncoded.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool VideoRecorder::encodeFrame(FFmpegContext* ctx, const FramePool::Frame& frame, int64_t index) {
   // Make frame writable
   if (av_frame_make_writable(ctx->frame) < 0) {
     return false;
   }
   
   // Convert ARGB8888 to YUV420P
-  const uint8_t* srcData[1] = {static_cast<const uint8_t*>(pixels)};
-  int srcLinesize[1] = {width * 4}; // ARGB = 4 bytes per pixel
+  const uint8_t* srcData[1] = {frame.pixels.data()};
+  int srcLinesize[1] = {frame.width * 4}; // ARGB = 4 bytes per pixel
   
-  sws_scale(ctx->swsContext, srcData, srcLinesize, 0, height,
+  sws_scale(ctx->swsContext, srcData, srcLinesize, 0, frame.height,
             ctx->frame->data, ctx->frame->linesize);
   
-  // Set frame timestamp
-  ctx->frame->pts = ctx->frameCount++;
+  // Timestamp from the capture sequence: a dropped frame leaves a gap (the previous
+  // frame is held) instead of shortening the video against the audio
+  ctx->frame->pts = index;
+  ctx->frameCount++;
+  ctx->nextPts = index + 1;
   
   // Encode frame
   int ret = avcodec_send_frame(ctx->codecContext, ctx->frame);
@@ -392,77 +1033,385 @@ bool VideoRecorder::addFrame(const void* pixels, int width, int height) {
   return true;
 }
 
+void VideoRecorder::flushEncoder(FFmpegContext* ctx) {
+  int ret = avcodec_send_frame(ctx->codecContext, nullptr);
+  while (ret >= 0) {
+    ret = avcodec_receive_packet(ctx->codecContext, ctx->packet);
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+      break;
+    } else if (ret < 0) {
+      break;
+    }
+    
+    av_packet_rescale_ts(ctx->packet, ctx->codecContext->time_base, ctx->videoStream->time_base);
+    ctx->packet->stream_index = ctx->videoStream->index;
+    av_interleaved_write_frame(ctx->formatContext, ctx->packet);
+    av_packet_unref(ctx->packet);
+  }
+}
+
+void VideoRecorder::segmentLoop(FrameQueue* queue) {
+  FFmpegContext* ctx = nullptr;
+  int64_t segment = -1;
+  int64_t startFrame = 0;
+  std::string path;
+
+  while (FrameQueue::Slot* slot = queue->front()) {
+    int64_t frameSegment = slot->index / segmentFrames;
+    if (frameSegment != segment) {
+      if (segment >= 0) {
+        finishSegment(segment, startFrame, path, ctx); // Its last frame was dropped
+      }
+      segment = frameSegment;
+      startFrame = slot->index;
+      std::ostringstream name;
+      name << filename << ".seg" << std::setw(5) << std::setfill('0') << segment << ".mp4";
+      path = name.str();
+      ctx = new FFmpegContext();
+      if (!openEncoder(ctx, path, true)) {
+        appLog("[FFMPEG] Could not start segment " + path, true);
+        freeContext(ctx);
+        ctx = nullptr;
+      }
+    }
+
+    // Each segment starts at pts 0 with a keyframe; appendSegment offsets it back
+    if (ctx) {
+      auto began = beginEncoding();
+      encodeFrame(ctx, *slot->frame, slot->index - startFrame);
+      endEncoding(began);
+    }
+    bool lastFrame = (slot->index + 1) % segmentFrames == 0;
+    finishFrame(slot->frame);
+    slot->frame = nullptr;
+    queue->pop();
+
+    if (lastFrame) {
+      finishSegment(segment, startFrame, path, ctx);
+      segment = -1;
+      ctx = nullptr;
+    }
+  }
+
+  if (segment >= 0) {
+    finishSegment(segment, startFrame, path, ctx);
+  }
+}
+
+void VideoRecorder::finishSegment(int64_t segment, int64_t startFrame, const std::string& path, FFmpegContext* ctx) {
+  bool written = false;
+  if (ctx) {
+    auto began = beginEncoding();
+    flushEncoder(ctx);
+    endEncoding(began);
+    written = av_write_trailer(ctx->formatContext) >= 0;
+    freeContext(ctx);
+  }
+
+  std::lock_guard<std::mutex> lock(segmentMutex);
+  finishedSegments[segment] = {written ? path : std::string(), startFrame};
+  if (written) {
+    // "<segment> <first frame> <path>", in completion order: enough to rebuild the
+    // recording from the segments if the final file is never finished
+    std::ofstream list(segmentListPath, std::ios::app);
+    list << segment << " " << startFrame << " " << path << "\n";
+  }
+}
+
+std::chrono::steady_clock::time_point VideoRecorder::beginEncoding() {
+  int busy = encodersBusy.fetch_add(1, std::memory_order_relaxed) + 1;
+  int previous = peakEncoders.load(std::memory_order_relaxed);
+  while (busy > previous && !peakEncoders.compare_exchange_weak(previous, busy, std::memory_order_relaxed)) {
+  }
+  return std::chrono::steady_clock::now();
+}
+
+void VideoRecorder::endEncoding(std::chrono::steady_clock::time_point began) {
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - began).count();
+  encoderBusyUs.fetch_add(static_cast<uint64_t>(std::max<int64_t>(us, 0)), std::memory_order_relaxed);
+  encodersBusy.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void VideoRecorder::appendFinishedSegments(bool all) {
+  while (true) {
+    FinishedSegment next;
+    {
+      std::lock_guard<std::mutex> lock(segmentMutex);
+      auto it = all ? finishedSegments.begin() : finishedSegments.find(nextSegmentToAppend);
+      if (it == finishedSegments.end()) {
+        return;
+      }
+      next = it->second;
+      nextSegmentToAppend = it->first + 1;
+      finishedSegments.erase(it);
+    }
+    if (!next.path.empty()) {
+      appendSegment(next.path, next.startFrame);
+    }
+  }
+}
+
+bool VideoRecorder::openSegmentedOutput(const AVStream* source) {
+  FFmpegContext* ctx = static_cast<FFmpegContext*>(ffmpegContext);
+  int ret = avformat_alloc_output_context2(&ctx->formatContext, nullptr, nullptr, filename.c_str());
+  if (ret < 0 || !ctx->formatContext) {
+    appLog("[FFMPEG] Could not create output context for " + filename, true);
+    return false;
+  }
+
+  // Stream copy of the segments' H.264
+  ctx->videoStream = avformat_new_stream(ctx->formatContext, nullptr);
+  if (!ctx->videoStream) {
+    appLog("[FFMPEG] Could not create video stream", true);
+    return false;
+  }
+  avcodec_parameters_copy(ctx->videoStream->codecpar, source->codecpar);
+  ctx->videoStream->codecpar->codec_tag = 0;
+  ctx->videoStream->time_base = {1, frameRate};
+
+  if (!audioFilePath.empty() && !openAudioInput(ctx, audioFilePath)) {
+    appLog("[FFMPEG] Could not add the audio stream (recording video only)", true);
+  }
+
+  if (!(ctx->formatContext->oformat->flags & AVFMT_NOFILE)) {
+    ret = avio_open(&ctx->formatContext->pb, filename.c_str(), AVIO_FLAG_WRITE);
+    if (ret < 0) {
+      appLog("[FFMPEG] Could not open output file " + filename, true);
+      return false;
+    }
+  }
+
+  ret = writeHeader(ctx, filename, fragmentSeconds);
+  if (ret < 0) {
+    char errbuf[AV_ERROR_MAX_STRING_SIZE];
+    av_strerror(ret, errbuf, AV_ERROR_MAX_STRING_SIZE);
+    std::ostringstream errMsg;
+    errMsg << "[FFMPEG] Could not write header: " << errbuf;
+    appLog(errMsg.str(), true);
+    return false;
+  }
+  ctx->headerWritten = true;
+  return true;
+}
+
+bool VideoRecorder::appendSegment(const std::string& path, int64_t startFrame) {
+  FFmpegContext* ctx = static_cast<FFmpegContext*>(ffmpegContext);
+  AVFormatContext* input = nullptr;
+  if (avformat_open_input(&input, path.c_str(), nullptr, nullptr) < 0) {
+    appLog("[FFMPEG] Could not open segment " + path, true);
+    return false;
+  }
+  if (avformat_find_stream_info(input, nullptr) < 0 || input->nb_streams < 1) {
+    appLog("[FFMPEG] No video in segment " + path, true);
+    avformat_close_input(&input);
+    return false;
+  }
+
+  AVStream* inStream = input->streams[0];
+  if (!ctx->formatContext) {
+    if (!openSegmentedOutput(inStream)) {
+      avformat_close_input(&input);
+      return false;
+    }
+  } else if (!ctx->headerWritten) {
+    avformat_close_input(&input);
+    return false; // Opening the output already failed
+  } else {
+    // Every segment comes from an identically configured encoder, so one set of SPS/PPS
+    // in the output describes them all
+    const AVCodecParameters* first = ctx->videoStream->codecpar;
+    const AVCodecParameters* par = inStream->codecpar;
+    if (first->extradata_size != par->extradata_size ||
+        (par->extradata_size > 0 && std::memcmp(first->extradata, par->extradata, par->extradata_size) != 0)) {
+      appLog("[FFMPEG] Segment " + path + " has different codec parameters", true);
+    }
+  }
+
+  AVRational frameTimeBase = {1, frameRate};
+  int64_t offset = av_rescale_q(startFrame, frameTimeBase, ctx->videoStream->time_base);
+  AVPacket* packet = av_packet_alloc();
+  while (packet && av_read_frame(input, packet) >= 0) {
+    if (packet->stream_index == inStream->index) {
+      int64_t frame = packet->pts != AV_NOPTS_VALUE ? startFrame + av_rescale_q(packet->pts, inStream->time_base, frameTimeBase)
+                                                    : ctx->nextPts;
+      av_packet_rescale_ts(packet, inStream->time_base, ctx->videoStream->time_base);
+      if (packet->pts != AV_NOPTS_VALUE) {
+        packet->pts += offset;
+      }
+      if (packet->dts != AV_NOPTS_VALUE) {
+        packet->dts += offset;
+      }
+      packet->stream_index = ctx->videoStream->index;
+      packet->pos = -1;
+      av_interleaved_write_frame(ctx->formatContext, packet);
+      ctx->frameCount++;
+      ctx->nextPts = std::max(ctx->nextPts, frame + 1);
+      writeAudioUntil(ctx, static_cast<double>(ctx->nextPts) / frameRate);
+    }
+    av_packet_unref(packet);
+  }
+
+  av_packet_free(&packet);
+  avformat_close_input(&input);
+  segmentFiles.push_back(path);
+  return true;
+}
+
 void VideoRecorder::stopRecording() {
   if (!recording) {
     return;
   }
   
+  // Let the encoder thread drain the queue (and, segmented, the workers) before flushing
+  if (frameQueue) {
+    frameQueue->close();
+    if (encoderThread.joinable()) {
+      encoderThread.join();
+    }
+    RecorderStats stats = getStats();
+    std::ostringstream statsMsg;
+    statsMsg << "[FFMPEG] Encoded " << stats.framesEncoded << " frames, dropped " << stats.droppedFrames
+             << ", max queue depth " << stats.maxQueueDepth << "/" << stats.queueSlots << ", latency avg "
+             << std::fixed << std::setprecision(1) << stats.averageLatencyMs << " ms, max " << stats.maxLatencyMs << " ms";
+    appLog(statsMsg.str());
+    if (segmentFrames > 0) {
+      // Shows whether the segment encoders actually ran side by side
+      std::ostringstream overlapMsg;
+      overlapMsg << "[FFMPEG] Segment encoders: up to " << stats.peakEncoders << " of " << segmentWorkerCount
+                 << " encoding at once, " << std::fixed << std::setprecision(2) << stats.averageEncoders
+                 << " busy on average";
+      appLog(overlapMsg.str());
+    }
+    frameQueue.reset();
+  }
+  
   FFmpegContext* ctx = static_cast<FFmpegContext*>(ffmpegContext);
+  bool finished = false;
   
-  if (ctx && ctx->codecContext) {
-    // Flush encoder
-    int ret = avcodec_send_frame(ctx->codecContext, nullptr);
-    while (ret >= 0) {
-      ret = avcodec_receive_packet(ctx->codecContext, ctx->packet);
-      if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-        break;
-      } else if (ret < 0) {
-        break;
-      }
-      
-      av_packet_rescale_ts(ctx->packet, ctx->codecContext->time_base, ctx->videoStream->time_base);
-      ctx->packet->stream_index = ctx->videoStream->index;
-      av_interleaved_write_frame(ctx->formatContext, ctx->packet);
-      av_packet_unref(ctx->packet);
+  if (ctx && ctx->headerWritten) {
+    if (ctx->codecContext) {
+      flushEncoder(ctx);
+    }
+
+    // Audio up to the end of the video, trimmed there
+    if (ctx->audioStream) {
+      writeAudioUntil(ctx, static_cast<double>(ctx->nextPts) / frameRate);
     }
     
     // Write trailer
-    av_write_trailer(ctx->formatContext);
+    finished = av_write_trailer(ctx->formatContext) >= 0;
     
     std::cout << "Stopped recording. Video saved to: " << filename << std::endl;
-    appLog("[FFMPEG] Video encoding complete");
+    appLog(ctx->audioStream ? "[FFMPEG] Video encoding complete (with audio)" : "[FFMPEG] Video encoding complete (video only)");
   }
   
   cleanupEncoder();
   recording = false;
-  
-  // Mux audio with video if audio file was provided
-  if (!audioFilePath.empty()) {
-    std::cout << "\n========================================" << std::endl;
-    std::cout << "Mixing audio into video..." << std::endl;
-    std::cout << "Video file: " << filename << std::endl;
-    std::cout << "Audio file: " << audioFilePath << std::endl;
-    std::cout << "========================================" << std::endl;
-    appLog("[FFMPEG] Muxing audio with video...");
-    
-    if (muxAudioWithVideo()) {
-      std::cout << "✓ Audio mixed successfully!" << std::endl;
-      appLog("[FFMPEG] Audio muxing complete");
+
+  // The segments are in the final file now; keep them if it could not be finished
+  if (segmentFrames > 0 && finished) {
+    for (const std::string& path : segmentFiles) {
+      std::remove(path.c_str());
+    }
+    std::remove(segmentListPath.c_str());
+  }
+
+  if (!finished) {
+    appLog("[FFMPEG] Recording not finalized; it will be recovered on the next start if possible", true);
+  } else if (!markerPath.empty()) {
+    std::remove(markerPath.c_str());
+  }
+  if (markerFd >= 0) {
+    close(markerFd); // Releases the lock
+    markerFd = -1;
+  }
+}
+
+void VideoRecorder::setFragmentDuration(double seconds) {
+  fragmentSeconds = std::max(seconds, 0.0);
+}
+
+std::vector<std::string> VideoRecorder::recoverSessions() {
+  std::vector<std::string> recovered;
+  std::string directory = sessionDirectory();
+  DIR* dir = directory.empty() ? nullptr : opendir(directory.c_str());
+  if (!dir) {
+    return recovered;
+  }
+  std::vector<std::string> markers;
+  while (dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (endsWith(name, ".recording")) {
+      markers.push_back(directory + "/" + name);
+    }
+  }
+  closedir(dir);
+
+  for (const std::string& marker : markers) {
+    // A marker another instance still holds locked belongs to a live recording. The lock
+    // is kept while recovering, so two instances starting together do not both rebuild it.
+    int fd = open(marker.c_str(), O_RDONLY);
+    if (fd < 0) {
+      continue;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+      close(fd);
+      continue;
+    }
+
+    // "output <path>" and, if the recording had music, "audio <path>"
+    std::string path, audioPath;
+    std::ifstream contents(marker);
+    std::string line;
+    while (std::getline(contents, line)) {
+      if (line.compare(0, 7, "output ") == 0) {
+        path = line.substr(7);
+      } else if (line.compare(0, 6, "audio ") == 0) {
+        audioPath = line.substr(6);
+      }
+    }
+    contents.close();
+    std::string listPath = path + ".segments";
+
+    // Finished segments hold at least as much video as the partly assembled output.
+    // The marker goes once the session is recovered or known to be unrecoverable, so a
+    // recovery cut short is tried again on the next start.
+    bool ok = !path.empty() &&
+              ((fileExists(listPath) && recoverSegments(path, listPath, audioPath)) ||
+               (fileExists(path) && recoverFragmented(path)));
+    if (ok) {
+      recovered.push_back(path);
+    } else if (!path.empty() && fileExists(path)) {
+      appLog("[FFMPEG] Could not recover interrupted recording " + path + " (not fragmented)", true);
     } else {
-      std::cerr << "✗ Failed to mix audio with video" << std::endl;
-      appLog("[FFMPEG] Audio muxing failed (video saved without audio)", true);
+      appLog("[FFMPEG] Nothing to recover for interrupted recording " + (path.empty() ? marker : path), true);
     }
-  } else {
-    std::cout << "\n========================================" << std::endl;
-    std::cout << "No audio file provided - video saved without audio" << std::endl;
-    std::cout << "========================================" << std::endl;
-    appLog("[FFMPEG] No audio file - video only");
+    std::remove(marker.c_str());
+    close(fd);
   }
+  return recovered;
 }
 
 bool VideoRecorder::moveFile(const std::string& newPath) {
-  if (filename.empty() || newPath.empty()) {
+  if (!moveFile(filename, newPath)) {
+    return false;
+  }
+  filename = newPath;
+  return true;
+}
+
+bool VideoRecorder::moveFile(const std::string& from, const std::string& newPath) {
+  if (from.empty() || newPath.empty()) {
     return false;
   }
   
   // Use rename() which is atomic on the same filesystem
-  if (std::rename(filename.c_str(), newPath.c_str()) == 0) {
-    filename = newPath;
+  if (std::rename(from.c_str(), newPath.c_str()) == 0) {
     return true;
   }
   
   // If rename fails (different filesystems), try copy + delete
-  FILE* src = std::fopen(filename.c_str(), "rb");
+  FILE* src = std::fopen(from.c_str(), "rb");
   if (!src) {
     return false;
   }
@@ -488,8 +1437,7 @@ bool VideoRecorder::moveFile(const std::string& newPath) {
   std::fclose(dst);
   
   if (success) {
-    std::remove(filename.c_str()); // Delete original
-    filename = newPath;
+    std::remove(from.c_str()); // Delete original
     return true;
   } else {
     std::remove(newPath.c_str()); // Clean up failed copy
@@ -502,240 +1450,6 @@ void VideoRecorder::cleanupEncoder() {
     return;
   }
   
-  FFmpegContext* ctx = static_cast<FFmpegContext*>(ffmpegContext);
-  
-  if (ctx) {
-    if (ctx->swsContext) {
-      sws_freeContext(ctx->swsContext);
-      ctx->swsContext = nullptr;
-    }
-    
-    if (ctx->packet) {
-      av_packet_free(&ctx->packet);
-    }
-    
-    if (ctx->frame) {
-      av_frame_free(&ctx->frame);
-    }
-    
-    if (ctx->codecContext) {
-      avcodec_free_context(&ctx->codecContext);
-    }
-    
-    if (ctx->formatContext) {
-      if (!(ctx->formatContext->oformat->flags & AVFMT_NOFILE)) {
-        avio_closep(&ctx->formatContext->pb);
-      }
-      avformat_free_context(ctx->formatContext);
-    }
-    
-    delete ctx;
-    ffmpegContext = nullptr;
-  }
+  freeContext(static_cast<FFmpegContext*>(ffmpegContext));
+  ffmpegContext = nullptr;
 }
-
-bool VideoRecorder::muxAudioWithVideo() {
-  std::cout << "[MUXING] Starting audio muxing using vcpkg FFmpeg libraries..." << std::endl;
-  appLog("[FFMPEG] Starting audio muxing using vcpkg FFmpeg libraries...");
-  
-  std::string tempFilename = filename + ".temp.mp4";
-  
-  AVFormatContext* videoInputCtx = nullptr;
-  AVFormatContext* audioInputCtx = nullptr;
-  AVFormatContext* outputCtx = nullptr;
-  int ret;
-  
-  // Open video input
-  std::cout << "[MUXING] Opening video file: " << filename << std::endl;
-  ret = avformat_open_input(&videoInputCtx, filename.c_str(), nullptr, nullptr);
-  if (ret < 0) {
-    char errbuf[AV_ERROR_MAX_STRING_SIZE];
-    av_strerror(ret, errbuf, AV_ERROR_MAX_STRING_SIZE);
-    std::cerr << "[MUXING ERROR] Could not open video: " << errbuf << std::endl;
-    appLog("[FFMPEG] Could not open video input", true);
-    return false;
-  }
-  avformat_find_stream_info(videoInputCtx, nullptr);
-  std::cout << "[MUXING] Video file opened successfully" << std::endl;
-  
-  // Open audio input
-  std::cout << "[MUXING] Opening audio file: " << audioFilePath << std::endl;
-  ret = avformat_open_input(&audioInputCtx, audioFilePath.c_str(), nullptr, nullptr);
-  if (ret < 0) {
-    char errbuf[AV_ERROR_MAX_STRING_SIZE];
-    av_strerror(ret, errbuf, AV_ERROR_MAX_STRING_SIZE);
-    std::cerr << "[MUXING ERROR] Could not open audio: " << errbuf << std::endl;
-    appLog("[FFMPEG] Could not open audio input", true);
-    avformat_close_input(&videoInputCtx);
-    return false;
-  }
-  avformat_find_stream_info(audioInputCtx, nullptr);
-  std::cout << "[MUXING] Audio file opened successfully" << std::endl;
-  
-  // Create output
-  avformat_alloc_output_context2(&outputCtx, nullptr, nullptr, tempFilename.c_str());
-  if (!outputCtx) {
-    appLog("[FFMPEG] Could not create output context", true);
-    avformat_close_input(&videoInputCtx);
-    avformat_close_input(&audioInputCtx);
-    return false;
-  }
-  
-  // Map streams
-  int videoStreamIdx = -1;
-  int audioStreamIdx = -1;
-  int streamMapping[2] = {-1, -1};
-  
-  // Add video stream to output
-  for (unsigned int i = 0; i < videoInputCtx->nb_streams; i++) {
-    if (videoInputCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-      AVStream* outStream = avformat_new_stream(outputCtx, nullptr);
-      avcodec_parameters_copy(outStream->codecpar, videoInputCtx->streams[i]->codecpar);
-      outStream->codecpar->codec_tag = 0;
-      outStream->time_base = videoInputCtx->streams[i]->time_base;
-      videoStreamIdx = i;
-      streamMapping[0] = outStream->index;
-      break;
-    }
-  }
-  
-  // Add audio stream to output
-  for (unsigned int i = 0; i < audioInputCtx->nb_streams; i++) {
-    if (audioInputCtx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-      AVStream* outStream = avformat_new_stream(outputCtx, nullptr);
-      avcodec_parameters_copy(outStream->codecpar, audioInputCtx->streams[i]->codecpar);
-      outStream->codecpar->codec_tag = 0;
-      
-      // Explicitly set channel layout for MP4 compatibility
-      if (outStream->codecpar->ch_layout.nb_channels == 2) {
-        av_channel_layout_default(&outStream->codecpar->ch_layout, 2); // Stereo
-        std::cout << "[MUXING] Set audio to stereo channel layout" << std::endl;
-      } else if (outStream->codecpar->ch_layout.nb_channels == 1) {
-        av_channel_layout_default(&outStream->codecpar->ch_layout, 1); // Mono
-        std::cout << "[MUXING] Set audio to mono channel layout" << std::endl;
-      }
-      
-      outStream->time_base = audioInputCtx->streams[i]->time_base;
-      audioStreamIdx = i;
-      streamMapping[1] = outStream->index;
-      break;
-    }
-  }
-  
-  // Open output file
-  if (!(outputCtx->oformat->flags & AVFMT_NOFILE)) {
-    ret = avio_open(&outputCtx->pb, tempFilename.c_str(), AVIO_FLAG_WRITE);
-    if (ret < 0) {
-      appLog("[FFMPEG] Could not open output file", true);
-      avformat_free_context(outputCtx);
-      avformat_close_input(&videoInputCtx);
-      avformat_close_input(&audioInputCtx);
-      return false;
-    }
-  }
-  
-  // Write header
-  ret = avformat_write_header(outputCtx, nullptr);
-  if (ret < 0) {
-    appLog("[FFMPEG] Failed to write header", true);
-    avio_closep(&outputCtx->pb);
-    avformat_free_context(outputCtx);
-    avformat_close_input(&videoInputCtx);
-    avformat_close_input(&audioInputCtx);
-    return false;
-  }
-  
-  // Get video duration in seconds
-  double videoDuration = (double)videoInputCtx->streams[videoStreamIdx]->duration * 
-                         av_q2d(videoInputCtx->streams[videoStreamIdx]->time_base);
-  if (videoDuration <= 0) {
-    // Try to get duration from format context
-    videoDuration = (double)videoInputCtx->duration / AV_TIME_BASE;
-  }
-  std::cout << "[MUXING] Video duration: " << videoDuration << " seconds" << std::endl;
-  
-  // Interleave packets based on timestamps
-  AVPacket* pkt = av_packet_alloc();
-  bool videoEOF = false;
-  bool audioEOF = false;
-  
-  while (!videoEOF || !audioEOF) {
-    // Determine which stream to read from based on timestamps
-    bool readVideo = false;
-    
-    if (!videoEOF && !audioEOF) {
-      // Both streams available - read based on timestamps
-      int64_t videoPTS = videoEOF ? INT64_MAX : 0;
-      int64_t audioPTS = audioEOF ? INT64_MAX : 0;
-      
-      // Compare timestamps to decide which to read
-      readVideo = (videoPTS <= audioPTS);
-    } else {
-      readVideo = !videoEOF;
-    }
-    
-    if (readVideo && !videoEOF) {
-      ret = av_read_frame(videoInputCtx, pkt);
-      if (ret < 0) {
-        videoEOF = true;
-        continue;
-      }
-      
-      if (pkt->stream_index == videoStreamIdx) {
-        pkt->stream_index = streamMapping[0];
-        av_packet_rescale_ts(pkt, videoInputCtx->streams[videoStreamIdx]->time_base,
-                            outputCtx->streams[streamMapping[0]]->time_base);
-        pkt->pos = -1;
-        av_interleaved_write_frame(outputCtx, pkt);
-      }
-      av_packet_unref(pkt);
-    } else if (!audioEOF) {
-      ret = av_read_frame(audioInputCtx, pkt);
-      if (ret < 0) {
-        audioEOF = true;
-        continue;
-      }
-      
-      if (pkt->stream_index == audioStreamIdx) {
-        // Calculate audio packet timestamp in seconds
-        double audioPTS_sec = (double)pkt->pts * av_q2d(audioInputCtx->streams[audioStreamIdx]->time_base);
-        
-        // Only write audio packets that fall within video duration
-        if (audioPTS_sec <= videoDuration) {
-          pkt->stream_index = streamMapping[1];
-          av_packet_rescale_ts(pkt, audioInputCtx->streams[audioStreamIdx]->time_base,
-                              outputCtx->streams[streamMapping[1]]->time_base);
-          pkt->pos = -1;
-          av_interleaved_write_frame(outputCtx, pkt);
-        } else {
-          // Audio packet is beyond video duration - stop reading audio
-          std::cout << "[MUXING] Audio trimmed at " << audioPTS_sec << "s (video ends at " << videoDuration << "s)" << std::endl;
-          audioEOF = true;
-        }
-      }
-      av_packet_unref(pkt);
-    }
-  }
-  
-  // Write trailer and cleanup
-  av_write_trailer(outputCtx);
-  av_packet_free(&pkt);
-  avio_closep(&outputCtx->pb);
-  avformat_free_context(outputCtx);
-  avformat_close_input(&videoInputCtx);
-  avformat_close_input(&audioInputCtx);
-  
-  // Replace original file
-  std::cout << "[MUXING] Replacing original file with muxed version..." << std::endl;
-  if (std::remove(filename.c_str()) != 0 || std::rename(tempFilename.c_str(), filename.c_str()) != 0) {
-    std::cerr << "[MUXING ERROR] Could not replace video file" << std::endl;
-    appLog("[FFMPEG] Could not replace file", true);
-    std::remove(tempFilename.c_str());
-    return false;
-  }
-  
-  std::cout << "[MUXING] ✓ Audio muxing complete!" << std::endl;
-  appLog("[FFMPEG] Audio muxing complete using vcpkg libraries!");
-  return true;
-}
-